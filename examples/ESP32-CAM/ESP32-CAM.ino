@@ -49,6 +49,26 @@ const char* token = "XXXXXXXXXXXXXXXXXXXX";     // REPLACE myToken WITH YOUR TEL
 // Struct for saving time datas (needed for time-naming the image files)
 struct tm timeinfo;
 
+// Last picture sent (upload is asynchronous, the file can be removed only when it ends)
+String lastPicture;
+// Frame buffer sent directly from RAM (must be returned to camera driver only when upload ends)
+camera_fb_t * sentFrame = nullptr;
+
+void onUpload(UploadState state, uint32_t sent, uint32_t total) {
+    Serial.printf("Upload %s: %u/%u bytes\n", lastPicture.c_str(), sent, total);
+    if (state == UploadDone || state == UploadFailed) {
+        Serial.println(state == UploadDone ? "Photo sent" : "Photo send failed");
+        if (sentFrame != nullptr) {
+            esp_camera_fb_return(sentFrame);
+            sentFrame = nullptr;
+        }
+        //If you don't need to keep image in memory, delete it
+        else if(KEEP_IMAGE == false){
+            filesystem.remove("/" + lastPicture);
+        }
+    }
+}
+
 
 // List all files saved in the selected filesystem
 void listDir(fs::FS &fs, const char * dirname, uint8_t levels){
@@ -125,6 +145,33 @@ String takePicture(fs::FS &fs){
 }
 
 
+void onTakePhoto(const TBMessage &msg, const CommandArgs &args) {
+    Serial.println("\nSending Photo from CAM");          
+
+    // Take picture and save to file
+    String myFile = takePicture(filesystem);
+    if(myFile != "") {
+        lastPicture = myFile;
+        if (!myBot.sendPhotoByFile(msg.sender.id, myFile, filesystem))
+          Serial.println("Photo send failed");       
+    }
+}
+
+void onSendPhoto(const TBMessage &msg, const CommandArgs &args) {
+    if (sentFrame != nullptr)
+        return;
+    // Send the frame buffer without saving it in flash memory
+    Serial.println("\nSending Photo from CAM buffer");
+    camera_fb_t * fb = esp_camera_fb_get();
+    if (fb) {
+        lastPicture = "frame.jpg";
+        if (myBot.sendPhoto(msg.sender.id, fb->buf, fb->len, lastPicture.c_str()))
+            sentFrame = fb;
+        else
+            esp_camera_fb_return(fb);
+    }
+}
+
 void setup() {
     Serial.begin(115200);
     Serial.setDebugOutput(true);
@@ -163,6 +210,11 @@ void setup() {
     // Set the Telegram bot properies
     myBot.setUpdateTime(1000);
     myBot.setTelegramToken(token);
+    myBot.setUploadCallback(onUpload);
+
+    // Commands are handled inside getNewMessage()
+    myBot.addCommand("/takePhoto", onTakePhoto);
+    myBot.addCommand("/sendPhoto", onSendPhoto);
     
     // Check if all things are ok
     Serial.print("\nTest Telegram connection... ");
@@ -187,29 +239,13 @@ void loop() {
         MessageType msgType = msg.messageType;
             
         if (msgType == MessageText){
-            // Received a text message
-            if (msg.text.equalsIgnoreCase("/takePhoto")) {
-                Serial.println("\nSending Photo from CAM");          
-
-                // Take picture and save to file
-                String myFile = takePicture(filesystem);
-                if(myFile != "") {
-                    if (!myBot.sendPhotoByFile(msg.sender.id, myFile, filesystem))
-                      Serial.println("Photo send failed");       
-                    //If you don't need to keep image in memory, delete it 
-                    if(KEEP_IMAGE == false){
-                        filesystem.remove("/" + myFile);
-                    }
-                }
-            } 
-            else {
-                Serial.print("\nText message received: ");
-                Serial.println(msg.text);
-                String replyStr = "Message received:\n";
-                replyStr += msg.text;
-                replyStr +=  "\nTry with /takePhoto";
-                myBot.sendMessage(msg, replyStr);
-            }
+            // Received a text message (not a command)
+            Serial.print("\nText message received: ");
+            Serial.println(msg.text.c_str());
+            String replyStr = "Message received:\n";
+            replyStr += msg.text.c_str();
+            replyStr +=  "\nTry with /takePhoto or /sendPhoto";
+            myBot.sendMessage(msg, replyStr);
         }
     }
 }
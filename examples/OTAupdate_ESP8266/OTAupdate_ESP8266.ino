@@ -7,11 +7,10 @@
 */
 #include <Arduino.h>
 #include <ESP8266WiFi.h>
-#include <ESP8266httpUpdate.h>
+#include <Updater.h>
 #include "AsyncTelegram.h"
 
 AsyncTelegram myBot;
-WiFiClientSecure client;
 
 const char* ssid = "XXXXXXXX";     		  // REPLACE XXXXXXXX WITH YOUR WIFI SSID
 const char* pass = "XXXXXXXX";     		  // REPLACE XXXXXXXX YOUR WIFI PASSWORD, IF ANY
@@ -29,13 +28,6 @@ void setup() {
 	WiFi.begin(ssid, pass);
 	delay(500);
 
-  // We have to handle reboot manually after sync with TG server
-  ESPhttpUpdate.rebootOnUpdate(false);
-
-  // Create client for rom download
-  client.setInsecure();
-  client.setNoDelay(true);
-  
 	while (WiFi.status() != WL_CONNECTED) {
 		Serial.print('.');
 		delay(100);
@@ -82,33 +74,30 @@ void loop() {
                            + String(msg.document.file_size);
             myBot.sendMessage(msg, report.c_str());
 
-            // Install firmware update
-            t_httpUpdate_return ret = ESPhttpUpdate.update(client, msg.document.file_path);
-            switch (ret)
-            {
-              case HTTP_UPDATE_FAILED:
-                report = "HTTP_UPDATE_FAILED Error (" 
-                  + String(ESPhttpUpdate.getLastError()) 
-                  + "): " 
-                  + ESPhttpUpdate.getLastErrorString();
-                myBot.sendMessage(msg, report.c_str());
-                break;
-
-              case HTTP_UPDATE_NO_UPDATES:
-                myBot.sendMessage(msg, "HTTP_UPDATE_NO_UPDATES");
-                break;
+            // Install firmware update: binary file is downloaded with the bot connection
+            // and written block by block (transfer is resumed if interrupted)
+            bool ok = Update.begin(msg.document.file_size);
+            if (ok) {
+              ok = myBot.downloadFile(msg.document, [](const uint8_t* data, size_t len) {
+                return Update.write((uint8_t*)data, len) == len;
+              });
+              ok = Update.end(ok) && ok;
+            }
 
-              case HTTP_UPDATE_OK:
-                myBot.sendMessage(msg, "UPDATE OK.\nRestarting...");
-                // Wait until bot synced with telegram to prevent cyclic reboot
-                while (!myBot.getUpdates()) {
-                  Serial.print(".");
-                  delay(50);
-                }
-                ESP.restart();
-                break;
-              default:
-                break;
+            if (ok) {
+              DownloadStats stats = myBot.getDownloadStats();
+              report = "UPDATE OK (" + String(stats.bytesPerSecond) + " B/s).\nRestarting...";
+              myBot.sendMessage(msg, report.c_str());
+              // Wait until bot synced with telegram to prevent cyclic reboot
+              while (!myBot.getUpdates()) {
+                Serial.print(".");
+                delay(50);
+              }
+              ESP.restart();
+            }
+            else {
+              report = "UPDATE FAILED Error (" + String(Update.getError()) + ")";
+              myBot.sendMessage(msg, report.c_str());
             }
           } else {
             myBot.sendMessage(msg, "Error: file caption is not 'fw'");
@@ -68,7 +68,7 @@ void loop() {
 		message += "Message from @";
 		message += myBot.userName;
 		message += ":\n";
-		message += msg.text;
+		message += msg.text.c_str();
 		Serial.println(message);		
 		myBot.sendToChannel(channel, message, true);		
 
@@ -76,10 +76,10 @@ void loop() {
 		// Target user can find it's own userid with the bot @JsonDumpBot 
 		// https://t.me/JsonDumpBot 				
 		int32_t userid = 1234567890;	
-		myBot.sendToUser(userid, msg.text);	
+		myBot.sendTo(userid, msg.text.c_str());
 		
 		// echo the received message
-		myBot.sendMessage(msg, msg.text);
+		myBot.sendMessage(msg, msg.text.c_str());
 
 		// check if the message comes from a chat group (the group id is negative)
 		if (msg.chatId < 0) {
@@ -151,7 +151,7 @@ void loop() {
     switch (msgType) {
       case MessageText :
         // received a text message
-        tgReply = msg.text;
+        tgReply = msg.text.toString();
         Serial.print("\nText message received: ");
         Serial.println(tgReply);
 
@@ -164,7 +164,7 @@ void loop() {
         else {
           // write back feedback message and show a hint
           String text = "You write: \"";
-          text += msg.text;
+          text += msg.text.c_str();
           text += "\"\nTry /inline_keyboard1 or /inline_keyboard2";
           myBot.sendMessage(msg, text);
         }
@@ -138,7 +138,7 @@ void loop() {
     switch (msgType) {
       case MessageText :
         // received a text message
-        tgReply = msg.text;
+        tgReply = msg.text.toString();
         Serial.print("\nText message received: ");
         Serial.println(tgReply);
 
@@ -162,7 +162,7 @@ void loop() {
             isKeyboardActive = false;
           } else {
             // print every others messages received
-            myBot.sendMessage(msg, msg.text);
+            myBot.sendMessage(msg, msg.text.c_str());
           }
         } 
 
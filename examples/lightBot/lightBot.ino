@@ -7,6 +7,7 @@ Description: a simple example that do:
              2) if "LIGHT ON" message is received, turn on the onboard LED
              3) if "LIGHT OFF" message is received, turn off the onboard LED
              4) otherwise, reply to sender with a welcome message
+             Messages are handled with an event handler, loop() is free for other tasks
 
 */
 
@@ -20,6 +21,26 @@ const char* token = "XXXXXXXXXXXXXXXXXXXX";   	// REPLACE myToken WITH YOUR TELE
 
 const uint8_t LED = LED_BUILTIN;
 
+// Called as soon as a text message is received
+void onMessage(const TBMessage &msg) {
+	if (msg.text.equalsIgnoreCase("LIGHT ON")) {      // if the received message is "LIGHT ON"...
+		digitalWrite(LED, LOW);                           // turn on the LED (inverted logic!)
+		myBot.sendMessage(msg, "Light is now ON");        // notify the sender
+	}
+	else if (msg.text.equalsIgnoreCase("LIGHT OFF")) {        // if the received message is "LIGHT OFF"...
+		digitalWrite(LED, HIGH);                          // turn off the led (inverted logic!)
+		myBot.sendMessage(msg, "Light is now OFF");       // notify the sender
+	}
+	else {                                                    // otherwise...
+		// generate the message for the sender
+		String reply;
+		reply = "Welcome " ;
+		reply += msg.sender.username;
+		reply += ".\nTry LIGHT ON or LIGHT OFF (case insensitive)";
+		myBot.sendMessage(msg, reply);             // and send it
+	}
+}
+
 void setup() {
 	// initialize the Serial
 	Serial.begin(115200);
@@ -47,6 +68,9 @@ void setup() {
 	Serial.print("\nTest Telegram connection... ");
 	myBot.begin() ? Serial.println("OK") : Serial.println("NOK");
 
+	// Handle text messages as soon as they are received
+	myBot.onText(onMessage);
+
 	// set the pin connected to the LED to act as output pin
 	pinMode(LED, OUTPUT);
 	digitalWrite(LED, HIGH); // turn off the led (inverted logic!)
@@ -54,28 +78,5 @@ void setup() {
 }
 
 void loop() {
-	// a variable to store telegram message data
-	TBMessage msg;
-
-	// if there is an incoming message...
-	if (myBot.getNewMessage(msg)) {
-
-		if (msg.text.equalsIgnoreCase("LIGHT ON")) {      // if the received message is "LIGHT ON"...
-			digitalWrite(LED, LOW);                           // turn on the LED (inverted logic!)
-			myBot.sendMessage(msg, "Light is now ON");        // notify the sender
-		}
-		else if (msg.text.equalsIgnoreCase("LIGHT OFF")) {        // if the received message is "LIGHT OFF"...
-			digitalWrite(LED, HIGH);                          // turn off the led (inverted logic!)
-			myBot.sendMessage(msg, "Light is now OFF");       // notify the sender
-		}
-		else {                                                    // otherwise...
-			// generate the message for the sender
-			String reply;
-			reply = "Welcome " ;
-			reply += msg.sender.username;
-			reply += ".\nTry LIGHT ON or LIGHT OFF (case insensitive)";
-			myBot.sendMessage(msg, reply);             // and send it
-		}
-	}
-	
+	// Nothing to do here: incoming text messages are handled by onMessage()
 }
@@ -184,7 +184,7 @@ void loop() {
     if (msgType == MessageText){
       // Received a text message
       Serial.print("\nText message received: ");
-      Serial.println(msg.text);
+      Serial.println(msg.text.c_str());
 
       if (msg.text.equalsIgnoreCase("/photofs1")) {
         Serial.println("\nSending Photo from filesystem");          
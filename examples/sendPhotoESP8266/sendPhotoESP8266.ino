@@ -27,6 +27,18 @@
 #include "AsyncTelegram.h"
 
 AsyncTelegram myBot;
+
+// File downloaded from LAN, to be removed once uploaded (upload is asynchronous)
+String downloadedFile;
+
+void onUpload(UploadState state, uint32_t sent, uint32_t total) {
+  Serial.printf("Upload: %u/%u bytes\n", sent, total);
+  if ((state == UploadDone || state == UploadFailed) && downloadedFile.length()) {
+    LittleFS.remove("/" + downloadedFile);
+    downloadedFile = "";
+    listDir("/");
+  }
+}
 const char* ssid = "XXXXXXXXX";     // REPLACE mySSID WITH YOUR WIFI SSID
 const char* pass = "XXXXXXXXX";     // REPLACE myPassword YOUR WIFI PASSWORD, IF ANY
 const char* token = "XXXXXXXXX:XXXXXXXXXXXXXXXXXXXXXXX";   // REPLACE myToken WITH YOUR TELEGRAM BOT TOKEN
@@ -136,6 +148,7 @@ void setup() {
   // Set the Telegram bot properies
   myBot.setUpdateTime(1000);
   myBot.setTelegramToken(token);
+  myBot.setUploadCallback(onUpload);
 
   // Check if all things are ok
   Serial.print("\nTest Telegram connection... ");
@@ -172,7 +185,7 @@ void loop() {
     if (msgType == MessageText){
       // Received a text message
       Serial.print("\nText message received: ");
-      Serial.println(msg.text);
+      Serial.println(msg.text.c_str());
 
       if (msg.text.equalsIgnoreCase("/photofs1")) {
         Serial.println("\nSending Photo from filesystem");          
@@ -193,9 +206,10 @@ void loop() {
         listDir("/");    
         Serial.println("\nSending Photo from LAN: "); 
         Serial.println(url);          
-        myBot.sendPhotoByFile(msg.sender.id, fileName, LittleFS);
-        LittleFS.remove("/" + fileName);
-        listDir("/");          
+        if (myBot.sendPhotoByFile(msg.sender.id, fileName, LittleFS))
+          downloadedFile = fileName;
+        else
+          LittleFS.remove("/" + fileName);
       }
 
       else if (msg.text.indexOf("/photoweb>") > -1 ) {          
@@ -0,0 +1,101 @@
+// Cost of decoding one update for each MessageType: getNewMessage() of the updates already
+// received in a batch, without the getUpdates request.
+// Usage: bench_decode [--quick] [batches]
+#include <AsyncTelegram.h>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include "HostHeap.h"
+#include "HostNetwork.h"
+#include "FakeTelegramServer.h"
+#include "HostTest.h"
+#include "workload.h"
+
+static FakeTelegramServer server;
+static AsyncTelegram bot;
+
+// Document is sized for MAX_UPDATES_BATCH updates, but JSON slots hold pointers: fewer updates
+// are sent in a batch, so each one gets the same number of slots of a 32 bit core
+static const size_t UPDATES_PER_BATCH = MAX_UPDATES_BATCH / (sizeof(void *) / 4);
+
+static void loopOnce()
+{
+#if defined(ESP8266)
+	run_scheduled_functions();
+#endif
+}
+
+static MessageType nextMessage(TBMessage &msg)
+{
+	uint32_t start = millis();
+	while (millis() - start < 5000) {
+		MessageType type = bot.getNewMessage(msg);
+		if (type != MessageNoData)
+			return type;
+		loopOnce();
+	}
+	return MessageNoData;
+}
+
+static void benchType(const WorkloadUpdate &update, int batches)
+{
+	std::vector<uint32_t> samples;
+	samples.reserve(batches * (UPDATES_PER_BATCH - 1));
+	uint64_t allocations = 0;
+	int errors = 0;
+
+	for (int b = 0; b < batches; b++) {
+		for (size_t i = 0; i < UPDATES_PER_BATCH; i++)
+			CHECK(server.pushUpdate(update.json));
+		// First update of the batch comes with the getUpdates reply
+		TBMessage msg;
+		if (nextMessage(msg) != update.type)
+			errors++;
+		// Others are only decoded
+		for (size_t i = 1; i < UPDATES_PER_BATCH; i++) {
+			uint64_t a = HostHeap::threadAllocations();
+			auto t = std::chrono::steady_clock::now();
+			MessageType type = bot.getNewMessage(msg);
+			samples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t).count());
+			allocations += HostHeap::threadAllocations() - a;
+			if (type != update.type)
+				errors++;
+		}
+		loopOnce();
+	}
+
+	std::sort(samples.begin(), samples.end());
+	uint64_t sum = 0;
+	for (uint32_t s : samples)
+		sum += s;
+	printf("%-16s %10.0f %10u %10u", update.name, (double) sum / samples.size(), samples[samples.size() / 2],
+	       samples[samples.size() * 99 / 100]);
+	if (HostHeap::enabled())
+		printf(" %10.2f", (double) allocations / samples.size());
+	printf("\n");
+	CHECK(errors == 0);
+}
+
+int main(int argc, char **argv)
+{
+	bool quick = hasArg(argc, argv, "--quick");
+	int batches = quick ? 10 : 1000;
+	if (argc > 1 && atoi(argv[argc - 1]) > 0)
+		batches = atoi(argv[argc - 1]);
+
+	Serial.setOutput(nullptr);
+	CHECK(server.start());
+	HostNetwork::redirect("127.0.0.1", server.port());
+
+	bot.setTelegramToken("123456:HOST-BENCH");
+	bot.setInsecure(true);
+	bot.setUpdateTime(0);
+	bot.setUpdateBatch(MAX_UPDATES_BATCH);
+	CHECK(bot.begin());
+
+	printf("%s, %d batches of %u updates for each type\n", ESP_FLAVOR, batches, (unsigned) UPDATES_PER_BATCH);
+	printf("%-16s %10s %10s %10s%s\n", "update", "mean (ns)", "p50 (ns)", "p99 (ns)", HostHeap::enabled() ? "     allocs" : "");
+	for (const WorkloadUpdate &update : WORKLOAD)
+		benchType(update, batches);
+	return finish();
+}
@@ -0,0 +1,138 @@
+// Cost of dispatching a callback query to the handler of its inline button, with up to
+// hundreds of buttons in the keyboard.
+// "1.1.3" is the dispatch of version 1.1.3 (list of buttons walked with strstr()), reproduced
+// here and timed alone; "getNewMessage" is the decoding of a callback query already received,
+// handler lookup included: the row without buttons is the cost of decoding only.
+// Usage: bench_dispatch [--quick] [queries]
+#include <AsyncTelegram.h>
+#include <chrono>
+#include <vector>
+#include "HostNetwork.h"
+#include "FakeTelegramServer.h"
+#include "HostTest.h"
+
+static FakeTelegramServer server;
+static AsyncTelegram bot;
+static const int BUTTONS_PER_ROW = 8;
+
+static uint32_t calls = 0;
+static void onButton(const TBMessage &) { calls++; }
+
+// Buttons of 1.1.3: a list walked for each query, data matched with strstr()
+struct OldButton {
+	char data[16];
+	std::function<void(const TBMessage &)> callback;
+	OldButton *next = nullptr;
+};
+
+static void oldCheckCallback(OldButton *first, const TBMessage &msg)
+{
+	char *buttonName = (char *) msg.callbackQueryData;
+	for (OldButton *button = first; button != nullptr; button = button->next) {
+		if (strstr(button->data, buttonName) != nullptr && button->callback != nullptr)
+			button->callback(msg);
+	}
+}
+
+static double benchOld(int buttons, int queries)
+{
+	std::vector<OldButton> list(buttons);
+	for (int i = 0; i < buttons; i++) {
+		snprintf(list[i].data, sizeof(list[i].data), "btn%d", i);
+		list[i].callback = onButton;
+		list[i].next = i + 1 < buttons ? &list[i + 1] : nullptr;
+	}
+	char data[16];
+	TBMessage msg;
+	msg.callbackQueryData = data;
+	auto t = std::chrono::steady_clock::now();
+	for (int q = 0; q < queries; q++) {
+		snprintf(data, sizeof(data), "btn%d", buttons ? q % buttons : 0);
+		oldCheckCallback(buttons ? &list[0] : nullptr, msg);
+	}
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t).count() / queries;
+}
+
+static MessageType nextMessage(TBMessage &msg)
+{
+	uint32_t start = millis();
+	while (millis() - start < 5000) {
+		MessageType type = bot.getNewMessage(msg);
+		if (type != MessageNoData)
+			return type;
+		run_scheduled_functions();
+	}
+	return MessageNoData;
+}
+
+static double benchBot(int buttons, int queries)
+{
+	// Keyboard sent by the bot is the one checked by getNewMessage()
+	InlineKeyboard keyboard;
+	char text[24], data[16];
+	for (int i = 0; i < buttons; i++) {
+		if (i > 0 && i % BUTTONS_PER_ROW == 0)
+			keyboard.addRow();
+		snprintf(text, sizeof(text), "Button %d", i);
+		snprintf(data, sizeof(data), "btn%d", i);
+		keyboard.addButton(text, data, KeyboardButtonQuery, onButton);
+	}
+	TBMessage chat;
+	chat.chatId = 42;
+	chat.sender.id = 42;
+	CHECK(bot.sendMessage(chat, "Buttons", keyboard));
+
+	char update[256];
+	uint32_t expected = calls;
+	double time = 0;
+	int timed = 0;
+	for (int q = 0; q < queries;) {
+		for (size_t i = 0; i < MAX_UPDATES_BATCH; i++, q++) {
+			snprintf(update, sizeof(update), "{\"callback_query\":{\"id\":\"%d\",\"from\":{\"id\":42,\"first_name\":\"Ann\"},"
+			         "\"chat_instance\":\"-1234\",\"data\":\"btn%d\"}}", q + 1, buttons ? q % buttons : 0);
+			CHECK(server.pushUpdate(update));
+			if (buttons > 0)
+				expected++;
+		}
+		// First query comes with the getUpdates reply, the others are only decoded
+		TBMessage msg;
+		CHECK(nextMessage(msg) == MessageQuery);
+		for (size_t i = 1; i < MAX_UPDATES_BATCH; i++) {
+			auto t = std::chrono::steady_clock::now();
+			MessageType type = bot.getNewMessage(msg);
+			time += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t).count();
+			timed++;
+			CHECK(type == MessageQuery);
+		}
+		run_scheduled_functions();
+	}
+	CHECK(calls == expected);
+	return time / timed;
+}
+
+int main(int argc, char **argv)
+{
+	bool quick = hasArg(argc, argv, "--quick");
+	int queries = quick ? 80 : 8000;
+	if (argc > 1 && atoi(argv[argc - 1]) > 0)
+		queries = atoi(argv[argc - 1]);
+
+	Serial.setOutput(nullptr);
+	CHECK(server.start());
+	HostNetwork::redirect("127.0.0.1", server.port());
+	bot.setTelegramToken("123456:HOST-BENCH");
+	bot.setInsecure(true);
+	bot.setUpdateTime(0);
+	bot.setRateLimit(false);
+	bot.setUpdateBatch(MAX_UPDATES_BATCH);
+	CHECK(bot.begin());
+
+	printf("%s, %d queries for each keyboard\n", ESP_FLAVOR, queries);
+	printf("%-8s %14s %20s\n", "buttons", "1.1.3 (us)", "getNewMessage (us)");
+	for (int buttons : {0, 10, 100, 300, 500}) {
+		double before = benchOld(buttons, queries);
+		double after = benchBot(buttons, queries);
+		printf("%-8d %14.3f %20.3f\n", buttons, before, after);
+	}
+	return finish();
+}
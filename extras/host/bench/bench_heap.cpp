@@ -0,0 +1,186 @@
+// Peak heap used to receive and decode one update on ESP8266, before and after reading
+// getUpdates replies straight from the socket.
+// "before" is the reply handling of version 1.1.3 (payload String filled one byte at time,
+// substring() of the JSON body, DynamicJsonDocument of BUFFER_BIG for each update), reproduced
+// here on the same connection type; "after" is the library.
+// Usage: bench_heap [--quick] [rounds]
+#include <AsyncTelegram.h>
+#include "HostHeap.h"
+#include "HostNetwork.h"
+#include "FakeTelegramServer.h"
+#include "HostTest.h"
+#include "workload.h"
+
+static FakeTelegramServer server;
+static AsyncTelegram bot;
+static const char *TOKEN = "123456:HOST-BENCH";
+
+// JSON slots hold pointers: documents of the old path get the same number of slots of a 32 bit core
+static const size_t HOST_SLOT_SCALE = sizeof(void *) / 4;
+
+struct HeapSample {
+	size_t      peak = 0;
+	uint64_t    allocations = 0;
+	uint32_t    count = 0;
+
+	void add(size_t p, uint64_t a)
+	{
+		if (p > peak)
+			peak = p;
+		allocations += a;
+		count++;
+	}
+	double meanAllocations() const { return count ? (double) allocations / count : 0; }
+};
+
+// getUpdates() and getNewMessage() of 1.1.3, for one update
+static bool baselineUpdate(WiFiClientSecure &client, uint32_t &lastUpdate, String &text)
+{
+	String param((char *) 0);
+	param.reserve(64);
+	DynamicJsonDocument root(BUFFER_SMALL * HOST_SLOT_SCALE);
+	root["limit"] = 1;
+	root["timeout"] = 3;
+	root["allowed_updates"] = "message,callback_query";
+	if (lastUpdate != 0)
+		root["offset"] = lastUpdate;
+	serializeJson(root, param);
+
+	String request;
+	request.reserve(BUFFER_MEDIUM);
+	request = "POST https://" TELEGRAM_HOST "/bot";
+	request += TOKEN;
+	request += "/getUpdates HTTP/1.1\nHost: api.telegram.org\nConnection: keep-alive\nContent-Type: application/json";
+	request += "\nContent-Length: ";
+	request += param.length();
+	request += "\n\n";
+	request += param;
+	client.print(request);
+
+	// Bytes are appended while available, until the whole reply is in payload
+	String payload;
+	uint32_t start = millis();
+	int bodyStart = -1, bodyLength = 0;
+	while (millis() - start < 5000) {
+		while (client.available())
+			payload += (char) client.read();
+		if (bodyStart < 0 && (bodyStart = payload.indexOf("\r\n\r\n")) >= 0) {
+			int cl = payload.indexOf("Content-Length: ");
+			bodyLength = cl >= 0 ? atoi(payload.c_str() + cl + 16) : 0;
+			bodyStart += 4;
+		}
+		if (bodyStart >= 0 && (int) payload.length() >= bodyStart + bodyLength)
+			break;
+		delay(0);
+	}
+	if (payload.length() == 0)
+		return false;
+	payload = payload.substring(payload.indexOf("{\"ok\":"), payload.length());
+
+	DynamicJsonDocument doc(BUFFER_BIG * HOST_SLOT_SCALE);
+	deserializeJson(doc, payload);
+	payload.clear();
+	if (!doc["ok"].as<bool>())
+		return false;
+	uint32_t updateID = doc["result"][0]["update_id"];
+	if (updateID == 0)
+		return false;
+	lastUpdate = updateID + 1;
+	// Text was copied in a String
+	if (doc["result"][0]["callback_query"]["id"])
+		text = doc["result"][0]["callback_query"]["message"]["text"].as<String>();
+	else
+		text = doc["result"][0]["message"]["text"].as<String>();
+	return true;
+}
+
+static MessageType botUpdate()
+{
+	TBMessage msg;
+	uint32_t start = millis();
+	while (millis() - start < 5000) {
+		MessageType type = bot.getNewMessage(msg);
+		if (type != MessageNoData)
+			return type;
+		run_scheduled_functions();
+	}
+	return MessageNoData;
+}
+
+int main(int argc, char **argv)
+{
+	bool quick = hasArg(argc, argv, "--quick");
+	int rounds = quick ? 1 : 20;
+	if (argc > 1 && atoi(argv[argc - 1]) > 0)
+		rounds = atoi(argv[argc - 1]);
+	if (!HostHeap::enabled()) {
+		printf("Heap tracking is disabled (sanitizer build)\n");
+		return finish();
+	}
+
+	Serial.setOutput(nullptr);
+	CHECK(server.start());
+	HostNetwork::redirect("127.0.0.1", server.port());
+
+	HeapSample before[WORKLOAD_SIZE], after[WORKLOAD_SIZE];
+
+	// Before
+	{
+		WiFiClientSecure client;
+		client.setInsecure();
+		CHECK(client.connect(TELEGRAM_HOST, TELEGRAM_PORT));
+		uint32_t lastUpdate = 0;
+		String text;
+		text.reserve(8);
+		for (int r = 0; r < rounds; r++) {
+			for (size_t i = 0; i < WORKLOAD_SIZE; i++) {
+				server.pushUpdate(WORKLOAD[i].json);
+				HostHeap::Stats start = HostHeap::stats();
+				HostHeap::resetPeak();
+				CHECK(baselineUpdate(client, lastUpdate, text));
+				HostHeap::Stats end = HostHeap::stats();
+				before[i].add(end.peak - start.current, end.allocations - start.allocations);
+			}
+		}
+		// Last update is confirmed by the next request
+		baselineUpdate(client, lastUpdate, text);
+		client.stop();
+	}
+
+	// After
+	bot.setTelegramToken(TOKEN);
+	bot.setInsecure(true);
+	bot.setUpdateTime(0);
+	// Document of BUFFER_BIG bytes for each update of the batch: same number of slots of the old path
+	bot.setUpdateBatch(HOST_SLOT_SCALE);
+	size_t initial = HostHeap::stats().current;
+	CHECK(bot.begin());
+	size_t idle = HostHeap::stats().current;
+	for (int r = 0; r < rounds; r++) {
+		for (size_t i = 0; i < WORKLOAD_SIZE; i++) {
+			server.pushUpdate(WORKLOAD[i].json);
+			HostHeap::Stats start = HostHeap::stats();
+			HostHeap::resetPeak();
+			MessageType type = botUpdate();
+			CHECK(type == WORKLOAD[i].type);
+			HostHeap::Stats end = HostHeap::stats();
+			// Peak above heap used by the bot while idle (the update document stays allocated)
+			after[i].add(end.peak - (start.current < idle ? start.current : idle), end.allocations - start.allocations);
+		}
+	}
+	size_t retained = HostHeap::stats().current - idle;
+
+	printf("esp8266, %d rounds of %u updates\n", rounds, (unsigned) WORKLOAD_SIZE);
+	printf("%-16s %22s %22s\n", "", "before", "after");
+	printf("%-16s %10s %11s %10s %11s\n", "update", "peak (B)", "allocs", "peak (B)", "allocs");
+	size_t maxBefore = 0, maxAfter = 0;
+	for (size_t i = 0; i < WORKLOAD_SIZE; i++) {
+		printf("%-16s %10u %11.1f %10u %11.1f\n", WORKLOAD[i].name, (unsigned) before[i].peak, before[i].meanAllocations(),
+		       (unsigned) after[i].peak, after[i].meanAllocations());
+		maxBefore = before[i].peak > maxBefore ? before[i].peak : maxBefore;
+		maxAfter = after[i].peak > maxAfter ? after[i].peak : maxAfter;
+	}
+	printf("%-16s %10u %22u\n", "max peak", (unsigned) maxBefore, (unsigned) maxAfter);
+	printf("heap used by begin()   %u bytes, kept after the updates %u bytes\n", (unsigned) (idle - initial), (unsigned) retained);
+	return finish();
+}
@@ -0,0 +1,224 @@
+// Time, allocations and peak heap to build inline and reply keyboards of 10, 50 and 100 buttons
+// and get their JSON, before and after the compact button model.
+// "before" are InlineKeyboard and ReplyKeyboard of version 1.1.3 (JSON document deserialized,
+// changed and serialized again by each call), reproduced here.
+// Usage: bench_keyboard [--quick] [repetitions]
+#include <AsyncTelegram.h>
+#include <chrono>
+#include "HostHeap.h"
+#include "HostTest.h"
+
+static const int BUTTONS_PER_ROW = 4;
+
+class OldInlineKeyboard {
+public:
+	OldInlineKeyboard() { m_json = "{\"inline_keyboard\":[[]]}\""; }
+	~OldInlineKeyboard()
+	{
+		for (Button *b = m_first; b != nullptr;) {
+			Button *next = b->next;
+			delete b;
+			b = next;
+		}
+	}
+
+	bool addRow()
+	{
+		if (m_jsonSize < BUFFER_MEDIUM) m_jsonSize = BUFFER_MEDIUM;
+		DynamicJsonDocument doc(m_jsonSize + 128);
+		deserializeJson(doc, m_json);
+		JsonArray rows = doc["inline_keyboard"];
+		rows.createNestedArray();
+		m_json.clear();
+		serializeJson(doc, m_json);
+		doc.shrinkToFit();
+		m_jsonSize = doc.memoryUsage();
+		return true;
+	}
+
+	bool addButton(const char *text, const char *command, InlineKeyboardButtonType buttonType)
+	{
+		Button *button = new Button();
+		if (m_first == nullptr)
+			m_first = button;
+		else
+			m_last->next = button;
+		button->name = command;
+		m_last = button;
+
+		if (m_jsonSize < BUFFER_MEDIUM) m_jsonSize = BUFFER_MEDIUM;
+		DynamicJsonDocument doc(m_jsonSize + 256);
+		deserializeJson(doc, m_json);
+		JsonArray rows = doc["inline_keyboard"];
+		JsonObject obj = rows[rows.size() - 1].createNestedObject();
+		obj["text"] = text;
+		if (buttonType == KeyboardButtonURL)
+			obj["url"] = command;
+		else
+			obj["callback_data"] = command;
+		m_json.clear();
+		serializeJson(doc, m_json);
+		doc.shrinkToFit();
+		m_jsonSize = doc.memoryUsage();
+		return true;
+	}
+
+	String getJSON() const { return m_json; }
+
+private:
+	struct Button {
+		const char *name;
+		std::function<void(const TBMessage &)> callback;
+		Button *next = nullptr;
+	};
+	Button *m_first = nullptr, *m_last = nullptr;
+	String m_json;
+	size_t m_jsonSize = BUFFER_MEDIUM;
+};
+
+class OldReplyKeyboard {
+public:
+	OldReplyKeyboard() { m_json = "{\"keyboard\":[[]]}\""; }
+
+	bool addRow()
+	{
+		if (m_jsonSize < BUFFER_MEDIUM) m_jsonSize = BUFFER_MEDIUM;
+		DynamicJsonDocument doc(m_jsonSize + 128);
+		deserializeJson(doc, m_json);
+		JsonArray rows = doc["keyboard"];
+		rows.createNestedArray();
+		m_json.clear();
+		serializeJson(doc, m_json);
+		doc.shrinkToFit();
+		m_jsonSize = doc.memoryUsage();
+		return true;
+	}
+
+	bool addButton(const char *text, ReplyKeyboardButtonType buttonType = KeyboardButtonSimple)
+	{
+		if (m_jsonSize < BUFFER_MEDIUM) m_jsonSize = BUFFER_MEDIUM;
+		DynamicJsonDocument doc(m_jsonSize + 256);
+		deserializeJson(doc, m_json);
+		JsonArray rows = doc["keyboard"];
+		JsonObject obj = rows[rows.size() - 1].createNestedObject();
+		obj["text"] = text;
+		if (buttonType == KeyboardButtonContact)
+			obj["request_contact"] = true;
+		else if (buttonType == KeyboardButtonLocation)
+			obj["request_location"] = true;
+		m_json.clear();
+		serializeJson(doc, m_json);
+		doc.shrinkToFit();
+		m_jsonSize = doc.memoryUsage();
+		return true;
+	}
+
+	void enableResize()
+	{
+		if (m_jsonSize < BUFFER_MEDIUM) m_jsonSize = BUFFER_MEDIUM;
+		DynamicJsonDocument doc(m_jsonSize + 128);
+		deserializeJson(doc, m_json);
+		doc["resize_keyboard"] = true;
+		m_json.clear();
+		serializeJson(doc, m_json);
+	}
+
+	String getJSON() const { return m_json; }
+
+private:
+	String m_json;
+	size_t m_jsonSize = BUFFER_MEDIUM;
+};
+
+template <typename Keyboard>
+static String buildInline(Keyboard &keyboard, int buttons)
+{
+	char text[24], data[16];
+	for (int i = 0; i < buttons; i++) {
+		if (i > 0 && i % BUTTONS_PER_ROW == 0)
+			keyboard.addRow();
+		snprintf(text, sizeof(text), "Button %d", i);
+		snprintf(data, sizeof(data), "btn%d", i);
+		keyboard.addButton(text, data, KeyboardButtonQuery);
+	}
+	return keyboard.getJSON();
+}
+
+template <typename Keyboard>
+static String buildReply(Keyboard &keyboard, int buttons)
+{
+	char text[24];
+	for (int i = 0; i < buttons; i++) {
+		if (i > 0 && i % BUTTONS_PER_ROW == 0)
+			keyboard.addRow();
+		snprintf(text, sizeof(text), "Button %d", i);
+		keyboard.addButton(text, i == 0 ? KeyboardButtonLocation : KeyboardButtonSimple);
+	}
+	keyboard.enableResize();
+	return keyboard.getJSON();
+}
+
+struct Result {
+	double      time = 0;       // us for each keyboard
+	double      allocations = 0;
+	size_t      peak = 0;
+	String      json;
+};
+
+// Keyboard is created, built and destroyed at each repetition
+template <typename Keyboard, typename Build>
+static Result measure(int buttons, int repetitions, Build build)
+{
+	Result result;
+	HostHeap::Stats start = HostHeap::stats();
+	HostHeap::resetPeak();
+	auto t = std::chrono::steady_clock::now();
+	for (int r = 0; r < repetitions; r++) {
+		Keyboard keyboard;
+		String json = build(keyboard, buttons);
+		if (r == 0)
+			result.json = json;
+	}
+	result.time = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t).count() / repetitions;
+	HostHeap::Stats end = HostHeap::stats();
+	// First JSON is kept
+	result.allocations = (double) (end.allocations - start.allocations - 1) / repetitions;
+	result.peak = end.peak - start.current;
+	return result;
+}
+
+static void print(const char *name, int buttons, const Result &before, const Result &after)
+{
+	printf("%-8s %7d %12.1f %12.1f", name, buttons, before.time, after.time);
+	if (HostHeap::enabled())
+		printf(" %9.1f %9.1f %9u %9u", before.allocations, after.allocations, (unsigned) before.peak, (unsigned) after.peak);
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	bool quick = hasArg(argc, argv, "--quick");
+	int repetitions = quick ? 3 : 200;
+	if (argc > 1 && atoi(argv[argc - 1]) > 0)
+		repetitions = atoi(argv[argc - 1]);
+
+	printf("%d repetitions, %d buttons for each row\n", repetitions, BUTTONS_PER_ROW);
+	printf("%-8s %7s %12s %12s", "keyboard", "buttons", "before (us)", "after (us)");
+	if (HostHeap::enabled())
+		printf(" %9s %9s %9s %9s", "allocs", "allocs", "peak (B)", "peak (B)");
+	printf("\n");
+
+	for (int buttons : {10, 50, 100}) {
+		Result before = measure<OldInlineKeyboard>(buttons, repetitions, buildInline<OldInlineKeyboard>);
+		Result after = measure<InlineKeyboard>(buttons, repetitions, buildInline<InlineKeyboard>);
+		print("inline", buttons, before, after);
+		CHECK(before.json == after.json);
+	}
+	for (int buttons : {10, 50, 100}) {
+		Result before = measure<OldReplyKeyboard>(buttons, repetitions, buildReply<OldReplyKeyboard>);
+		Result after = measure<ReplyKeyboard>(buttons, repetitions, buildReply<ReplyKeyboard>);
+		print("reply", buttons, before, after);
+		CHECK(before.json.length() == after.json.length());
+	}
+	return finish();
+}
@@ -0,0 +1,197 @@
+// Cost of sendMessage() with inline keyboards of 10, 50 and 100 buttons on ESP8266: time to
+// write the request, allocations and peak heap, before and after splicing the keyboard JSON.
+// "before" is sendMessage() of version 1.1.3 (keyboard deserialized in a second document, copied
+// in the message document, serialized in a String, then copied in the request String), reproduced
+// here on the same connection type. Its documents were 2048 and 1028 bytes, too small for these
+// keyboards: here they are sized to fit, as a sketch would have to do.
+// Usage: bench_send [--quick] [messages]
+#include <AsyncTelegram.h>
+#include <chrono>
+#include "HostHeap.h"
+#include "HostNetwork.h"
+#include "FakeTelegramServer.h"
+#include "HostTest.h"
+
+static FakeTelegramServer server;
+static AsyncTelegram bot;
+static const char *TOKEN = "123456:HOST-BENCH";
+static const char *TEXT = "Choose the lights to turn on";
+static const int BUTTONS_PER_ROW = 4;
+
+// JSON slots hold pointers: same number of slots of a 32 bit core
+static const size_t HOST_SLOT_SCALE = sizeof(void *) / 4;
+
+// sendMessage() and postCommand() of 1.1.3
+static void oldSendMessage(WiFiClientSecure &client, const TBMessage &msg, const char *message, String keyboard)
+{
+	size_t capacity = (BUFFER_BIG > keyboard.length() * 2 ? BUFFER_BIG : keyboard.length() * 2) * HOST_SLOT_SCALE;
+	DynamicJsonDocument root(capacity);
+	root["chat_id"] = msg.sender.id != 0 ? msg.sender.id : msg.chatId;
+	root["text"] = message;
+	if (msg.isMarkdownEnabled)
+		root["parse_mode"] = "MarkdownV2";
+	if (keyboard.length() != 0) {
+		DynamicJsonDocument doc(capacity);
+		deserializeJson(doc, keyboard);
+		JsonObject myKeyb = doc.as<JsonObject>();
+		root["reply_markup"] = myKeyb;
+		if (msg.force_reply) {
+			root["reply_markup"]["selective"] = true;
+			root["reply_markup"]["force_reply"] = true;
+		}
+	}
+	String param;
+	serializeJson(root, param);
+
+	String request;
+	request.reserve(BUFFER_MEDIUM);
+	request = "POST https://" TELEGRAM_HOST "/bot";
+	request += TOKEN;
+	request += "/sendMessage HTTP/1.1\nHost: api.telegram.org\nConnection: keep-alive\nContent-Type: application/json";
+	request += "\nContent-Length: ";
+	request += strlen(param.c_str());
+	request += "\n\n";
+	request += param;
+	client.print(request);
+}
+
+// Read the reply, as the next getUpdates would do
+static bool skipReply(WiFiClientSecure &client)
+{
+	char header[256];
+	size_t used = 0;
+	int bodyLength = -1;
+	uint32_t start = millis();
+	while (millis() - start < 5000) {
+		if (!client.available()) {
+			delay(0);
+			continue;
+		}
+		char c = client.read();
+		if (bodyLength < 0) {
+			if (used < sizeof(header) - 1)
+				header[used++] = c;
+			header[used] = '\0';
+			if (strstr(header, "\r\n\r\n") != nullptr) {
+				const char *cl = strstr(header, "Content-Length: ");
+				bodyLength = cl != nullptr ? atoi(cl + 16) : 0;
+				if (bodyLength == 0)
+					return true;
+			}
+		}
+		else if (--bodyLength == 0)
+			return true;
+	}
+	return false;
+}
+
+static void buildKeyboard(InlineKeyboard &keyboard, int buttons)
+{
+	char text[32], data[24];
+	for (int i = 0; i < buttons; i++) {
+		if (i > 0 && i % BUTTONS_PER_ROW == 0)
+			keyboard.addRow();
+		snprintf(text, sizeof(text), "Kitchen light %d", i);
+		snprintf(data, sizeof(data), "light%d", i);
+		keyboard.addButton(text, data, KeyboardButtonQuery);
+	}
+}
+
+struct Result {
+	double      time = 0;       // us for each message
+	double      allocations = 0;
+	size_t      peak = 0;
+	size_t      body = 0;
+
+	void print(const char *name)
+	{
+		printf("  %-8s %10.1f", name, time);
+		if (HostHeap::enabled())
+			printf(" %10.1f %10u", allocations, (unsigned) peak);
+		printf(" %10u\n", (unsigned) body);
+	}
+};
+
+template <typename Send, typename Drain>
+static Result measure(int count, Send send, Drain drain)
+{
+	Result result;
+	uint32_t sent = server.requestCount("sendMessage");
+	double time = 0;
+	uint64_t allocations = 0;
+	for (int i = 0; i < count; i++) {
+		HostHeap::Stats start = HostHeap::stats();
+		HostHeap::resetPeak();
+		uint64_t a = HostHeap::threadAllocations();
+		auto t = std::chrono::steady_clock::now();
+		send();
+		time += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t).count();
+		allocations += HostHeap::threadAllocations() - a;
+		size_t peak = HostHeap::stats().peak - start.current;
+		if (peak > result.peak)
+			result.peak = peak;
+		drain();
+	}
+	CHECK(server.waitRequests("sendMessage", sent + count, 5000));
+	FakeTelegramServer::Request request;
+	CHECK(server.lastRequest("sendMessage", request));
+	result.body = request.length;
+	result.time = time / count;
+	result.allocations = (double) allocations / count;
+	return result;
+}
+
+int main(int argc, char **argv)
+{
+	bool quick = hasArg(argc, argv, "--quick");
+	int count = quick ? 5 : 500;
+	if (argc > 1 && atoi(argv[argc - 1]) > 0)
+		count = atoi(argv[argc - 1]);
+	if (!HostHeap::enabled())
+		printf("Heap tracking is disabled (sanitizer build)\n");
+
+	Serial.setOutput(nullptr);
+	CHECK(server.start());
+	HostNetwork::redirect("127.0.0.1", server.port());
+
+	WiFiClientSecure client;
+	client.setInsecure();
+	CHECK(client.connect(TELEGRAM_HOST, TELEGRAM_PORT));
+
+	bot.setTelegramToken(TOKEN);
+	bot.setInsecure(true);
+	// getUpdates only once a second, replies of sendMessage are read by getNewMessage()
+	bot.setUpdateTime(1000);
+	bot.setRateLimit(false);
+	CHECK(bot.begin());
+
+	TBMessage msg;
+	msg.chatId = 42;
+	msg.sender.id = 42;
+	msg.force_reply = true;
+
+	printf("esp8266, %d messages for each keyboard\n", count);
+	printf("  %-8s %10s", "", "time (us)");
+	if (HostHeap::enabled())
+		printf(" %10s %10s", "allocs", "peak (B)");
+	printf(" %10s\n", "body (B)");
+	for (int buttons : {10, 50, 100}) {
+		InlineKeyboard keyboard;
+		buildKeyboard(keyboard, buttons);
+		String json = keyboard.getJSON();
+		printf("%d buttons, keyboard %u bytes\n", buttons, (unsigned) json.length());
+
+		Result before = measure(count, [&]() { oldSendMessage(client, msg, TEXT, json); },
+		                        [&]() { CHECK(skipReply(client)); });
+		before.print("before");
+
+		Result after = measure(count, [&]() { bot.sendMessage(msg, TEXT, keyboard); },
+		                       [&]() {
+			                       TBMessage in;
+			                       bot.getNewMessage(in);
+			                       run_scheduled_functions();
+		                       });
+		after.print("after");
+	}
+	return finish();
+}
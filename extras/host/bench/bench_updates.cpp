@@ -0,0 +1,158 @@
+// Throughput of update handling against the fake server: updates/s, getNewMessage() and
+// sendMessage() latency and heap allocations for each update.
+// Usage: bench_updates [--quick] [updates]
+#include <AsyncTelegram.h>
+#include <vector>
+#include <algorithm>
+#include "HostHeap.h"
+#include "HostNetwork.h"
+#include "FakeTelegramServer.h"
+#include "HostTest.h"
+
+static FakeTelegramServer server;
+static AsyncTelegram bot;
+
+static const char *UPDATE =
+	"{\"message\":{\"message_id\":%d,\"from\":{\"id\":42,\"is_bot\":false,\"first_name\":\"Ann\",\"username\":\"ann\","
+	"\"language_code\":\"en\"},\"chat\":{\"id\":42,\"first_name\":\"Ann\",\"username\":\"ann\",\"type\":\"private\"},"
+	"\"date\":1700000000,\"text\":\"/light on kitchen %d\"}}";
+
+struct Latency {
+	std::vector<uint32_t> samples;
+
+	void print(const char *name)
+	{
+		if (samples.empty())
+			return;
+		std::sort(samples.begin(), samples.end());
+		uint64_t sum = 0;
+		for (uint32_t s : samples)
+			sum += s;
+		printf("%-22s mean %6.1f us  p50 %5u us  p99 %5u us  max %6u us\n", name, (double) sum / samples.size(),
+		       samples[samples.size() / 2], samples[samples.size() * 99 / 100], samples.back());
+	}
+};
+
+static void loopOnce()
+{
+#if defined(ESP8266)
+	run_scheduled_functions();
+#endif
+}
+
+static void benchUpdates(int count)
+{
+	Latency latency;
+	latency.samples.reserve(count);
+	char update[512];
+	int pushed = 0, received = 0;
+	uint64_t loopAllocations = 0;
+	HostHeap::Stats before = HostHeap::stats();
+	uint32_t start = millis();
+
+	while (received < count && millis() - start < 60000) {
+		while (pushed < count) {
+			snprintf(update, sizeof(update), UPDATE, pushed + 1, pushed);
+			if (!server.pushUpdate(update))
+				break;
+			pushed++;
+		}
+		TBMessage msg;
+		uint64_t allocations = HostHeap::threadAllocations();
+		uint32_t t = micros();
+		MessageType type = bot.getNewMessage(msg);
+		t = micros() - t;
+		if (type != MessageNoData) {
+			latency.samples.push_back(t);
+			loopAllocations += HostHeap::threadAllocations() - allocations;
+			received++;
+		}
+		loopOnce();
+	}
+	uint32_t elapsed = millis() - start;
+	HostHeap::Stats after = HostHeap::stats();
+
+	printf("updates received       %d in %u ms: %.0f updates/s\n", received, elapsed, received * 1000.0 / (elapsed ? elapsed : 1));
+	latency.print("getNewMessage (update)");
+	if (HostHeap::enabled()) {
+		printf("allocations/update     %.2f all tasks, %.2f loop task\n",
+		       (double) (after.allocations - before.allocations) / (received ? received : 1),
+		       (double) loopAllocations / (received ? received : 1));
+	}
+	CHECK(received == count);
+}
+
+static void benchSend(int count)
+{
+	Latency latency;
+	latency.samples.reserve(count);
+	TBMessage msg;
+	msg.chatId = 42;
+	msg.sender.id = 42;
+	// getUpdates requests only once a second, so allocations are mostly due to sendMessage
+	bot.setUpdateTime(1000);
+	uint32_t sent = server.requestCount("sendMessage");
+	uint64_t loopAllocations = 0;
+	HostHeap::Stats before = HostHeap::stats();
+	uint32_t start = millis();
+
+	for (int i = 0; i < count; i++) {
+		uint64_t allocations = HostHeap::threadAllocations();
+		uint32_t t = micros();
+		bot.sendMessage(msg, "The light in the kitchen is on");
+		latency.samples.push_back(micros() - t);
+		loopAllocations += HostHeap::threadAllocations() - allocations;
+		TBMessage in;
+		bot.getNewMessage(in);
+		loopOnce();
+	}
+	while (server.requestCount("sendMessage") < sent + count && millis() - start < 60000) {
+		TBMessage in;
+		bot.getNewMessage(in);
+		loopOnce();
+		delay(1);
+	}
+	uint32_t elapsed = millis() - start;
+	HostHeap::Stats after = HostHeap::stats();
+	uint32_t delivered = server.requestCount("sendMessage") - sent;
+
+	printf("messages sent          %u in %u ms: %.0f messages/s\n", delivered, elapsed, delivered * 1000.0 / (elapsed ? elapsed : 1));
+	latency.print("sendMessage");
+	if (HostHeap::enabled()) {
+		printf("allocations/message    %.2f all tasks, %.2f loop task\n",
+		       (double) (after.allocations - before.allocations) / (count ? count : 1),
+		       (double) loopAllocations / (count ? count : 1));
+	}
+	CHECK(delivered == (uint32_t) count);
+}
+
+int main(int argc, char **argv)
+{
+	bool quick = hasArg(argc, argv, "--quick");
+	int count = quick ? 100 : 5000;
+	if (argc > 1 && atoi(argv[argc - 1]) > 0)
+		count = atoi(argv[argc - 1]);
+
+	Serial.setOutput(nullptr);
+	CHECK(server.start());
+	HostNetwork::redirect("127.0.0.1", server.port());
+
+	bot.setTelegramToken("123456:HOST-BENCH");
+	bot.setInsecure(true);
+	bot.setUpdateTime(0);
+	// No flood limits on a local server
+	bot.setRateLimit(false);
+	// sendMessage() waits for a free slot of the command queue (ESP32)
+	bot.setQueuePolicy(QueueBlock);
+	CHECK(bot.begin());
+
+	printf("%s, %d updates\n", ESP_FLAVOR, count);
+	HostHeap::resetPeak();
+	size_t baseHeap = HostHeap::stats().current;
+	benchUpdates(count);
+	benchSend(quick ? 50 : 1000);
+	if (HostHeap::enabled())
+		printf("heap                   %u bytes after begin(), peak +%u\n", (unsigned) baseHeap,
+		       (unsigned) (HostHeap::stats().peak - baseHeap));
+	return finish();
+}
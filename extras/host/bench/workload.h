@@ -0,0 +1,80 @@
+#ifndef HOST_BENCH_WORKLOAD_H
+#define HOST_BENCH_WORKLOAD_H
+
+#include <AsyncTelegram.h>
+
+// Updates of the benchmarks, in the same layout of Bot API replies (field order and optional
+// fields as sent by the server to a private chat). "update_id" is added by the fake server.
+struct WorkloadUpdate {
+	const char*     name;
+	MessageType     type;
+	const char*     json;
+};
+
+static const WorkloadUpdate WORKLOAD[] = {
+	{"text", MessageText,
+	 "{\"message\":{\"message_id\":1021,\"from\":{\"id\":123456789,\"is_bot\":false,\"first_name\":\"Anna\","
+	 "\"last_name\":\"Rossi\",\"username\":\"anna_rossi\",\"language_code\":\"it\"},\"chat\":{\"id\":123456789,"
+	 "\"first_name\":\"Anna\",\"last_name\":\"Rossi\",\"username\":\"anna_rossi\",\"type\":\"private\"},"
+	 "\"date\":1700000000,\"text\":\"Turn on the light in the kitchen please\"}}"},
+
+	{"command", MessageText,
+	 "{\"message\":{\"message_id\":1022,\"from\":{\"id\":123456789,\"is_bot\":false,\"first_name\":\"Anna\","
+	 "\"last_name\":\"Rossi\",\"username\":\"anna_rossi\",\"language_code\":\"it\"},\"chat\":{\"id\":123456789,"
+	 "\"first_name\":\"Anna\",\"last_name\":\"Rossi\",\"username\":\"anna_rossi\",\"type\":\"private\"},"
+	 "\"date\":1700000005,\"text\":\"/light on\",\"entities\":[{\"offset\":0,\"length\":6,\"type\":\"bot_command\"}]}}"},
+
+	{"long text", MessageText,
+	 "{\"message\":{\"message_id\":1023,\"from\":{\"id\":123456789,\"is_bot\":false,\"first_name\":\"Anna\","
+	 "\"last_name\":\"Rossi\",\"username\":\"anna_rossi\",\"language_code\":\"it\"},\"chat\":{\"id\":123456789,"
+	 "\"first_name\":\"Anna\",\"last_name\":\"Rossi\",\"username\":\"anna_rossi\",\"type\":\"private\"},"
+	 "\"date\":1700000010,\"text\":\"Temperature report for today: kitchen 21.5 \\u00b0C, living room 22.0 \\u00b0C, "
+	 "bedroom 19.5 \\u00b0C, garage 12.0 \\u00b0C, garden 8.5 \\u00b0C. Humidity: kitchen 45%, living room 40%, "
+	 "bedroom 50%, garage 70%, garden 85%. Heating was on for 4 hours and 35 minutes, the boiler reported no errors. "
+	 "Next check is scheduled at 18:00, the report will be sent again in this chat. \\ud83d\\ude0a\"}}"},
+
+	{"callback query", MessageQuery,
+	 "{\"callback_query\":{\"id\":\"530248312365478912\",\"from\":{\"id\":123456789,\"is_bot\":false,"
+	 "\"first_name\":\"Anna\",\"last_name\":\"Rossi\",\"username\":\"anna_rossi\",\"language_code\":\"it\"},"
+	 "\"message\":{\"message_id\":1019,\"from\":{\"id\":987654321,\"is_bot\":true,\"first_name\":\"Home\","
+	 "\"username\":\"home_bot\"},\"chat\":{\"id\":123456789,\"first_name\":\"Anna\",\"last_name\":\"Rossi\","
+	 "\"username\":\"anna_rossi\",\"type\":\"private\"},\"date\":1699999990,\"text\":\"Light controls\","
+	 "\"reply_markup\":{\"inline_keyboard\":[[{\"text\":\"ON\",\"callback_data\":\"lightON\"},"
+	 "{\"text\":\"OFF\",\"callback_data\":\"lightOFF\"}]]}},\"chat_instance\":\"-4372843974236238419\","
+	 "\"data\":\"lightON\"}}"},
+
+	{"location", MessageLocation,
+	 "{\"message\":{\"message_id\":1024,\"from\":{\"id\":123456789,\"is_bot\":false,\"first_name\":\"Anna\","
+	 "\"last_name\":\"Rossi\",\"username\":\"anna_rossi\",\"language_code\":\"it\"},\"chat\":{\"id\":123456789,"
+	 "\"first_name\":\"Anna\",\"last_name\":\"Rossi\",\"username\":\"anna_rossi\",\"type\":\"private\"},"
+	 "\"date\":1700000020,\"location\":{\"latitude\":45.464211,\"longitude\":9.191383}}}"},
+
+	{"contact", MessageContact,
+	 "{\"message\":{\"message_id\":1025,\"from\":{\"id\":123456789,\"is_bot\":false,\"first_name\":\"Anna\","
+	 "\"last_name\":\"Rossi\",\"username\":\"anna_rossi\",\"language_code\":\"it\"},\"chat\":{\"id\":123456789,"
+	 "\"first_name\":\"Anna\",\"last_name\":\"Rossi\",\"username\":\"anna_rossi\",\"type\":\"private\"},"
+	 "\"date\":1700000030,\"contact\":{\"phone_number\":\"+393331234567\",\"first_name\":\"Marco\","
+	 "\"last_name\":\"Bianchi\",\"user_id\":234567890,\"vcard\":\"BEGIN:VCARD\\nVERSION:3.0\\nFN:Marco Bianchi\\n"
+	 "TEL;TYPE=CELL:+393331234567\\nEND:VCARD\"}}}"},
+
+	{"document", MessageDocument,
+	 "{\"message\":{\"message_id\":1026,\"from\":{\"id\":123456789,\"is_bot\":false,\"first_name\":\"Anna\","
+	 "\"last_name\":\"Rossi\",\"username\":\"anna_rossi\",\"language_code\":\"it\"},\"chat\":{\"id\":123456789,"
+	 "\"first_name\":\"Anna\",\"last_name\":\"Rossi\",\"username\":\"anna_rossi\",\"type\":\"private\"},"
+	 "\"date\":1700000040,\"document\":{\"file_name\":\"config.json\",\"mime_type\":\"application/json\","
+	 "\"file_id\":\"BQACAgQAAxkBAAIBQ2VhbHRoY2hlY2sAAj4NAAJ8vRhTAAHx3a0AAT-SiB4E\","
+	 "\"file_unique_id\":\"AgADPg0AAny9GFM\",\"file_size\":1234},\"caption\":\"New configuration\"}}"},
+
+	{"reply", MessageReply,
+	 "{\"message\":{\"message_id\":1027,\"from\":{\"id\":123456789,\"is_bot\":false,\"first_name\":\"Anna\","
+	 "\"last_name\":\"Rossi\",\"username\":\"anna_rossi\",\"language_code\":\"it\"},\"chat\":{\"id\":123456789,"
+	 "\"first_name\":\"Anna\",\"last_name\":\"Rossi\",\"username\":\"anna_rossi\",\"type\":\"private\"},"
+	 "\"date\":1700000050,\"reply_to_message\":{\"message_id\":1020,\"from\":{\"id\":987654321,\"is_bot\":true,"
+	 "\"first_name\":\"Home\",\"username\":\"home_bot\"},\"chat\":{\"id\":123456789,\"first_name\":\"Anna\","
+	 "\"last_name\":\"Rossi\",\"username\":\"anna_rossi\",\"type\":\"private\"},\"date\":1699999995,"
+	 "\"text\":\"Which room?\"},\"text\":\"Bedroom\"}}"},
+};
+
+static const size_t WORKLOAD_SIZE = sizeof(WORKLOAD) / sizeof(WORKLOAD[0]);
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// Host (Linux) replacement of the Arduino core headers used by the library.
+// Only the subset of ESP32/ESP8266 core API used in src/ is provided.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+
+using std::min;
+using std::max;
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+// Flash strings are plain strings in host memory
+class __FlashStringHelper;
+#define PROGMEM
+#define PGM_P               const char*
+#define PSTR(s)             (s)
+#define F(s)                (reinterpret_cast<const __FlashStringHelper*>(PSTR(s)))
+#define FPSTR(p)            (reinterpret_cast<const __FlashStringHelper*>(p))
+#define pgm_read_byte(p)    (*(const uint8_t*)(p))
+#define pgm_read_word(p)    (*(const uint16_t*)(p))
+#define pgm_read_dword(p)   (*(const uint32_t*)(p))
+#define memcpy_P            memcpy
+#define memcmp_P            memcmp
+#define strlen_P            strlen
+#define strcmp_P            strcmp
+#define strncmp_P           strncmp
+#define strcpy_P            strcpy
+#define sprintf_P           sprintf
+#define snprintf_P          snprintf
+#define sniprintf           snprintf
+#define IRAM_ATTR
+
+// lwIP TCP maximum segment size (ESP8266 default)
+#define TCP_MSS             536
+
+#include "WString.h"
+#include "Print.h"
+#include "Stream.h"
+#include "IPAddress.h"
+#include "HardwareSerial.h"
+#include "Esp.h"
+
+#if defined(ESP32)
+	#include "freertos/FreeRTOS.h"
+	#include "freertos/task.h"
+	#include "freertos/semphr.h"
+	#include "freertos/queue.h"
+	#include "esp_heap_caps.h"
+#endif
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+
+// Set TZ environment variable (host clock is already synchronized)
+void configTime(const char* tz, const char* server1, const char* server2 = nullptr, const char* server3 = nullptr);
+void configTime(long gmtOffset, int daylightOffset, const char* server1, const char* server2 = nullptr, const char* server3 = nullptr);
+void configTzTime(const char* tz, const char* server1, const char* server2 = nullptr, const char* server3 = nullptr);
+
+#endif
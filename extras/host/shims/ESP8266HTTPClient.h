@@ -0,0 +1,6 @@
+#ifndef HOST_ESP8266_HTTP_CLIENT_H
+#define HOST_ESP8266_HTTP_CLIENT_H
+
+#include "HTTPClient.h"
+
+#endif
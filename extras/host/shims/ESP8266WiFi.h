@@ -0,0 +1,7 @@
+#ifndef HOST_ESP8266_WIFI_H
+#define HOST_ESP8266_WIFI_H
+
+#include "WiFi.h"
+#include "WiFiClientSecure.h"
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef HOST_ESP_H
+#define HOST_ESP_H
+
+#include <stdint.h>
+
+// Heap functions of ESP cores, computed from the allocations tracked on host (see HostHeap.h)
+class EspClass {
+public:
+	uint32_t getFreeHeap();
+	uint32_t getHeapSize();
+	uint32_t getMinFreeHeap();
+	uint32_t getMaxAllocHeap();
+	uint32_t getMaxFreeBlockSize();
+	uint8_t getHeapFragmentation();
+	void getHeapStats(uint32_t *free = nullptr, uint16_t *max = nullptr, uint8_t *frag = nullptr);
+	void getHeapStats(uint32_t *free, uint32_t *max, uint8_t *frag);
+	uint32_t getChipId();
+	[[noreturn]] void restart();
+};
+
+extern EspClass ESP;
+
+#endif
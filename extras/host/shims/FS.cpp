@@ -0,0 +1,162 @@
+#include "FS.h"
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs {
+
+	struct File::Impl {
+		FILE*       file;
+		std::string name;
+
+		~Impl() {
+			if (file != nullptr)
+				fclose(file);
+		}
+	};
+
+	File::File(FILE *file, const char *name) : m_impl(std::make_shared<Impl>())
+	{
+		m_impl->file = file;
+		const char *slash = strrchr(name, '/');
+		m_impl->name = slash != nullptr ? slash + 1 : name;
+	}
+
+	size_t File::write(uint8_t c)
+	{
+		return write(&c, 1);
+	}
+
+	size_t File::write(const uint8_t *buf, size_t size)
+	{
+		if (!*this)
+			return 0;
+		return fwrite(buf, 1, size, m_impl->file);
+	}
+
+	int File::available()
+	{
+		if (!*this)
+			return 0;
+		return size() - position();
+	}
+
+	int File::read()
+	{
+		if (!*this)
+			return -1;
+		int c = fgetc(m_impl->file);
+		return c == EOF ? -1 : c;
+	}
+
+	int File::peek()
+	{
+		if (!*this)
+			return -1;
+		int c = fgetc(m_impl->file);
+		if (c == EOF)
+			return -1;
+		ungetc(c, m_impl->file);
+		return c;
+	}
+
+	void File::flush()
+	{
+		if (*this)
+			fflush(m_impl->file);
+	}
+
+	size_t File::read(uint8_t *buf, size_t size)
+	{
+		if (!*this)
+			return 0;
+		return fread(buf, 1, size, m_impl->file);
+	}
+
+	bool File::seek(uint32_t pos, SeekMode mode)
+	{
+		if (!*this)
+			return false;
+		int whence = mode == SeekCur ? SEEK_CUR : (mode == SeekEnd ? SEEK_END : SEEK_SET);
+		return fseek(m_impl->file, pos, whence) == 0;
+	}
+
+	size_t File::position() const
+	{
+		if (!*this)
+			return 0;
+		long pos = ftell(m_impl->file);
+		return pos > 0 ? pos : 0;
+	}
+
+	size_t File::size() const
+	{
+		if (!*this)
+			return 0;
+		fflush(m_impl->file);
+		struct stat st;
+		if (fstat(fileno(m_impl->file), &st) != 0)
+			return 0;
+		return st.st_size;
+	}
+
+	void File::close()
+	{
+		if (m_impl != nullptr && m_impl->file != nullptr) {
+			fclose(m_impl->file);
+			m_impl->file = nullptr;
+		}
+	}
+
+	File::operator bool() const
+	{
+		return m_impl != nullptr && m_impl->file != nullptr;
+	}
+
+	const char *File::name() const
+	{
+		return m_impl != nullptr ? m_impl->name.c_str() : "";
+	}
+
+
+	FS::FS(const char *root) : m_root(root)
+	{
+	}
+
+	std::string FS::hostPath(const char *path) const
+	{
+		std::string full = m_root;
+		if (path[0] != '/')
+			full += '/';
+		full += path;
+		return full;
+	}
+
+	File FS::open(const char *path, const char *mode)
+	{
+		FILE *file = fopen(hostPath(path).c_str(), mode);
+		if (file == nullptr)
+			return File();
+		return File(file, path);
+	}
+
+	bool FS::exists(const char *path)
+	{
+		struct stat st;
+		return stat(hostPath(path).c_str(), &st) == 0;
+	}
+
+	bool FS::remove(const char *path)
+	{
+		return ::remove(hostPath(path).c_str()) == 0;
+	}
+
+	bool FS::rename(const char *pathFrom, const char *pathTo)
+	{
+		return ::rename(hostPath(pathFrom).c_str(), hostPath(pathTo).c_str()) == 0;
+	}
+
+	bool FS::mkdir(const char *path)
+	{
+		return ::mkdir(hostPath(path).c_str(), 0755) == 0;
+	}
+}
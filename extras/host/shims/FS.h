@@ -0,0 +1,79 @@
+#ifndef HOST_FS_H
+#define HOST_FS_H
+
+#include <memory>
+#include <string>
+#include "Arduino.h"
+
+#define FILE_READ       "r"
+#define FILE_WRITE      "w"
+#define FILE_APPEND     "a"
+
+namespace fs {
+
+	enum SeekMode {
+		SeekSet = 0,
+		SeekCur = 1,
+		SeekEnd = 2
+	};
+
+	// File of host filesystem (copies share the same open file, as with ESP cores)
+	class File : public Stream {
+	public:
+		File() {}
+		File(FILE *file, const char *name);
+
+		size_t write(uint8_t c) override;
+		size_t write(const uint8_t *buf, size_t size) override;
+		using Print::write;
+		int available() override;
+		int read() override;
+		int peek() override;
+		void flush() override;
+		size_t read(uint8_t *buf, size_t size);
+		size_t readBytes(char *buffer, size_t length) override { return read((uint8_t *) buffer, length); }
+		using Stream::readBytes;
+
+		bool seek(uint32_t pos, SeekMode mode);
+		inline bool seek(uint32_t pos) { return seek(pos, SeekSet); }
+		size_t position() const;
+		size_t size() const;
+		void close();
+		operator bool() const;
+		const char *name() const;
+		bool isDirectory() const { return false; }
+
+	private:
+		struct Impl;
+		std::shared_ptr<Impl> m_impl;
+	};
+
+	// Filesystem stored in a directory of host (paths are relative to it)
+	class FS {
+	public:
+		explicit FS(const char *root = ".");
+
+		File open(const char *path, const char *mode = FILE_READ);
+		inline File open(const String &path, const char *mode = FILE_READ) { return open(path.c_str(), mode); }
+		bool exists(const char *path);
+		inline bool exists(const String &path) { return exists(path.c_str()); }
+		bool remove(const char *path);
+		inline bool remove(const String &path) { return remove(path.c_str()); }
+		bool rename(const char *pathFrom, const char *pathTo);
+		bool mkdir(const char *path);
+
+	private:
+		std::string hostPath(const char *path) const;
+
+		std::string m_root;
+	};
+}
+
+using fs::FS;
+using fs::File;
+using fs::SeekMode;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
+
+#endif
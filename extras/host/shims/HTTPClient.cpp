@@ -0,0 +1,407 @@
+#include "HTTPClient.h"
+
+// String filled by writeToStream()
+class StringStream : public Stream {
+public:
+	explicit StringStream(String &str) : m_str(str) {}
+	size_t write(uint8_t c) override { return m_str.concat((char) c) ? 1 : 0; }
+	size_t write(const uint8_t *buf, size_t size) override {
+		return m_str.concat((const char *) buf, size) ? size : 0;
+	}
+	int available() override { return 0; }
+	int read() override { return -1; }
+	int peek() override { return -1; }
+private:
+	String &m_str;
+};
+
+
+HTTPClient::HTTPClient()
+{
+}
+
+HTTPClient::~HTTPClient()
+{
+	delete[] m_currentHeaders;
+}
+
+void HTTPClient::clear()
+{
+	m_returnCode = 0;
+	m_size = -1;
+	m_headers = "";
+}
+
+bool HTTPClient::begin(WiFiClient &client, const String &url)
+{
+	int index = url.indexOf(':');
+	if (index < 0)
+		return false;
+	String protocol = url.substring(0, index);
+	if (protocol != "http" && protocol != "https")
+		return false;
+	clear();
+	m_client = &client;
+	m_port = protocol == "https" ? 443 : 80;
+
+	String rest = url.substring(index + 3);
+	index = rest.indexOf('/');
+	String host = index >= 0 ? rest.substring(0, index) : rest;
+	m_uri = index >= 0 ? rest.substring(index) : String("/");
+	index = host.indexOf(':');
+	if (index >= 0) {
+		m_host = host.substring(0, index);
+		m_port = host.substring(index + 1).toInt();
+	}
+	else
+		m_host = host;
+	return true;
+}
+
+bool HTTPClient::begin(WiFiClient &client, const String &host, uint16_t port, const String &uri, bool https)
+{
+	(void) https;
+	clear();
+	m_client = &client;
+	m_host = host;
+	m_port = port;
+	m_uri = uri;
+	return true;
+}
+
+void HTTPClient::end()
+{
+	disconnect(false);
+	clear();
+}
+
+void HTTPClient::disconnect(bool preserveClient)
+{
+	if (connected()) {
+		// Rest of reply is discarded
+		while (m_client->available() > 0)
+			m_client->read();
+		if (!m_reuse || !m_canReuse)
+			m_client->stop();
+	}
+	if (!preserveClient && (!m_reuse || !m_canReuse))
+		m_client = nullptr;
+}
+
+bool HTTPClient::connected()
+{
+	return m_client != nullptr && (m_client->available() > 0 || m_client->connected());
+}
+
+void HTTPClient::setReuse(bool reuse)
+{
+	m_reuse = reuse;
+}
+
+void HTTPClient::setUserAgent(const String &userAgent)
+{
+	m_userAgent = userAgent;
+}
+
+void HTTPClient::setTimeout(uint16_t timeout)
+{
+	m_tcpTimeout = timeout;
+	if (m_client != nullptr)
+		m_client->setTimeout(timeout);
+}
+
+void HTTPClient::setConnectTimeout(int32_t timeout)
+{
+	m_connectTimeout = timeout;
+}
+
+void HTTPClient::addHeader(const String &name, const String &value, bool first, bool replace)
+{
+	// Headers written by sendHeader() can't be set
+	if (name.equalsIgnoreCase("Connection") || name.equalsIgnoreCase("User-Agent") || name.equalsIgnoreCase("Host"))
+		return;
+
+	String headerLine = name;
+	headerLine += ": ";
+	if (replace) {
+		int headerStart = m_headers.indexOf(headerLine);
+		if (headerStart != -1 && (headerStart == 0 || m_headers[headerStart - 1] == '\n')) {
+			int headerEnd = m_headers.indexOf('\n', headerStart);
+			m_headers = m_headers.substring(0, headerStart) + m_headers.substring(headerEnd + 1);
+		}
+	}
+	headerLine += value;
+	headerLine += "\r\n";
+	if (first)
+		m_headers = headerLine + m_headers;
+	else
+		m_headers += headerLine;
+}
+
+void HTTPClient::collectHeaders(const char *headerKeys[], const size_t headerKeysCount)
+{
+	delete[] m_currentHeaders;
+	m_headerKeysCount = headerKeysCount;
+	m_currentHeaders = new RequestArgument[headerKeysCount];
+	for (size_t i = 0; i < headerKeysCount; i++)
+		m_currentHeaders[i].key = headerKeys[i];
+}
+
+String HTTPClient::header(const char *name)
+{
+	for (size_t i = 0; i < m_headerKeysCount; i++) {
+		if (m_currentHeaders[i].key.equalsIgnoreCase(name))
+			return m_currentHeaders[i].value;
+	}
+	return String();
+}
+
+bool HTTPClient::hasHeader(const char *name)
+{
+	return header(name).length() > 0;
+}
+
+int HTTPClient::GET()
+{
+	return sendRequest("GET");
+}
+
+int HTTPClient::POST(uint8_t *payload, size_t size)
+{
+	return sendRequest("POST", payload, size);
+}
+
+int HTTPClient::POST(const String &payload)
+{
+	return POST((uint8_t *) payload.c_str(), payload.length());
+}
+
+int HTTPClient::sendRequest(const char *type, uint8_t *payload, size_t size)
+{
+	for (size_t i = 0; i < m_headerKeysCount; i++)
+		m_currentHeaders[i].value.clear();
+
+	if (!connect())
+		return returnError(HTTPC_ERROR_CONNECTION_REFUSED);
+	if (payload != nullptr && size > 0)
+		addHeader("Content-Length", String(size));
+	if (!sendHeader(type))
+		return returnError(HTTPC_ERROR_SEND_HEADER_FAILED);
+	if (payload != nullptr && size > 0 && m_client->write(payload, size) != size)
+		return returnError(HTTPC_ERROR_SEND_PAYLOAD_FAILED);
+	return returnError(handleHeaderResponse());
+}
+
+bool HTTPClient::connect()
+{
+	if (m_client == nullptr)
+		return false;
+	if (connected()) {
+		// Connection is reused: data left from a previous reply is discarded
+		while (m_client->available() > 0)
+			m_client->read();
+		return true;
+	}
+	if (!m_client->connect(m_host.c_str(), m_port))
+		return false;
+	m_client->setTimeout(m_tcpTimeout);
+	return true;
+}
+
+bool HTTPClient::sendHeader(const char *type)
+{
+	String header = String(type) + " " + m_uri + " HTTP/1.1\r\nHost: " + m_host;
+	if (m_port != 80 && m_port != 443) {
+		header += ':';
+		header += String(m_port);
+	}
+	header += "\r\nUser-Agent: ";
+	header += m_userAgent;
+	header += "\r\nConnection: ";
+	header += m_reuse ? "keep-alive" : "close";
+	header += "\r\nAccept-Encoding: identity;q=1,chunked;q=0.1,*;q=0\r\n";
+	header += m_headers;
+	header += "\r\n";
+	return m_client->write((const uint8_t *) header.c_str(), header.length()) == header.length();
+}
+
+int HTTPClient::handleHeaderResponse()
+{
+	if (!connected())
+		return HTTPC_ERROR_NOT_CONNECTED;
+
+	m_returnCode = 0;
+	m_size = -1;
+	m_canReuse = m_reuse;
+	m_chunked = false;
+	String transferEncoding;
+	unsigned long lastDataTime = millis();
+	bool firstLine = true;
+
+	while (connected()) {
+		if (m_client->available() <= 0) {
+			if (millis() - lastDataTime > m_tcpTimeout)
+				return HTTPC_ERROR_READ_TIMEOUT;
+			// As ESP32 core: reply is polled every 10 ms
+			delay(10);
+			continue;
+		}
+		String headerLine = m_client->readStringUntil('\n');
+		headerLine.trim();
+		lastDataTime = millis();
+		if (firstLine) {
+			firstLine = false;
+			if (m_canReuse && headerLine.startsWith("HTTP/1."))
+				m_canReuse = headerLine[sizeof("HTTP/1.") - 1] != '0';
+			int codePos = headerLine.indexOf(' ') + 1;
+			m_returnCode = headerLine.substring(codePos, headerLine.indexOf(' ', codePos)).toInt();
+		}
+		else if (headerLine.indexOf(':') > 0) {
+			String headerName = headerLine.substring(0, headerLine.indexOf(':'));
+			String headerValue = headerLine.substring(headerLine.indexOf(':') + 1);
+			headerValue.trim();
+			if (headerName.equalsIgnoreCase("Content-Length"))
+				m_size = headerValue.toInt();
+			if (m_canReuse && headerName.equalsIgnoreCase("Connection")
+			    && headerValue.indexOf("close") >= 0 && headerValue.indexOf("keep-alive") < 0)
+				m_canReuse = false;
+			if (headerName.equalsIgnoreCase("Transfer-Encoding"))
+				transferEncoding = headerValue;
+			for (size_t i = 0; i < m_headerKeysCount; i++) {
+				if (m_currentHeaders[i].key.equalsIgnoreCase(headerName)) {
+					m_currentHeaders[i].value = headerValue;
+					break;
+				}
+			}
+		}
+		if (headerLine.length() == 0) {
+			if (transferEncoding.length() > 0) {
+				if (!transferEncoding.equalsIgnoreCase("chunked"))
+					return HTTPC_ERROR_ENCODING;
+				m_chunked = true;
+			}
+			return m_returnCode != 0 ? m_returnCode : HTTPC_ERROR_NO_HTTP_SERVER;
+		}
+	}
+	return HTTPC_ERROR_CONNECTION_LOST;
+}
+
+int HTTPClient::getSize()
+{
+	return m_size;
+}
+
+WiFiClient &HTTPClient::getStream()
+{
+	return *m_client;
+}
+
+WiFiClient *HTTPClient::getStreamPtr()
+{
+	return connected() ? m_client : nullptr;
+}
+
+int HTTPClient::writeToStreamDataBlock(Stream *stream, int size)
+{
+	// Body is copied with a temporary buffer of one TCP segment
+	size_t bufferSize = (size > 0 && size < HTTP_TCP_BUFFER_SIZE) ? size : HTTP_TCP_BUFFER_SIZE;
+	uint8_t *buffer = (uint8_t *) malloc(bufferSize);
+	if (buffer == nullptr)
+		return HTTPC_ERROR_TOO_LESS_RAM;
+
+	int total = 0;
+	while (connected() && (size < 0 || total < size)) {
+		size_t toRead = size < 0 ? bufferSize : std::min(bufferSize, (size_t) (size - total));
+		size_t n = m_client->readBytes(buffer, toRead);
+		if (n == 0) {
+			if (size < 0 && !m_client->connected())
+				break;
+			free(buffer);
+			return HTTPC_ERROR_READ_TIMEOUT;
+		}
+		if (stream->write(buffer, n) != n) {
+			free(buffer);
+			return HTTPC_ERROR_STREAM_WRITE;
+		}
+		total += n;
+	}
+	free(buffer);
+	if (size > 0 && total != size)
+		return HTTPC_ERROR_CONNECTION_LOST;
+	return total;
+}
+
+int HTTPClient::writeToStream(Stream *stream)
+{
+	if (stream == nullptr)
+		return returnError(HTTPC_ERROR_NO_STREAM);
+	if (!connected())
+		return returnError(HTTPC_ERROR_NOT_CONNECTED);
+
+	int ret = 0;
+	if (!m_chunked) {
+		ret = writeToStreamDataBlock(stream, m_size);
+		if (ret < 0)
+			return returnError(ret);
+	}
+	else {
+		for (;;) {
+			String chunkHeader = m_client->readStringUntil('\n');
+			if (chunkHeader.length() == 0)
+				return returnError(HTTPC_ERROR_READ_TIMEOUT);
+			chunkHeader.trim();
+			int len = (int) strtol(chunkHeader.c_str(), nullptr, 16);
+			if (len > 0) {
+				int r = writeToStreamDataBlock(stream, len);
+				if (r < 0)
+					return returnError(r);
+				ret += r;
+			}
+			// CRLF after chunk data
+			char buf[2];
+			if (m_client->readBytes(buf, 2) != 2)
+				return returnError(HTTPC_ERROR_READ_TIMEOUT);
+			if (len == 0)
+				break;
+		}
+	}
+	disconnect(true);
+	return ret;
+}
+
+String HTTPClient::getString()
+{
+	String str;
+	if (m_size > 0 || m_size == -1) {
+		if (m_size > 0 && !str.reserve(m_size + 1))
+			return String();
+		StringStream stream(str);
+		writeToStream(&stream);
+	}
+	return str;
+}
+
+int HTTPClient::returnError(int error)
+{
+	if (error < 0 && connected())
+		m_client->stop();
+	return error;
+}
+
+String HTTPClient::errorToString(int error)
+{
+	switch (error) {
+		case HTTPC_ERROR_CONNECTION_REFUSED:    return "connection refused";
+		case HTTPC_ERROR_SEND_HEADER_FAILED:    return "send header failed";
+		case HTTPC_ERROR_SEND_PAYLOAD_FAILED:   return "send payload failed";
+		case HTTPC_ERROR_NOT_CONNECTED:         return "not connected";
+		case HTTPC_ERROR_CONNECTION_LOST:       return "connection lost";
+		case HTTPC_ERROR_NO_STREAM:             return "no stream";
+		case HTTPC_ERROR_NO_HTTP_SERVER:        return "no HTTP server";
+		case HTTPC_ERROR_TOO_LESS_RAM:          return "too less ram";
+		case HTTPC_ERROR_ENCODING:              return "Transfer-Encoding not supported";
+		case HTTPC_ERROR_STREAM_WRITE:          return "Stream write error";
+		case HTTPC_ERROR_READ_TIMEOUT:          return "read Timeout";
+		default:                                return String();
+	}
+}
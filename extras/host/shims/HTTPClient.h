@@ -0,0 +1,105 @@
+#ifndef HOST_HTTP_CLIENT_H
+#define HOST_HTTP_CLIENT_H
+
+#include "Arduino.h"
+#include "WiFiClient.h"
+
+#define HTTPC_ERROR_CONNECTION_REFUSED  (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED  (-2)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_NOT_CONNECTED       (-4)
+#define HTTPC_ERROR_CONNECTION_LOST     (-5)
+#define HTTPC_ERROR_NO_STREAM           (-6)
+#define HTTPC_ERROR_NO_HTTP_SERVER      (-7)
+#define HTTPC_ERROR_TOO_LESS_RAM        (-8)
+#define HTTPC_ERROR_ENCODING            (-9)
+#define HTTPC_ERROR_STREAM_WRITE        (-10)
+#define HTTPC_ERROR_READ_TIMEOUT        (-11)
+
+#define HTTP_TCP_BUFFER_SIZE            (1460)
+
+typedef enum {
+	HTTP_CODE_OK = 200,
+	HTTP_CODE_NO_CONTENT = 204,
+	HTTP_CODE_PARTIAL_CONTENT = 206,
+	HTTP_CODE_MOVED_PERMANENTLY = 301,
+	HTTP_CODE_FOUND = 302,
+	HTTP_CODE_BAD_REQUEST = 400,
+	HTTP_CODE_UNAUTHORIZED = 401,
+	HTTP_CODE_FORBIDDEN = 403,
+	HTTP_CODE_NOT_FOUND = 404,
+	HTTP_CODE_CONFLICT = 409,
+	HTTP_CODE_REQUEST_ENTITY_TOO_LARGE = 413,
+	HTTP_CODE_RANGE_NOT_SATISFIABLE = 416,
+	HTTP_CODE_TOO_MANY_REQUESTS = 429,
+	HTTP_CODE_INTERNAL_SERVER_ERROR = 500,
+	HTTP_CODE_BAD_GATEWAY = 502
+} t_http_codes;
+
+// HTTP/1.1 client with the behaviour of ESP32 core HTTPClient: an already connected client is
+// reused, replies are read with a 10 ms polling loop, only headers selected with
+// collectHeaders() are stored, Connection/Host/User-Agent headers can't be added.
+class HTTPClient {
+public:
+	HTTPClient();
+	~HTTPClient();
+
+	bool begin(WiFiClient &client, const String &url);
+	bool begin(WiFiClient &client, const String &host, uint16_t port, const String &uri = "/", bool https = false);
+	void end();
+	bool connected();
+
+	void setReuse(bool reuse);
+	void setUserAgent(const String &userAgent);
+	void setTimeout(uint16_t timeout);
+	void setConnectTimeout(int32_t timeout);
+
+	void addHeader(const String &name, const String &value, bool first = false, bool replace = true);
+	void collectHeaders(const char *headerKeys[], const size_t headerKeysCount);
+	String header(const char *name);
+	bool hasHeader(const char *name);
+
+	int GET();
+	int POST(uint8_t *payload, size_t size);
+	int POST(const String &payload);
+	int sendRequest(const char *type, uint8_t *payload = nullptr, size_t size = 0);
+
+	int getSize();
+	WiFiClient &getStream();
+	WiFiClient *getStreamPtr();
+	int writeToStream(Stream *stream);
+	String getString();
+	static String errorToString(int error);
+
+private:
+	struct RequestArgument {
+		String key;
+		String value;
+	};
+
+	void clear();
+	bool connect();
+	bool sendHeader(const char *type);
+	int handleHeaderResponse();
+	int writeToStreamDataBlock(Stream *stream, int len);
+	void disconnect(bool preserveClient);
+	int returnError(int error);
+
+	WiFiClient*         m_client = nullptr;
+	String              m_host;
+	uint16_t            m_port = 0;
+	String              m_uri;
+	String              m_headers;
+	String              m_userAgent = "ESP32HTTPClient";
+	bool                m_reuse = true;
+	bool                m_canReuse = false;
+	uint16_t            m_tcpTimeout = 5000;
+	int32_t             m_connectTimeout = 5000;
+	int                 m_returnCode = 0;
+	int                 m_size = -1;
+	bool                m_chunked = false;
+	RequestArgument*    m_currentHeaders = nullptr;
+	size_t              m_headerKeysCount = 0;
+};
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef HOST_HARDWARE_SERIAL_H
+#define HOST_HARDWARE_SERIAL_H
+
+#include <stdio.h>
+#include <atomic>
+#include "Stream.h"
+
+// Serial port printed on stdout (input is never available)
+class HardwareSerial : public Stream {
+public:
+	inline void begin(unsigned long baud) { (void) baud; }
+	inline void end() {}
+	inline void setDebugOutput(bool enable) { (void) enable; }
+
+	size_t write(uint8_t c) override;
+	size_t write(const uint8_t *buffer, size_t size) override;
+	using Print::write;
+	inline int available() override { return 0; }
+	inline int read() override { return -1; }
+	inline int peek() override { return -1; }
+	void flush() override;
+	inline operator bool() const { return true; }
+
+	// host only: where output goes (nullptr to discard, i.e. while measuring)
+	inline void setOutput(FILE *output) { m_output = output; }
+
+private:
+	std::atomic<FILE *> m_output{stdout};
+};
+
+extern HardwareSerial Serial;
+
+#endif
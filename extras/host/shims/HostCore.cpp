@@ -0,0 +1,81 @@
+#include "Arduino.h"
+#include <chrono>
+#include <thread>
+
+static const std::chrono::steady_clock::time_point s_start = std::chrono::steady_clock::now();
+
+unsigned long millis()
+{
+	auto elapsed = std::chrono::steady_clock::now() - s_start;
+	return (uint32_t) std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+}
+
+unsigned long micros()
+{
+	auto elapsed = std::chrono::steady_clock::now() - s_start;
+	return (uint32_t) std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+}
+
+void delay(unsigned long ms)
+{
+	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void yield()
+{
+	std::this_thread::yield();
+}
+
+
+static void setTimeZone(const char *tz)
+{
+	if (tz != nullptr) {
+		setenv("TZ", tz, 1);
+		tzset();
+	}
+}
+
+void configTime(const char *tz, const char *server1, const char *server2, const char *server3)
+{
+	(void) server1;
+	(void) server2;
+	(void) server3;
+	setTimeZone(tz);
+}
+
+void configTime(long gmtOffset, int daylightOffset, const char *server1, const char *server2, const char *server3)
+{
+	(void) gmtOffset;
+	(void) daylightOffset;
+	(void) server1;
+	(void) server2;
+	(void) server3;
+}
+
+void configTzTime(const char *tz, const char *server1, const char *server2, const char *server3)
+{
+	configTime(tz, server1, server2, server3);
+}
+
+
+HardwareSerial Serial;
+
+size_t HardwareSerial::write(uint8_t c)
+{
+	return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+	FILE *output = m_output.load(std::memory_order_relaxed);
+	if (output != nullptr)
+		fwrite(buffer, 1, size, output);
+	return size;
+}
+
+void HardwareSerial::flush()
+{
+	FILE *output = m_output.load(std::memory_order_relaxed);
+	if (output != nullptr)
+		fflush(output);
+}
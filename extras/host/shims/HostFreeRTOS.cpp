@@ -0,0 +1,308 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct HostTask {
+	const char*     name;
+	BaseType_t      core;
+	void*           stack = nullptr;
+	std::mutex      mutex;
+	std::condition_variable notified;
+	uint32_t        notifyCount = 0;
+};
+
+struct HostSemaphore {
+	enum Kind { Mutex, Counting };
+	Kind            kind;
+	std::recursive_timed_mutex mutex;
+	std::mutex      countMutex;
+	std::condition_variable given;
+	UBaseType_t     count = 0;
+	UBaseType_t     maxCount = 1;
+};
+
+struct HostQueue {
+	std::mutex      mutex;
+	std::condition_variable notEmpty;
+	std::condition_variable notFull;
+	uint8_t*        storage;
+	UBaseType_t     length;
+	UBaseType_t     itemSize;
+	UBaseType_t     head = 0;
+	UBaseType_t     count = 0;
+};
+
+// Thrown by vTaskDelete(NULL) to unwind the stack of the task function
+struct HostTaskExit {};
+
+static HostTask s_loopTask{"loopTask", 1};
+static thread_local HostTask *t_currentTask = nullptr;
+
+static HostTask *currentTask()
+{
+	return t_currentTask != nullptr ? t_currentTask : &s_loopTask;
+}
+
+// wait on a condition variable for ticks (portMAX_DELAY forever), until ready() is true
+template <typename Lock, typename Ready>
+static bool waitFor(std::condition_variable &cv, Lock &lock, TickType_t ticks, Ready ready)
+{
+	if (ticks == portMAX_DELAY) {
+		cv.wait(lock, ready);
+		return true;
+	}
+	return cv.wait_for(lock, std::chrono::milliseconds(ticks), ready);
+}
+
+
+BaseType_t xPortGetCoreID()
+{
+	return currentTask()->core;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stackDepth,
+                                   void *parameters, UBaseType_t priority, TaskHandle_t *handle, BaseType_t core)
+{
+	(void) priority;
+	HostTask *task = new HostTask;
+	task->name = name;
+	task->core = core == tskNO_AFFINITY ? 0 : core;
+	task->stack = malloc(stackDepth);
+	// Handle is valid before the task starts running
+	if (handle != nullptr)
+		*handle = task;
+
+	std::thread([task, function, parameters]() {
+		t_currentTask = task;
+		try {
+			function(parameters);
+			fprintf(stderr, "Task %s returned without calling vTaskDelete()\n", task->name);
+			abort();
+		}
+		catch (const HostTaskExit &) {
+		}
+		// Handle can still be used by other tasks (i.e. to notify it): only the stack is released
+		free(task->stack);
+		task->stack = nullptr;
+	}).detach();
+	return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stackDepth,
+                       void *parameters, UBaseType_t priority, TaskHandle_t *handle)
+{
+	return xTaskCreatePinnedToCore(function, name, stackDepth, parameters, priority, handle, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+	if (task != nullptr && task != t_currentTask) {
+		fprintf(stderr, "vTaskDelete() of another task is not supported on host\n");
+		abort();
+	}
+	if (t_currentTask == nullptr) {
+		fprintf(stderr, "vTaskDelete() called by loop task\n");
+		abort();
+	}
+	throw HostTaskExit();
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+	std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+TickType_t xTaskGetTickCount()
+{
+	static const auto start = std::chrono::steady_clock::now();
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	return (TickType_t) std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+	return currentTask();
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+	{
+		std::lock_guard<std::mutex> lock(task->mutex);
+		task->notifyCount++;
+	}
+	task->notified.notify_one();
+	return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait)
+{
+	HostTask *task = currentTask();
+	std::unique_lock<std::mutex> lock(task->mutex);
+	waitFor(task->notified, lock, ticksToWait, [task]() { return task->notifyCount > 0; });
+	uint32_t count = task->notifyCount;
+	if (count > 0)
+		task->notifyCount = clearCountOnExit ? 0 : count - 1;
+	return count;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+	(void) task;
+	return 0;
+}
+
+
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+	HostSemaphore *semaphore = new HostSemaphore;
+	semaphore->kind = HostSemaphore::Mutex;
+	return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex()
+{
+	return xSemaphoreCreateMutex();
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary()
+{
+	return xSemaphoreCreateCounting(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount)
+{
+	HostSemaphore *semaphore = new HostSemaphore;
+	semaphore->kind = HostSemaphore::Counting;
+	semaphore->maxCount = maxCount;
+	semaphore->count = initialCount;
+	return semaphore;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore)
+{
+	delete semaphore;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticksToWait)
+{
+	if (semaphore->kind == HostSemaphore::Mutex)
+		return xSemaphoreTakeRecursive(semaphore, ticksToWait);
+
+	std::unique_lock<std::mutex> lock(semaphore->countMutex);
+	if (!waitFor(semaphore->given, lock, ticksToWait, [semaphore]() { return semaphore->count > 0; }))
+		return pdFALSE;
+	semaphore->count--;
+	return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+	if (semaphore->kind == HostSemaphore::Mutex)
+		return xSemaphoreGiveRecursive(semaphore);
+
+	{
+		std::lock_guard<std::mutex> lock(semaphore->countMutex);
+		if (semaphore->count >= semaphore->maxCount)
+			return pdFALSE;
+		semaphore->count++;
+	}
+	semaphore->given.notify_one();
+	return pdTRUE;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t mutex, TickType_t ticksToWait)
+{
+	if (ticksToWait == portMAX_DELAY) {
+		mutex->mutex.lock();
+		return pdTRUE;
+	}
+	if (ticksToWait == 0)
+		return mutex->mutex.try_lock() ? pdTRUE : pdFALSE;
+	return mutex->mutex.try_lock_for(std::chrono::milliseconds(ticksToWait)) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t mutex)
+{
+	mutex->mutex.unlock();
+	return pdTRUE;
+}
+
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize)
+{
+	HostQueue *queue = new HostQueue;
+	queue->storage = (uint8_t *) malloc(length * itemSize);
+	queue->length = length;
+	queue->itemSize = itemSize;
+	return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+	free(queue->storage);
+	delete queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticksToWait)
+{
+	return xQueueSendToBack(queue, item, ticksToWait);
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t ticksToWait)
+{
+	{
+		std::unique_lock<std::mutex> lock(queue->mutex);
+		if (!waitFor(queue->notFull, lock, ticksToWait, [queue]() { return queue->count < queue->length; }))
+			return errQUEUE_FULL;
+		UBaseType_t tail = (queue->head + queue->count) % queue->length;
+		memcpy(queue->storage + tail * queue->itemSize, item, queue->itemSize);
+		queue->count++;
+	}
+	queue->notEmpty.notify_one();
+	return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t ticksToWait)
+{
+	{
+		std::unique_lock<std::mutex> lock(queue->mutex);
+		if (!waitFor(queue->notEmpty, lock, ticksToWait, [queue]() { return queue->count > 0; }))
+			return errQUEUE_EMPTY;
+		memcpy(buffer, queue->storage + queue->head * queue->itemSize, queue->itemSize);
+		queue->head = (queue->head + 1) % queue->length;
+		queue->count--;
+	}
+	queue->notFull.notify_one();
+	return pdPASS;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue)
+{
+	{
+		std::lock_guard<std::mutex> lock(queue->mutex);
+		queue->head = 0;
+		queue->count = 0;
+	}
+	queue->notFull.notify_all();
+	return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+	std::lock_guard<std::mutex> lock(queue->mutex);
+	return queue->count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue)
+{
+	std::lock_guard<std::mutex> lock(queue->mutex);
+	return queue->length - queue->count;
+}
@@ -0,0 +1,213 @@
+#include "HostHeap.h"
+#include "Esp.h"
+#include "esp_heap_caps.h"
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+#include <malloc.h>
+#include <stdio.h>
+
+static std::atomic<int64_t>  s_current{0};
+static std::atomic<int64_t>  s_peak{0};
+static std::atomic<int64_t>  s_maxEver{0};
+static std::atomic<uint64_t> s_allocations{0};
+static std::atomic<uint64_t> s_frees{0};
+static thread_local uint64_t t_allocations = 0;
+
+#if HOST_HEAP_TRACKING
+
+static void added(void *p)
+{
+	int64_t size = malloc_usable_size(p);
+	int64_t current = s_current.fetch_add(size, std::memory_order_relaxed) + size;
+	int64_t peak = s_peak.load(std::memory_order_relaxed);
+	while (current > peak && !s_peak.compare_exchange_weak(peak, current, std::memory_order_relaxed)) {}
+	peak = s_maxEver.load(std::memory_order_relaxed);
+	while (current > peak && !s_maxEver.compare_exchange_weak(peak, current, std::memory_order_relaxed)) {}
+	s_allocations.fetch_add(1, std::memory_order_relaxed);
+	t_allocations++;
+}
+
+static void removed(void *p)
+{
+	s_current.fetch_sub(malloc_usable_size(p), std::memory_order_relaxed);
+	s_frees.fetch_add(1, std::memory_order_relaxed);
+}
+
+extern "C" {
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+void *__wrap_malloc(size_t size)
+{
+	void *p = __real_malloc(size);
+	if (p != nullptr)
+		added(p);
+	return p;
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+	void *p = __real_calloc(count, size);
+	if (p != nullptr)
+		added(p);
+	return p;
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+	// Accounted as a free of old block and a new allocation
+	if (ptr != nullptr)
+		removed(ptr);
+	void *p = __real_realloc(ptr, size);
+	if (p != nullptr)
+		added(p);
+	else if (ptr != nullptr && size > 0)
+		added(ptr);     // failed: old block is still there
+	return p;
+}
+
+void __wrap_free(void *ptr)
+{
+	if (ptr != nullptr)
+		removed(ptr);
+	__real_free(ptr);
+}
+
+}
+
+void *operator new(size_t size)
+{
+	void *p = malloc(size > 0 ? size : 1);
+	if (p == nullptr)
+		throw std::bad_alloc();
+	return p;
+}
+
+void *operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+	return malloc(size > 0 ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+	return malloc(size > 0 ? size : 1);
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { free(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { free(p); }
+
+#endif
+
+
+namespace HostHeap {
+
+	bool enabled()
+	{
+		return HOST_HEAP_TRACKING != 0;
+	}
+
+	Stats stats()
+	{
+		Stats s;
+		int64_t current = s_current.load(std::memory_order_relaxed);
+		s.current = current > 0 ? current : 0;
+		s.peak = s_peak.load(std::memory_order_relaxed);
+		s.allocations = s_allocations.load(std::memory_order_relaxed);
+		s.frees = s_frees.load(std::memory_order_relaxed);
+		return s;
+	}
+
+	uint64_t threadAllocations()
+	{
+		return t_allocations;
+	}
+
+	void resetPeak()
+	{
+		s_peak.store(s_current.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+
+	size_t minFree()
+	{
+		int64_t used = s_maxEver.load(std::memory_order_relaxed);
+		return used < (int64_t) SIZE ? SIZE - used : 0;
+	}
+}
+
+
+static size_t freeHeap()
+{
+	size_t used = HostHeap::stats().current;
+	return used < HostHeap::SIZE ? HostHeap::SIZE - used : 0;
+}
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+	(void) caps;
+	return freeHeap();
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps)
+{
+	(void) caps;
+	return HostHeap::minFree();
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+	// Host heap is not fragmented
+	(void) caps;
+	return freeHeap();
+}
+
+
+EspClass ESP;
+
+uint32_t EspClass::getFreeHeap() { return freeHeap(); }
+uint32_t EspClass::getHeapSize() { return HostHeap::SIZE; }
+uint32_t EspClass::getMinFreeHeap() { return HostHeap::minFree(); }
+uint32_t EspClass::getMaxAllocHeap() { return freeHeap(); }
+uint32_t EspClass::getMaxFreeBlockSize() { return freeHeap(); }
+uint8_t EspClass::getHeapFragmentation() { return 0; }
+
+void EspClass::getHeapStats(uint32_t *free, uint16_t *max, uint8_t *frag)
+{
+	uint32_t maxBlock;
+	getHeapStats(free, &maxBlock, frag);
+	if (max != nullptr)
+		*max = maxBlock > 0xffff ? 0xffff : maxBlock;
+}
+
+void EspClass::getHeapStats(uint32_t *free, uint32_t *max, uint8_t *frag)
+{
+	if (free != nullptr)
+		*free = freeHeap();
+	if (max != nullptr)
+		*max = freeHeap();
+	if (frag != nullptr)
+		*frag = 0;
+}
+
+uint32_t EspClass::getChipId()
+{
+	return 0x00c0ffee;
+}
+
+void EspClass::restart()
+{
+	fprintf(stderr, "ESP.restart() called\n");
+	exit(1);
+}
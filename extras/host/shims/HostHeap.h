@@ -0,0 +1,38 @@
+#ifndef HOST_HEAP_H
+#define HOST_HEAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Heap usage of the host process, tracked by wrapping malloc/free/realloc/calloc and
+// operator new/delete (enabled by HOST_HEAP_TRACKING, see CMakeLists.txt).
+// Sizes are the usable sizes of host allocations: 64 bit pointers and a different allocator
+// make them larger than on device, so compare numbers measured on host only.
+namespace HostHeap {
+
+	struct Stats {
+		size_t      current;        // bytes allocated now
+		size_t      peak;           // max of current since last resetPeak()
+		uint64_t    allocations;    // malloc, calloc, realloc and new calls
+		uint64_t    frees;
+	};
+
+	// heap size reported by ESP.getFreeHeap() and heap_caps_*() as free heap + allocated bytes
+	const size_t SIZE = 4 * 1024 * 1024;
+
+	// false if allocation functions are not wrapped (counters stay at zero)
+	bool enabled();
+
+	Stats stats();
+
+	// allocations done by calling thread (i.e. loop task only)
+	uint64_t threadAllocations();
+
+	// start measuring peak from current usage
+	void resetPeak();
+
+	// min free heap seen since start
+	size_t minFree();
+}
+
+#endif
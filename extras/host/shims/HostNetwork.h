@@ -0,0 +1,35 @@
+#ifndef HOST_NETWORK_H
+#define HOST_NETWORK_H
+
+#include <stdint.h>
+
+// Network settings of host clients (WiFiClient, WiFiClientSecure, HTTPClient)
+namespace HostNetwork {
+
+	struct Stats {
+		uint32_t    connections;        // connect() calls succeeded
+		uint64_t    bytesSent;
+		uint64_t    bytesReceived;
+	};
+
+	// connections to any host and port are opened with host:port instead
+	// (i.e. a fake server on localhost). port = 0 removes the redirection
+	void redirect(const char *host, uint16_t port);
+
+	// WiFi link state: while down WiFi.status() is WL_DISCONNECTED and connect() fails
+	void setLinkUp(bool up);
+	bool linkUp();
+
+	// time spent by WiFiClientSecure::connect() after the TCP connection is open, to simulate
+	// the TLS handshake (a resumed session is faster on ESP8266). Default 0 (no delay)
+	void setHandshakeTime(uint32_t fullMs, uint32_t resumedMs);
+	uint32_t handshakeTime(bool resumed);
+
+	// close all connections opened by clients (as if the access point was lost)
+	void dropConnections();
+
+	Stats stats();
+	void resetStats();
+}
+
+#endif
@@ -0,0 +1,31 @@
+#include "Arduino.h"
+
+IPAddress::IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+{
+	uint8_t *bytes = (uint8_t *) &m_address;
+	bytes[0] = a;
+	bytes[1] = b;
+	bytes[2] = c;
+	bytes[3] = d;
+}
+
+bool IPAddress::fromString(const char *address)
+{
+	unsigned int parts[4];
+	char tail;
+	if (address == nullptr || sscanf(address, "%u.%u.%u.%u%c", &parts[0], &parts[1], &parts[2], &parts[3], &tail) != 4)
+		return false;
+	for (int i = 0; i < 4; i++) {
+		if (parts[i] > 255)
+			return false;
+	}
+	*this = IPAddress(parts[0], parts[1], parts[2], parts[3]);
+	return true;
+}
+
+String IPAddress::toString() const
+{
+	char buf[16];
+	snprintf(buf, sizeof(buf), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+	return String(buf);
+}
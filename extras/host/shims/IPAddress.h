@@ -0,0 +1,28 @@
+#ifndef HOST_IPADDRESS_H
+#define HOST_IPADDRESS_H
+
+#include <stdint.h>
+#include "WString.h"
+
+// IPv4 address
+class IPAddress {
+public:
+	IPAddress() : m_address(0) {}
+	IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d);
+	IPAddress(uint32_t address) : m_address(address) {}
+
+	bool fromString(const char *address);
+	inline bool fromString(const String &address) { return fromString(address.c_str()); }
+	String toString() const;
+
+	// address in network byte order
+	inline operator uint32_t() const { return m_address; }
+	inline uint8_t operator[](int index) const { return ((const uint8_t *) &m_address)[index]; }
+	inline bool operator==(const IPAddress &rhs) const { return m_address == rhs.m_address; }
+	inline bool operator!=(const IPAddress &rhs) const { return m_address != rhs.m_address; }
+
+private:
+	uint32_t m_address;
+};
+
+#endif
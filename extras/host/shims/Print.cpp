@@ -0,0 +1,76 @@
+#include "Arduino.h"
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+	size_t n = 0;
+	while (n < size && write(buffer[n]) == 1)
+		n++;
+	return n;
+}
+
+size_t Print::printf(const char *format, ...)
+{
+	char local[128];
+	va_list args;
+	va_start(args, format);
+	int len = vsnprintf(local, sizeof(local), format, args);
+	va_end(args);
+	if (len < 0)
+		return 0;
+	if ((size_t) len < sizeof(local))
+		return write((const uint8_t *) local, len);
+
+	char *buf = (char *) malloc(len + 1);
+	if (buf == nullptr)
+		return 0;
+	va_start(args, format);
+	vsnprintf(buf, len + 1, format, args);
+	va_end(args);
+	size_t n = write((const uint8_t *) buf, len);
+	free(buf);
+	return n;
+}
+
+size_t Print::print(const __FlashStringHelper *str) { return write(reinterpret_cast<const char *>(str)); }
+size_t Print::print(const String &str) { return write(str.c_str(), str.length()); }
+size_t Print::print(const char *str) { return write(str); }
+size_t Print::print(char c) { return write((uint8_t) c); }
+size_t Print::print(unsigned char value, int base) { return print((unsigned long long) value, base); }
+size_t Print::print(int value, int base) { return print((long long) value, base); }
+size_t Print::print(unsigned int value, int base) { return print((unsigned long long) value, base); }
+size_t Print::print(long value, int base) { return print((long long) value, base); }
+size_t Print::print(unsigned long value, int base) { return print((unsigned long long) value, base); }
+
+size_t Print::print(long long value, int base)
+{
+	if (value < 0 && base == 10)
+		return print('-') + print(0ULL - (unsigned long long) value, base);
+	return print((unsigned long long) value, base);
+}
+
+size_t Print::print(unsigned long long value, int base)
+{
+	// Digits are written from the end of a stack buffer (no heap allocation, as Arduino cores)
+	char buf[66];
+	char *p = buf + sizeof(buf);
+	if (base < 2 || base > 36)
+		base = 10;
+	do {
+		unsigned d = value % base;
+		*--p = d < 10 ? '0' + d : 'A' + d - 10;
+		value /= base;
+	} while (value > 0);
+	return write(p, buf + sizeof(buf) - p);
+}
+
+size_t Print::print(double value, int digits)
+{
+	char buf[64];
+	int len = snprintf(buf, sizeof(buf), "%.*f", digits, value);
+	return write(buf, len > 0 ? std::min((size_t) len, sizeof(buf) - 1) : 0);
+}
+
+size_t Print::println()
+{
+	return write("\r\n", 2);
+}
@@ -0,0 +1,50 @@
+#ifndef HOST_PRINT_H
+#define HOST_PRINT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "WString.h"
+
+#ifndef DEC
+#define DEC 10
+#endif
+
+class Print {
+public:
+	virtual ~Print() {}
+
+	virtual size_t write(uint8_t) = 0;
+	virtual size_t write(const uint8_t *buffer, size_t size);
+	inline size_t write(const char *str) {
+		return str != nullptr ? write((const uint8_t *) str, strlen(str)) : 0;
+	}
+	inline size_t write(const char *buffer, size_t size) {
+		return write((const uint8_t *) buffer, size);
+	}
+	virtual int availableForWrite() { return 0; }
+	virtual void flush() {}
+
+	size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+	size_t print(const __FlashStringHelper *str);
+	size_t print(const String &str);
+	size_t print(const char *str);
+	size_t print(char c);
+	size_t print(unsigned char value, int base = DEC);
+	size_t print(int value, int base = DEC);
+	size_t print(unsigned int value, int base = DEC);
+	size_t print(long value, int base = DEC);
+	size_t print(unsigned long value, int base = DEC);
+	size_t print(long long value, int base = DEC);
+	size_t print(unsigned long long value, int base = DEC);
+	size_t print(double value, int digits = 2);
+
+	size_t println();
+	template <typename T>
+	size_t println(const T &value) { size_t n = print(value); return n + println(); }
+	template <typename T>
+	size_t println(const T &value, int format) { size_t n = print(value, format); return n + println(); }
+};
+
+#endif
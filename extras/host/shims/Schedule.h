@@ -0,0 +1,11 @@
+#ifndef HOST_SCHEDULE_H
+#define HOST_SCHEDULE_H
+
+#include <functional>
+
+// ESP8266 scheduled functions: they run on loop task after loop() returns.
+// On host there is no loop(): call run_scheduled_functions() where loop() would end.
+bool schedule_function(const std::function<void(void)> &fn);
+void run_scheduled_functions();
+
+#endif
@@ -0,0 +1,89 @@
+#include "Arduino.h"
+
+int Stream::timedRead()
+{
+	unsigned long start = millis();
+	do {
+		int c = read();
+		if (c >= 0)
+			return c;
+		yield();
+	} while (millis() - start < m_timeout);
+	return -1;
+}
+
+int Stream::timedPeek()
+{
+	unsigned long start = millis();
+	do {
+		int c = peek();
+		if (c >= 0)
+			return c;
+		yield();
+	} while (millis() - start < m_timeout);
+	return -1;
+}
+
+bool Stream::find(const char *target)
+{
+	return find(target, strlen(target));
+}
+
+bool Stream::find(const char *target, size_t length)
+{
+	if (length == 0)
+		return true;
+	size_t matched = 0;
+	int c;
+	while ((c = timedRead()) >= 0) {
+		if (c == target[matched]) {
+			if (++matched == length)
+				return true;
+		}
+		else
+			matched = (c == target[0]) ? 1 : 0;
+	}
+	return false;
+}
+
+size_t Stream::readBytes(char *buffer, size_t length)
+{
+	size_t count = 0;
+	while (count < length) {
+		int c = timedRead();
+		if (c < 0)
+			break;
+		buffer[count++] = (char) c;
+	}
+	return count;
+}
+
+size_t Stream::readBytesUntil(char terminator, char *buffer, size_t length)
+{
+	size_t count = 0;
+	while (count < length) {
+		int c = timedRead();
+		if (c < 0 || c == terminator)
+			break;
+		buffer[count++] = (char) c;
+	}
+	return count;
+}
+
+String Stream::readString()
+{
+	String ret;
+	int c;
+	while ((c = timedRead()) >= 0)
+		ret += (char) c;
+	return ret;
+}
+
+String Stream::readStringUntil(char terminator)
+{
+	String ret;
+	int c;
+	while ((c = timedRead()) >= 0 && c != terminator)
+		ret += (char) c;
+	return ret;
+}
@@ -0,0 +1,32 @@
+#ifndef HOST_STREAM_H
+#define HOST_STREAM_H
+
+#include "Print.h"
+
+class Stream : public Print {
+public:
+	virtual int available() = 0;
+	virtual int read() = 0;
+	virtual int peek() = 0;
+
+	// timeout (ms) of readBytes(), readString() and find()
+	inline void setTimeout(unsigned long timeout) { m_timeout = timeout; }
+	inline unsigned long getTimeout() const { return m_timeout; }
+
+	bool find(const char *target);
+	bool find(const char *target, size_t length);
+	virtual size_t readBytes(char *buffer, size_t length);
+	inline size_t readBytes(uint8_t *buffer, size_t length) { return readBytes((char *) buffer, length); }
+	size_t readBytesUntil(char terminator, char *buffer, size_t length);
+	String readString();
+	String readStringUntil(char terminator);
+
+protected:
+	// read next byte, waiting up to timeout (-1 if none)
+	int timedRead();
+	int timedPeek();
+
+	unsigned long m_timeout = 1000;
+};
+
+#endif
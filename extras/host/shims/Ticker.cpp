@@ -0,0 +1,74 @@
+#include "Arduino.h"
+#include "Ticker.h"
+#include <vector>
+
+// Tickers can be constructed before main() (i.e. members of a global bot)
+static std::vector<Ticker *> &tickers()
+{
+	static std::vector<Ticker *> list;
+	return list;
+}
+
+static std::vector<std::function<void(void)>> s_scheduled;
+
+bool schedule_function(const std::function<void(void)> &fn)
+{
+	s_scheduled.push_back(fn);
+	return true;
+}
+
+void run_scheduled_functions()
+{
+	Ticker::checkTimers();
+	// Functions scheduled while running are run next time
+	std::vector<std::function<void(void)>> functions;
+	functions.swap(s_scheduled);
+	for (auto &fn : functions)
+		fn();
+}
+
+
+Ticker::Ticker()
+{
+	tickers().push_back(this);
+}
+
+Ticker::~Ticker()
+{
+	std::vector<Ticker *> &list = tickers();
+	for (size_t i = 0; i < list.size(); i++) {
+		if (list[i] == this) {
+			list.erase(list.begin() + i);
+			break;
+		}
+	}
+}
+
+void Ticker::start(uint32_t milliseconds, bool repeat, callback_function_t callback)
+{
+	m_callback = callback;
+	m_period = milliseconds;
+	m_start = millis();
+	m_repeat = repeat;
+	m_active = true;
+}
+
+void Ticker::detach()
+{
+	m_active = false;
+	m_callback = nullptr;
+}
+
+void Ticker::checkTimers()
+{
+	uint32_t now = millis();
+	for (Ticker *ticker : tickers()) {
+		if (!ticker->m_active || now - ticker->m_start < ticker->m_period)
+			continue;
+		schedule_function(ticker->m_callback);
+		if (ticker->m_repeat)
+			ticker->m_start = now;
+		else
+			ticker->m_active = false;
+	}
+}
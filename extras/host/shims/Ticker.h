@@ -0,0 +1,42 @@
+#ifndef HOST_TICKER_H
+#define HOST_TICKER_H
+
+#include <stdint.h>
+#include <functional>
+#include "Schedule.h"
+
+// ESP8266 Ticker. Timers are checked by run_scheduled_functions(), which schedules
+// the callbacks of expired ones: callbacks always run on loop task, also with attach()
+class Ticker {
+public:
+	typedef std::function<void(void)> callback_function_t;
+
+	Ticker();
+	~Ticker();
+
+	void attach_scheduled(float seconds, callback_function_t callback) { attach_ms_scheduled(seconds * 1000, callback); }
+	void attach_ms_scheduled(uint32_t milliseconds, callback_function_t callback) { start(milliseconds, true, callback); }
+	void attach(float seconds, callback_function_t callback) { attach_ms(seconds * 1000, callback); }
+	void attach_ms(uint32_t milliseconds, callback_function_t callback) { start(milliseconds, true, callback); }
+	void once_scheduled(float seconds, callback_function_t callback) { once_ms_scheduled(seconds * 1000, callback); }
+	void once_ms_scheduled(uint32_t milliseconds, callback_function_t callback) { start(milliseconds, false, callback); }
+	void once(float seconds, callback_function_t callback) { once_ms(seconds * 1000, callback); }
+	void once_ms(uint32_t milliseconds, callback_function_t callback) { start(milliseconds, false, callback); }
+
+	void detach();
+	bool active() const { return m_active; }
+
+	// schedule callbacks of expired timers
+	static void checkTimers();
+
+private:
+	void start(uint32_t milliseconds, bool repeat, callback_function_t callback);
+
+	callback_function_t m_callback;
+	uint32_t    m_period = 0;
+	uint32_t    m_start = 0;
+	bool        m_repeat = false;
+	bool        m_active = false;
+};
+
+#endif
@@ -0,0 +1,529 @@
+#include "Arduino.h"
+
+static void formatInteger(char *buf, unsigned long long value, bool negative, unsigned char base)
+{
+	char digits[66];
+	int n = 0;
+	if (base < 2 || base > 36)
+		base = 10;
+	do {
+		unsigned d = value % base;
+		digits[n++] = d < 10 ? '0' + d : 'a' + d - 10;
+		value /= base;
+	} while (value > 0);
+	if (negative)
+		*buf++ = '-';
+	while (n > 0)
+		*buf++ = digits[--n];
+	*buf = '\0';
+}
+
+static void formatSigned(char *buf, long long value, unsigned char base)
+{
+	// Negative values are written with sign in base 10 only (as Arduino cores do)
+	if (value < 0 && base == 10)
+		formatInteger(buf, 0ULL - (unsigned long long) value, true, base);
+	else
+		formatInteger(buf, (unsigned long long) value, false, base);
+}
+
+
+String::String(const char *cstr)
+{
+	if (cstr != nullptr)
+		copy(cstr, strlen(cstr));
+}
+
+String::String(const char *cstr, unsigned int length)
+{
+	if (cstr != nullptr)
+		copy(cstr, length);
+}
+
+String::String(const String &str)
+{
+	copy(str.buffer(), str.m_len);
+}
+
+String::String(String &&str) noexcept
+{
+	move(str);
+}
+
+String::String(const __FlashStringHelper *str) : String(reinterpret_cast<const char *>(str)) {}
+
+String::String(char c)
+{
+	char buf[2] = {c, '\0'};
+	copy(buf, 1);
+}
+
+String::String(unsigned char value, unsigned char base) : String((unsigned long long) value, base) {}
+String::String(int value, unsigned char base) : String((long long) value, base) {}
+String::String(unsigned int value, unsigned char base) : String((unsigned long long) value, base) {}
+String::String(long value, unsigned char base) : String((long long) value, base) {}
+String::String(unsigned long value, unsigned char base) : String((unsigned long long) value, base) {}
+
+String::String(long long value, unsigned char base)
+{
+	char buf[68];
+	formatSigned(buf, value, base);
+	copy(buf, strlen(buf));
+}
+
+String::String(unsigned long long value, unsigned char base)
+{
+	char buf[68];
+	formatInteger(buf, value, false, base);
+	copy(buf, strlen(buf));
+}
+
+String::String(float value, unsigned char decimalPlaces) : String((double) value, decimalPlaces) {}
+
+String::String(double value, unsigned char decimalPlaces)
+{
+	char buf[64];
+	snprintf(buf, sizeof(buf), "%.*f", decimalPlaces, value);
+	copy(buf, strlen(buf));
+}
+
+String::~String()
+{
+	free(m_heap);
+}
+
+
+void String::invalidate()
+{
+	free(m_heap);
+	m_heap = nullptr;
+	m_capacity = 0;
+	m_len = 0;
+	m_sso[0] = '\0';
+}
+
+bool String::reserve(unsigned int size)
+{
+	if (size <= capacity())
+		return true;
+	return changeBuffer(size);
+}
+
+bool String::changeBuffer(unsigned int maxStrLen)
+{
+	if (maxStrLen <= SSO_SIZE) {
+		if (m_heap != nullptr) {
+			memcpy(m_sso, m_heap, m_len + 1);
+			free(m_heap);
+			m_heap = nullptr;
+		}
+		return true;
+	}
+	bool wasSSO = m_heap == nullptr;
+	char *buf = (char *) realloc(m_heap, maxStrLen + 1);
+	if (buf == nullptr)
+		return false;
+	if (wasSSO)
+		memcpy(buf, m_sso, m_len + 1);
+	m_heap = buf;
+	m_capacity = maxStrLen;
+	return true;
+}
+
+void String::clear()
+{
+	m_len = 0;
+	wbuffer()[0] = '\0';
+}
+
+String &String::copy(const char *cstr, unsigned int length)
+{
+	if (!reserve(length)) {
+		invalidate();
+		return *this;
+	}
+	m_len = length;
+	memmove(wbuffer(), cstr, length);
+	wbuffer()[length] = '\0';
+	return *this;
+}
+
+void String::move(String &rhs) noexcept
+{
+	free(m_heap);
+	m_heap = rhs.m_heap;
+	m_capacity = rhs.m_capacity;
+	m_len = rhs.m_len;
+	memcpy(m_sso, rhs.m_sso, sizeof(m_sso));
+	rhs.m_heap = nullptr;
+	rhs.m_capacity = 0;
+	rhs.m_len = 0;
+	rhs.m_sso[0] = '\0';
+}
+
+String &String::operator=(const String &rhs)
+{
+	if (this != &rhs)
+		copy(rhs.buffer(), rhs.m_len);
+	return *this;
+}
+
+String &String::operator=(String &&rhs) noexcept
+{
+	if (this != &rhs)
+		move(rhs);
+	return *this;
+}
+
+String &String::operator=(const char *cstr)
+{
+	if (cstr == nullptr)
+		invalidate();
+	else
+		copy(cstr, strlen(cstr));
+	return *this;
+}
+
+String &String::operator=(const __FlashStringHelper *str)
+{
+	return *this = reinterpret_cast<const char *>(str);
+}
+
+String &String::operator=(char c)
+{
+	char buf[2] = {c, '\0'};
+	return copy(buf, 1);
+}
+
+
+bool String::concat(const char *cstr, unsigned int length)
+{
+	if (cstr == nullptr)
+		return false;
+	if (length == 0)
+		return true;
+	unsigned int newlen = m_len + length;
+	// cstr can point inside this string
+	if (cstr >= buffer() && cstr < buffer() + m_len) {
+		size_t offset = cstr - buffer();
+		if (!reserve(newlen))
+			return false;
+		cstr = buffer() + offset;
+	}
+	else if (!reserve(newlen))
+		return false;
+	memmove(wbuffer() + m_len, cstr, length);
+	m_len = newlen;
+	wbuffer()[m_len] = '\0';
+	return true;
+}
+
+bool String::concat(const String &str) { return concat(str.buffer(), str.m_len); }
+bool String::concat(const char *cstr) { return cstr != nullptr && concat(cstr, strlen(cstr)); }
+bool String::concat(const __FlashStringHelper *str) { return concat(reinterpret_cast<const char *>(str)); }
+bool String::concat(char c) { return concat(&c, 1); }
+
+bool String::concat(unsigned char num) { return concat((unsigned long long) num); }
+bool String::concat(int num) { return concat((long long) num); }
+bool String::concat(unsigned int num) { return concat((unsigned long long) num); }
+bool String::concat(long num) { return concat((long long) num); }
+bool String::concat(unsigned long num) { return concat((unsigned long long) num); }
+
+bool String::concat(long long num)
+{
+	char buf[68];
+	formatSigned(buf, num, 10);
+	return concat(buf, strlen(buf));
+}
+
+bool String::concat(unsigned long long num)
+{
+	char buf[68];
+	formatInteger(buf, num, false, 10);
+	return concat(buf, strlen(buf));
+}
+
+bool String::concat(float num) { return concat((double) num); }
+
+bool String::concat(double num)
+{
+	char buf[64];
+	snprintf(buf, sizeof(buf), "%.2f", num);
+	return concat(buf, strlen(buf));
+}
+
+
+int String::compareTo(const String &s) const
+{
+	return strcmp(buffer(), s.buffer());
+}
+
+bool String::equals(const String &s) const
+{
+	return m_len == s.m_len && memcmp(buffer(), s.buffer(), m_len) == 0;
+}
+
+bool String::equals(const char *cstr) const
+{
+	if (cstr == nullptr)
+		return m_len == 0;
+	return strcmp(buffer(), cstr) == 0;
+}
+
+bool String::equalsIgnoreCase(const String &s) const
+{
+	if (m_len != s.m_len)
+		return false;
+	for (unsigned int i = 0; i < m_len; i++) {
+		if (tolower((unsigned char) buffer()[i]) != tolower((unsigned char) s.buffer()[i]))
+			return false;
+	}
+	return true;
+}
+
+bool String::startsWith(const String &prefix) const
+{
+	return startsWith(prefix, 0);
+}
+
+bool String::startsWith(const String &prefix, unsigned int offset) const
+{
+	if (offset > m_len || prefix.m_len > m_len - offset)
+		return false;
+	return memcmp(buffer() + offset, prefix.buffer(), prefix.m_len) == 0;
+}
+
+bool String::endsWith(const String &suffix) const
+{
+	if (suffix.m_len > m_len)
+		return false;
+	return memcmp(buffer() + m_len - suffix.m_len, suffix.buffer(), suffix.m_len) == 0;
+}
+
+
+char String::charAt(unsigned int index) const
+{
+	return index < m_len ? buffer()[index] : '\0';
+}
+
+void String::setCharAt(unsigned int index, char c)
+{
+	if (index < m_len)
+		wbuffer()[index] = c;
+}
+
+char String::operator[](unsigned int index) const
+{
+	return charAt(index);
+}
+
+char &String::operator[](unsigned int index)
+{
+	static char dummy;
+	if (index >= m_len) {
+		dummy = '\0';
+		return dummy;
+	}
+	return wbuffer()[index];
+}
+
+void String::getBytes(unsigned char *buf, unsigned int bufsize, unsigned int index) const
+{
+	if (bufsize == 0 || buf == nullptr)
+		return;
+	if (index >= m_len) {
+		buf[0] = '\0';
+		return;
+	}
+	unsigned int n = std::min(bufsize - 1, m_len - index);
+	memcpy(buf, buffer() + index, n);
+	buf[n] = '\0';
+}
+
+
+int String::indexOf(char ch, unsigned int fromIndex) const
+{
+	if (fromIndex >= m_len)
+		return -1;
+	const char *p = (const char *) memchr(buffer() + fromIndex, ch, m_len - fromIndex);
+	return p != nullptr ? int(p - buffer()) : -1;
+}
+
+int String::indexOf(const char *str, unsigned int fromIndex) const
+{
+	if (str == nullptr || fromIndex > m_len)
+		return -1;
+	const char *p = strstr(buffer() + fromIndex, str);
+	return p != nullptr ? int(p - buffer()) : -1;
+}
+
+int String::indexOf(const String &str, unsigned int fromIndex) const
+{
+	return indexOf(str.buffer(), fromIndex);
+}
+
+int String::lastIndexOf(char ch) const
+{
+	return m_len > 0 ? lastIndexOf(ch, m_len - 1) : -1;
+}
+
+int String::lastIndexOf(char ch, unsigned int fromIndex) const
+{
+	if (fromIndex >= m_len)
+		return -1;
+	for (int i = fromIndex; i >= 0; i--) {
+		if (buffer()[i] == ch)
+			return i;
+	}
+	return -1;
+}
+
+int String::lastIndexOf(const String &str) const
+{
+	if (str.m_len == 0 || str.m_len > m_len)
+		return -1;
+	for (int i = m_len - str.m_len; i >= 0; i--) {
+		if (memcmp(buffer() + i, str.buffer(), str.m_len) == 0)
+			return i;
+	}
+	return -1;
+}
+
+String String::substring(unsigned int left, unsigned int right) const
+{
+	if (left > right)
+		std::swap(left, right);
+	if (left >= m_len)
+		return String();
+	if (right > m_len)
+		right = m_len;
+	return String(buffer() + left, right - left);
+}
+
+
+void String::replace(char find, char replace)
+{
+	for (char *p = wbuffer(); *p; p++) {
+		if (*p == find)
+			*p = replace;
+	}
+}
+
+void String::replace(const String &find, const String &replace)
+{
+	if (m_len == 0 || find.m_len == 0)
+		return;
+	String result;
+	unsigned int i = 0;
+	int found;
+	while ((found = indexOf(find, i)) >= 0) {
+		result.concat(buffer() + i, found - i);
+		result.concat(replace);
+		i = found + find.m_len;
+	}
+	if (i == 0)
+		return;
+	result.concat(buffer() + i, m_len - i);
+	*this = static_cast<String &&>(result);
+}
+
+void String::remove(unsigned int index)
+{
+	remove(index, (unsigned int) -1);
+}
+
+void String::remove(unsigned int index, unsigned int count)
+{
+	if (index >= m_len)
+		return;
+	if (count > m_len - index)
+		count = m_len - index;
+	char *buf = wbuffer();
+	memmove(buf + index, buf + index + count, m_len - index - count + 1);
+	m_len -= count;
+}
+
+void String::toLowerCase()
+{
+	for (char *p = wbuffer(); *p; p++)
+		*p = tolower((unsigned char) *p);
+}
+
+void String::toUpperCase()
+{
+	for (char *p = wbuffer(); *p; p++)
+		*p = toupper((unsigned char) *p);
+}
+
+void String::trim()
+{
+	const char *buf = buffer();
+	unsigned int begin = 0;
+	unsigned int end = m_len;
+	while (begin < end && isspace((unsigned char) buf[begin]))
+		begin++;
+	while (end > begin && isspace((unsigned char) buf[end - 1]))
+		end--;
+	if (begin > 0)
+		memmove(wbuffer(), buf + begin, end - begin);
+	m_len = end - begin;
+	wbuffer()[m_len] = '\0';
+}
+
+long String::toInt() const
+{
+	return atol(buffer());
+}
+
+float String::toFloat() const
+{
+	return (float) atof(buffer());
+}
+
+double String::toDouble() const
+{
+	return atof(buffer());
+}
+
+
+StringSumHelper operator+(const String &lhs, const String &rhs)
+{
+	StringSumHelper s(lhs);
+	s.concat(rhs);
+	return s;
+}
+
+StringSumHelper operator+(const String &lhs, const char *rhs)
+{
+	StringSumHelper s(lhs);
+	s.concat(rhs);
+	return s;
+}
+
+StringSumHelper operator+(const char *lhs, const String &rhs)
+{
+	StringSumHelper s(lhs);
+	s.concat(rhs);
+	return s;
+}
+
+StringSumHelper operator+(const String &lhs, const __FlashStringHelper *rhs)
+{
+	StringSumHelper s(lhs);
+	s.concat(rhs);
+	return s;
+}
+
+StringSumHelper operator+(const String &lhs, char rhs)
+{
+	StringSumHelper s(lhs);
+	s.concat(rhs);
+	return s;
+}
+
+StringSumHelper operator+(char lhs, const String &rhs)
+{
+	StringSumHelper s(lhs);
+	s.concat(rhs);
+	return s;
+}
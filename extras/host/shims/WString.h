@@ -0,0 +1,158 @@
+#ifndef HOST_WSTRING_H
+#define HOST_WSTRING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+class __FlashStringHelper;
+class StringSumHelper;
+
+// Arduino String, with the same allocation behaviour of ESP cores:
+// up to SSO_SIZE chars are stored in the object, longer strings in a heap buffer
+// that is reallocated to the exact size needed (no geometric growth)
+class String {
+public:
+	static const unsigned int SSO_SIZE = 11;
+
+	String(const char *cstr = "");
+	String(const char *cstr, unsigned int length);
+	String(const String &str);
+	String(String &&str) noexcept;
+	String(const __FlashStringHelper *str);
+	explicit String(char c);
+	explicit String(unsigned char value, unsigned char base = 10);
+	explicit String(int value, unsigned char base = 10);
+	explicit String(unsigned int value, unsigned char base = 10);
+	explicit String(long value, unsigned char base = 10);
+	explicit String(unsigned long value, unsigned char base = 10);
+	explicit String(long long value, unsigned char base = 10);
+	explicit String(unsigned long long value, unsigned char base = 10);
+	explicit String(float value, unsigned char decimalPlaces = 2);
+	explicit String(double value, unsigned char decimalPlaces = 2);
+	~String();
+
+	// false if memory is not available
+	bool reserve(unsigned int size);
+	inline unsigned int length() const { return m_len; }
+	inline bool isEmpty() const { return m_len == 0; }
+	void clear();
+
+	String &operator=(const String &rhs);
+	String &operator=(String &&rhs) noexcept;
+	String &operator=(const char *cstr);
+	String &operator=(const __FlashStringHelper *str);
+	String &operator=(char c);
+
+	bool concat(const String &str);
+	bool concat(const char *cstr);
+	bool concat(const char *cstr, unsigned int length);
+	bool concat(const __FlashStringHelper *str);
+	bool concat(char c);
+	bool concat(unsigned char num);
+	bool concat(int num);
+	bool concat(unsigned int num);
+	bool concat(long num);
+	bool concat(unsigned long num);
+	bool concat(long long num);
+	bool concat(unsigned long long num);
+	bool concat(float num);
+	bool concat(double num);
+
+	template <typename T>
+	String &operator+=(const T &rhs) { concat(rhs); return *this; }
+
+	int compareTo(const String &s) const;
+	bool equals(const String &s) const;
+	bool equals(const char *cstr) const;
+	bool equalsIgnoreCase(const String &s) const;
+	bool startsWith(const String &prefix) const;
+	bool startsWith(const String &prefix, unsigned int offset) const;
+	bool endsWith(const String &suffix) const;
+
+	inline bool operator==(const String &rhs) const { return equals(rhs); }
+	inline bool operator==(const char *cstr) const { return equals(cstr); }
+	inline bool operator!=(const String &rhs) const { return !equals(rhs); }
+	inline bool operator!=(const char *cstr) const { return !equals(cstr); }
+	inline bool operator<(const String &rhs) const { return compareTo(rhs) < 0; }
+	inline bool operator>(const String &rhs) const { return compareTo(rhs) > 0; }
+	inline bool operator<=(const String &rhs) const { return compareTo(rhs) <= 0; }
+	inline bool operator>=(const String &rhs) const { return compareTo(rhs) >= 0; }
+
+	char charAt(unsigned int index) const;
+	void setCharAt(unsigned int index, char c);
+	char operator[](unsigned int index) const;
+	char &operator[](unsigned int index);
+	void getBytes(unsigned char *buf, unsigned int bufsize, unsigned int index = 0) const;
+	inline void toCharArray(char *buf, unsigned int bufsize, unsigned int index = 0) const {
+		getBytes((unsigned char *) buf, bufsize, index);
+	}
+	inline const char *c_str() const { return buffer(); }
+	inline char *begin() { return wbuffer(); }
+	inline char *end() { return wbuffer() + m_len; }
+	inline const char *begin() const { return c_str(); }
+	inline const char *end() const { return c_str() + m_len; }
+
+	int indexOf(char ch, unsigned int fromIndex = 0) const;
+	int indexOf(const char *str, unsigned int fromIndex = 0) const;
+	int indexOf(const String &str, unsigned int fromIndex = 0) const;
+	int lastIndexOf(char ch) const;
+	int lastIndexOf(char ch, unsigned int fromIndex) const;
+	int lastIndexOf(const String &str) const;
+	String substring(unsigned int beginIndex) const { return substring(beginIndex, m_len); }
+	String substring(unsigned int beginIndex, unsigned int endIndex) const;
+
+	void replace(char find, char replace);
+	void replace(const String &find, const String &replace);
+	void remove(unsigned int index);
+	void remove(unsigned int index, unsigned int count);
+	void toLowerCase();
+	void toUpperCase();
+	void trim();
+
+	long toInt() const;
+	float toFloat() const;
+	double toDouble() const;
+
+protected:
+	inline const char *buffer() const { return m_heap != nullptr ? m_heap : m_sso; }
+	inline char *wbuffer() { return m_heap != nullptr ? m_heap : m_sso; }
+	inline unsigned int capacity() const { return m_heap != nullptr ? m_capacity : SSO_SIZE; }
+
+	bool changeBuffer(unsigned int maxStrLen);
+	String &copy(const char *cstr, unsigned int length);
+	void move(String &rhs) noexcept;
+	void invalidate();
+
+	char *m_heap = nullptr;
+	unsigned int m_capacity = 0;
+	unsigned int m_len = 0;
+	char m_sso[SSO_SIZE + 1] = {0};
+};
+
+// Type of temporary strings built with operator+ (needed by ArduinoJson string adapters)
+class StringSumHelper : public String {
+public:
+	using String::String;
+	StringSumHelper(const String &s) : String(s) {}
+	StringSumHelper(String &&s) : String(static_cast<String &&>(s)) {}
+};
+
+StringSumHelper operator+(const String &lhs, const String &rhs);
+StringSumHelper operator+(const String &lhs, const char *rhs);
+StringSumHelper operator+(const char *lhs, const String &rhs);
+StringSumHelper operator+(const String &lhs, const __FlashStringHelper *rhs);
+StringSumHelper operator+(const String &lhs, char rhs);
+StringSumHelper operator+(char lhs, const String &rhs);
+
+template <typename T>
+inline StringSumHelper operator+(const String &lhs, T rhs) {
+	StringSumHelper s(lhs);
+	s.concat(rhs);
+	return s;
+}
+
+inline bool operator==(const char *lhs, const String &rhs) { return rhs.equals(lhs); }
+inline bool operator!=(const char *lhs, const String &rhs) { return !rhs.equals(lhs); }
+
+#endif
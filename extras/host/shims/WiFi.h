@@ -0,0 +1,42 @@
+#ifndef HOST_WIFI_H
+#define HOST_WIFI_H
+
+#include "Arduino.h"
+#include "WiFiClient.h"
+#include "HostNetwork.h"
+
+typedef enum {
+	WL_NO_SHIELD        = 255,
+	WL_IDLE_STATUS      = 0,
+	WL_NO_SSID_AVAIL    = 1,
+	WL_SCAN_COMPLETED   = 2,
+	WL_CONNECTED        = 3,
+	WL_CONNECT_FAILED   = 4,
+	WL_CONNECTION_LOST  = 5,
+	WL_DISCONNECTED     = 6
+} wl_status_t;
+
+typedef enum {
+	WIFI_OFF = 0,
+	WIFI_STA = 1,
+	WIFI_AP = 2,
+	WIFI_AP_STA = 3
+} WiFiMode_t;
+
+// Station always connected to host network (see HostNetwork::setLinkUp())
+class WiFiClass {
+public:
+	wl_status_t begin(const char *ssid, const char *passphrase = nullptr);
+	bool mode(WiFiMode_t mode);
+	wl_status_t status();
+	bool isConnected();
+	bool reconnect();
+	bool disconnect(bool wifiOff = false);
+	bool setAutoReconnect(bool autoReconnect);
+	IPAddress localIP();
+	int hostByName(const char *host, IPAddress &result);
+};
+
+extern WiFiClass WiFi;
+
+#endif
@@ -0,0 +1,448 @@
+#include "WiFi.h"
+#include "WiFiClientSecure.h"
+#include "HostNetwork.h"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+#define RX_BUFFER_SIZE      1460        // one TCP segment, as a lwIP pbuf
+#define CONNECT_TIMEOUT     5000
+#define SEND_TIMEOUT        5000
+
+static std::mutex               s_redirectMutex;
+static std::string              s_redirectHost;
+static uint16_t                 s_redirectPort = 0;
+static std::atomic<bool>        s_linkUp{true};
+static std::atomic<uint32_t>    s_generation{0};
+static std::atomic<uint32_t>    s_connections{0};
+static std::atomic<uint64_t>    s_bytesSent{0};
+static std::atomic<uint64_t>    s_bytesReceived{0};
+static std::atomic<uint32_t>    s_fullHandshake{0};
+static std::atomic<uint32_t>    s_resumedHandshake{0};
+
+
+namespace HostNetwork {
+
+	void redirect(const char *host, uint16_t port)
+	{
+		std::lock_guard<std::mutex> lock(s_redirectMutex);
+		s_redirectHost = host != nullptr ? host : "";
+		s_redirectPort = port;
+	}
+
+	void setLinkUp(bool up)
+	{
+		s_linkUp = up;
+		if (!up)
+			dropConnections();
+	}
+
+	bool linkUp()
+	{
+		return s_linkUp;
+	}
+
+	void setHandshakeTime(uint32_t fullMs, uint32_t resumedMs)
+	{
+		s_fullHandshake = fullMs;
+		s_resumedHandshake = resumedMs;
+	}
+
+	uint32_t handshakeTime(bool resumed)
+	{
+		return resumed ? s_resumedHandshake : s_fullHandshake;
+	}
+
+	void dropConnections()
+	{
+		s_generation++;
+	}
+
+	Stats stats()
+	{
+		Stats stats;
+		stats.connections = s_connections;
+		stats.bytesSent = s_bytesSent;
+		stats.bytesReceived = s_bytesReceived;
+		return stats;
+	}
+
+	void resetStats()
+	{
+		s_connections = 0;
+		s_bytesSent = 0;
+		s_bytesReceived = 0;
+	}
+}
+
+
+WiFiClient::WiFiClient()
+{
+}
+
+WiFiClient::~WiFiClient()
+{
+	stop();
+	free(m_rx);
+}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port)
+{
+	return connect(ip.toString().c_str(), port);
+}
+
+int WiFiClient::connect(const char *host, uint16_t port)
+{
+	return connect(host, port, CONNECT_TIMEOUT);
+}
+
+int WiFiClient::connect(const char *host, uint16_t port, int32_t timeout)
+{
+	stop();
+	if (!s_linkUp)
+		return 0;
+
+	std::string target = host;
+	{
+		std::lock_guard<std::mutex> lock(s_redirectMutex);
+		if (s_redirectPort != 0) {
+			target = s_redirectHost;
+			port = s_redirectPort;
+		}
+	}
+	if (!openSocket(target.c_str(), port, timeout))
+		return 0;
+	s_connections++;
+	return 1;
+}
+
+bool WiFiClient::openSocket(const char *host, uint16_t port, int32_t timeout)
+{
+	struct addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	struct addrinfo *result = nullptr;
+	char service[8];
+	snprintf(service, sizeof(service), "%u", port);
+	if (getaddrinfo(host, service, &hints, &result) != 0 || result == nullptr)
+		return false;
+
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0) {
+		freeaddrinfo(result);
+		return false;
+	}
+	// Non blocking connect, so timeout can be applied
+	int flags = fcntl(fd, F_GETFL, 0);
+	fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+	int res = ::connect(fd, result->ai_addr, result->ai_addrlen);
+	freeaddrinfo(result);
+	if (res < 0 && errno == EINPROGRESS) {
+		struct pollfd pfd = {fd, POLLOUT, 0};
+		int error = 0;
+		socklen_t len = sizeof(error);
+		if (poll(&pfd, 1, timeout) == 1 && getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) == 0 && error == 0)
+			res = 0;
+	}
+	if (res < 0) {
+		close(fd);
+		return false;
+	}
+	fcntl(fd, F_SETFL, flags);
+
+	int one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	struct timeval tv = {SEND_TIMEOUT / 1000, 0};
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+	m_socket = fd;
+	m_closed = false;
+	m_rxStart = m_rxEnd = 0;
+	m_generation = s_generation;
+	return true;
+}
+
+bool WiFiClient::fill(int timeout)
+{
+	if (m_socket < 0 || m_closed)
+		return false;
+	if (m_generation != s_generation) {
+		// Link lost: connection is gone (data not read yet too)
+		stop();
+		return false;
+	}
+	if (m_rxStart < m_rxEnd)
+		return true;
+	if (m_rx == nullptr) {
+		m_rx = (uint8_t *) malloc(RX_BUFFER_SIZE);
+		if (m_rx == nullptr)
+			return false;
+	}
+	if (timeout > 0) {
+		struct pollfd pfd = {m_socket, POLLIN, 0};
+		if (poll(&pfd, 1, timeout) <= 0)
+			return false;
+	}
+	ssize_t n = recv(m_socket, m_rx, RX_BUFFER_SIZE, MSG_DONTWAIT);
+	if (n > 0) {
+		m_rxStart = 0;
+		m_rxEnd = n;
+		s_bytesReceived += n;
+		return true;
+	}
+	if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+		m_closed = true;
+	return false;
+}
+
+size_t WiFiClient::write(uint8_t c)
+{
+	return write(&c, 1);
+}
+
+size_t WiFiClient::write(const uint8_t *buf, size_t size)
+{
+	if (m_socket < 0 || m_closed || m_generation != s_generation)
+		return 0;
+	size_t sent = 0;
+	while (sent < size) {
+		ssize_t n = send(m_socket, buf + sent, size - sent, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0) {
+			m_closed = true;
+			break;
+		}
+		sent += n;
+	}
+	s_bytesSent += sent;
+	return sent;
+}
+
+int WiFiClient::available()
+{
+	if (!fill(0))
+		return 0;
+	int queued = 0;
+	if (ioctl(m_socket, FIONREAD, &queued) < 0)
+		queued = 0;
+	return (m_rxEnd - m_rxStart) + queued;
+}
+
+int WiFiClient::read()
+{
+	if (!fill(0))
+		return -1;
+	return m_rx[m_rxStart++];
+}
+
+int WiFiClient::read(uint8_t *buf, size_t size)
+{
+	if (!fill(0))
+		return m_socket >= 0 ? 0 : -1;
+	size_t n = std::min(size, m_rxEnd - m_rxStart);
+	memcpy(buf, m_rx + m_rxStart, n);
+	m_rxStart += n;
+	return n;
+}
+
+int WiFiClient::peek()
+{
+	if (!fill(0))
+		return -1;
+	return m_rx[m_rxStart];
+}
+
+size_t WiFiClient::readBytes(char *buffer, size_t length)
+{
+	size_t count = 0;
+	unsigned long start = millis();
+	while (count < length) {
+		long remaining = (long) m_timeout - (long) (millis() - start);
+		if (!fill(remaining > 0 ? remaining : 0))
+			break;
+		size_t n = std::min(length - count, m_rxEnd - m_rxStart);
+		memcpy(buffer + count, m_rx + m_rxStart, n);
+		m_rxStart += n;
+		count += n;
+	}
+	return count;
+}
+
+void WiFiClient::flush()
+{
+}
+
+void WiFiClient::stop()
+{
+	if (m_socket >= 0)
+		close(m_socket);
+	m_socket = -1;
+	m_closed = false;
+	m_rxStart = m_rxEnd = 0;
+}
+
+uint8_t WiFiClient::connected()
+{
+	if (m_socket < 0)
+		return 0;
+	if (m_generation != s_generation) {
+		stop();
+		return 0;
+	}
+	// Data received before connection was closed can still be read
+	if (m_rxStart < m_rxEnd)
+		return 1;
+	if (m_closed)
+		return 0;
+	uint8_t c;
+	ssize_t n = recv(m_socket, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+	if (n > 0)
+		return 1;
+	if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+		m_closed = true;
+		return 0;
+	}
+	return 1;
+}
+
+void WiFiClient::setNoDelay(bool noDelay)
+{
+	int value = noDelay ? 1 : 0;
+	if (m_socket >= 0)
+		setsockopt(m_socket, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+}
+
+
+#if defined(ESP8266)
+
+namespace BearSSL {
+
+	int WiFiClientSecure::connect(IPAddress ip, uint16_t port)
+	{
+		if (!WiFiClient::connect(ip, port))
+			return 0;
+		handshake();
+		return 1;
+	}
+
+	int WiFiClientSecure::connect(const char *host, uint16_t port)
+	{
+		if (!WiFiClient::connect(host, port))
+			return 0;
+		handshake();
+		return 1;
+	}
+
+	void WiFiClientSecure::handshake()
+	{
+		static std::atomic<uint32_t> sessions{0};
+		bool resumed = false;
+		if (m_session != nullptr) {
+			static const uint8_t none[sizeof(m_session->m_id)] = {0};
+			resumed = memcmp(m_session->m_id, none, sizeof(none)) != 0;
+			if (!resumed) {
+				uint32_t id = ++sessions;
+				memcpy(m_session->m_id, &id, sizeof(id));
+			}
+		}
+		delay(HostNetwork::handshakeTime(resumed));
+	}
+}
+
+#else
+
+int WiFiClientSecure::connect(IPAddress ip, uint16_t port)
+{
+	if (!WiFiClient::connect(ip, port))
+		return 0;
+	handshake();
+	return 1;
+}
+
+int WiFiClientSecure::connect(const char *host, uint16_t port)
+{
+	if (!WiFiClient::connect(host, port))
+		return 0;
+	handshake();
+	return 1;
+}
+
+void WiFiClientSecure::handshake()
+{
+	delay(HostNetwork::handshakeTime(false));
+}
+
+#endif
+
+
+WiFiClass WiFi;
+
+wl_status_t WiFiClass::begin(const char *ssid, const char *passphrase)
+{
+	(void) ssid;
+	(void) passphrase;
+	return status();
+}
+
+bool WiFiClass::mode(WiFiMode_t mode)
+{
+	(void) mode;
+	return true;
+}
+
+wl_status_t WiFiClass::status()
+{
+	return s_linkUp ? WL_CONNECTED : WL_DISCONNECTED;
+}
+
+bool WiFiClass::isConnected()
+{
+	return status() == WL_CONNECTED;
+}
+
+bool WiFiClass::reconnect()
+{
+	return isConnected();
+}
+
+bool WiFiClass::disconnect(bool wifiOff)
+{
+	(void) wifiOff;
+	return true;
+}
+
+bool WiFiClass::setAutoReconnect(bool autoReconnect)
+{
+	(void) autoReconnect;
+	return true;
+}
+
+IPAddress WiFiClass::localIP()
+{
+	return IPAddress(127, 0, 0, 1);
+}
+
+int WiFiClass::hostByName(const char *host, IPAddress &result)
+{
+	struct addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	struct addrinfo *info = nullptr;
+	if (getaddrinfo(host, nullptr, &hints, &info) != 0 || info == nullptr)
+		return 0;
+	result = IPAddress(((struct sockaddr_in *) info->ai_addr)->sin_addr.s_addr);
+	freeaddrinfo(info);
+	return 1;
+}
@@ -0,0 +1,52 @@
+#ifndef HOST_WIFI_CLIENT_H
+#define HOST_WIFI_CLIENT_H
+
+#include "Arduino.h"
+#include "Client.h"
+
+// TCP client on a POSIX socket. As with lwIP, read functions never wait (except readBytes()),
+// available() and connected() report data already received by the socket.
+// Nagle algorithm is disabled, so requests written in more blocks are not delayed by loopback ACKs.
+class WiFiClient : public Client {
+public:
+	WiFiClient();
+	~WiFiClient();
+	WiFiClient(const WiFiClient &) = delete;
+	WiFiClient &operator=(const WiFiClient &) = delete;
+
+	int connect(IPAddress ip, uint16_t port) override;
+	int connect(const char *host, uint16_t port) override;
+	int connect(const char *host, uint16_t port, int32_t timeout);
+
+	size_t write(uint8_t c) override;
+	size_t write(const uint8_t *buf, size_t size) override;
+	using Print::write;
+
+	int available() override;
+	int read() override;
+	int read(uint8_t *buf, size_t size) override;
+	int peek() override;
+	size_t readBytes(char *buffer, size_t length) override;
+	using Stream::readBytes;
+
+	void flush() override;
+	void stop() override;
+	uint8_t connected() override;
+	operator bool() override { return connected(); }
+
+	void setNoDelay(bool noDelay);
+
+private:
+	// move bytes already received by socket in rx buffer (wait up to timeout ms for some)
+	bool fill(int timeout);
+	bool openSocket(const char *host, uint16_t port, int32_t timeout);
+
+	int         m_socket = -1;
+	bool        m_closed = false;       // peer has closed the connection
+	uint8_t*    m_rx = nullptr;
+	size_t      m_rxStart = 0;
+	size_t      m_rxEnd = 0;
+	uint32_t    m_generation = 0;       // to detect HostNetwork::dropConnections()
+};
+
+#endif
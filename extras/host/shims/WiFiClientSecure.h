@@ -0,0 +1,72 @@
+#ifndef HOST_WIFI_CLIENT_SECURE_H
+#define HOST_WIFI_CLIENT_SECURE_H
+
+#include "WiFi.h"
+#include "WiFiClient.h"
+
+// There is no TLS on host: data is sent in clear to the (fake) server.
+// Certificates and fingerprints are accepted and ignored, the handshake is only simulated
+// (see HostNetwork::setHandshakeTime()).
+
+#if defined(ESP8266)
+
+namespace BearSSL {
+
+	// TLS session to be resumed: filled by first connection, kept by the next ones
+	class Session {
+	public:
+		Session() { memset(m_id, 0, sizeof(m_id)); }
+	private:
+		friend class WiFiClientSecure;
+		uint8_t m_id[32];
+	};
+
+	class X509List {
+	public:
+		X509List() {}
+		X509List(const char *pemCert) { (void) pemCert; }
+		X509List(const uint8_t *derCert, size_t derLen) { (void) derCert; (void) derLen; }
+	};
+
+	class WiFiClientSecure : public ::WiFiClient {
+	public:
+		int connect(IPAddress ip, uint16_t port) override;
+		int connect(const char *host, uint16_t port) override;
+
+		inline void setSession(Session *session) { m_session = session; }
+		inline void setInsecure() {}
+		inline void setTrustAnchors(const X509List *anchors) { (void) anchors; }
+		inline bool setFingerprint(const uint8_t fingerprint[20]) { (void) fingerprint; return true; }
+		inline bool setFingerprint(const char *fingerprint) { (void) fingerprint; return true; }
+		inline void setBufferSizes(int recv, int xmit) { (void) recv; (void) xmit; }
+
+	private:
+		// simulate the handshake after TCP connection
+		void handshake();
+
+		Session *m_session = nullptr;
+	};
+}
+
+using namespace BearSSL;
+
+#else
+
+class WiFiClientSecure : public WiFiClient {
+public:
+	int connect(IPAddress ip, uint16_t port) override;
+	int connect(const char *host, uint16_t port) override;
+
+	inline void setInsecure() {}
+	inline void setCACert(const char *rootCA) { (void) rootCA; }
+	inline void setCertificate(const char *clientCA) { (void) clientCA; }
+	inline void setPrivateKey(const char *privateKey) { (void) privateKey; }
+	inline void setHandshakeTimeout(unsigned long timeout) { (void) timeout; }
+
+private:
+	void handshake();
+};
+
+#endif
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+// FreeRTOS API on top of std::thread: tasks are threads, one tick is one millisecond.
+// Priorities and core affinity are recorded but not enforced.
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef int32_t             BaseType_t;
+typedef uint32_t            UBaseType_t;
+typedef uint32_t            TickType_t;
+typedef void (*TaskFunction_t)(void *);
+
+typedef struct HostTask*        TaskHandle_t;
+typedef struct HostSemaphore*   SemaphoreHandle_t;
+typedef struct HostQueue*       QueueHandle_t;
+
+#define pdFALSE             ((BaseType_t) 0)
+#define pdTRUE              ((BaseType_t) 1)
+#define pdFAIL              pdFALSE
+#define pdPASS              pdTRUE
+#define errQUEUE_EMPTY      ((BaseType_t) 0)
+#define errQUEUE_FULL       ((BaseType_t) 0)
+
+#define portMAX_DELAY       ((TickType_t) 0xffffffffUL)
+#define portTICK_PERIOD_MS  ((TickType_t) 1)
+#define configTICK_RATE_HZ  1000
+#define pdMS_TO_TICKS(ms)   ((TickType_t) (ms))
+#define tskIDLE_PRIORITY    ((UBaseType_t) 0)
+#define tskNO_AFFINITY      ((BaseType_t) 0x7fffffff)
+
+// core of the calling task (Arduino loop task runs on core 1)
+BaseType_t xPortGetCoreID();
+
+#endif
@@ -0,0 +1,642 @@
+#include "FakeTelegramServer.h"
+#include <chrono>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#define POLL_INTERVAL   100     // ms between checks of m_running while waiting for data
+
+// Value of a number member in a JSON body as written by the library ("key":123)
+static bool findNumber(const char *json, const char *key, long &value)
+{
+	char pattern[48];
+	snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+	const char *p = strstr(json, pattern);
+	if (p == nullptr)
+		return false;
+	p += strlen(pattern);
+	while (*p == ' ')
+		p++;
+	char *end;
+	value = strtol(p, &end, 10);
+	return end != p;
+}
+
+// Value of a string member in a JSON body ("key":"value", without escapes)
+static bool findString(const char *json, const char *key, char *value, size_t size)
+{
+	char pattern[48];
+	snprintf(pattern, sizeof(pattern), "\"%s\":\"", key);
+	const char *p = strstr(json, pattern);
+	if (p == nullptr || size == 0)
+		return false;
+	p += strlen(pattern);
+	size_t n = 0;
+	while (p[n] != '\0' && p[n] != '"' && n < size - 1) {
+		value[n] = p[n];
+		n++;
+	}
+	value[n] = '\0';
+	return true;
+}
+
+static bool findParameter(const char *query, const char *key, char *value, size_t size)
+{
+	size_t keyLen = strlen(key);
+	const char *p = query;
+	while (strncmp(p, key, keyLen) != 0 || p[keyLen] != '=') {
+		p = strchr(p, '&');
+		if (p == nullptr)
+			return false;
+		p++;
+	}
+	p += keyLen + 1;
+	size_t n = 0;
+	while (p[n] != '\0' && p[n] != '&' && n < size - 1) {
+		value[n] = p[n];
+		n++;
+	}
+	value[n] = '\0';
+	return true;
+}
+
+static void copyString(char *dest, const char *src, size_t size)
+{
+	snprintf(dest, size, "%s", src);
+}
+
+
+FakeTelegramServer::FakeTelegramServer()
+{
+	memset(m_replies, 0, sizeof(m_replies));
+	memset(m_methods, 0, sizeof(m_methods));
+}
+
+FakeTelegramServer::~FakeTelegramServer()
+{
+	stop();
+	delete[] m_handlers;
+}
+
+bool FakeTelegramServer::start(uint16_t port)
+{
+	if (m_running)
+		return true;
+	m_listen = socket(AF_INET, SOCK_STREAM, 0);
+	if (m_listen < 0)
+		return false;
+	int one = 1;
+	setsockopt(m_listen, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+	socklen_t len = sizeof(addr);
+	if (bind(m_listen, (struct sockaddr *) &addr, sizeof(addr)) < 0 || listen(m_listen, 16) < 0
+	    || getsockname(m_listen, (struct sockaddr *) &addr, &len) < 0) {
+		close(m_listen);
+		m_listen = -1;
+		return false;
+	}
+	m_port = ntohs(addr.sin_port);
+
+	// Everything is allocated here, requests are served without allocations
+	if (m_handlers == nullptr)
+		m_handlers = new Handler[MAX_CONNECTIONS];
+	m_running = true;
+	for (size_t i = 0; i < MAX_CONNECTIONS; i++) {
+		m_handlers[i].fd = -1;
+		m_threads[i] = std::thread(&FakeTelegramServer::handlerLoop, this, &m_handlers[i]);
+	}
+	m_acceptThread = std::thread(&FakeTelegramServer::acceptLoop, this);
+	return true;
+}
+
+void FakeTelegramServer::stop()
+{
+	if (!m_running)
+		return;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_running = false;
+	}
+	m_changed.notify_all();
+	m_acceptThread.join();
+	for (size_t i = 0; i < MAX_CONNECTIONS; i++)
+		m_threads[i].join();
+	for (size_t i = 0; i < m_waitingCount; i++)
+		close(m_waiting[i]);
+	m_waitingCount = 0;
+	close(m_listen);
+	m_listen = -1;
+}
+
+void FakeTelegramServer::acceptLoop()
+{
+	while (m_running) {
+		struct pollfd pfd = {m_listen, POLLIN, 0};
+		if (poll(&pfd, 1, POLL_INTERVAL) <= 0)
+			continue;
+		int fd = accept(m_listen, nullptr, nullptr);
+		if (fd < 0)
+			continue;
+		int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_waitingCount < MAX_CONNECTIONS)
+			m_waiting[m_waitingCount++] = fd;
+		else
+			close(fd);
+		m_changed.notify_all();
+	}
+}
+
+void FakeTelegramServer::handlerLoop(Handler *handler)
+{
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_changed.wait(lock, [this]() { return !m_running || m_waitingCount > 0; });
+			if (!m_running)
+				return;
+			handler->fd = m_waiting[0];
+			m_waitingCount--;
+			memmove(m_waiting, m_waiting + 1, m_waitingCount * sizeof(int));
+		}
+		handler->start = handler->end = 0;
+		serve(*handler);
+		close(handler->fd);
+		handler->fd = -1;
+	}
+}
+
+void FakeTelegramServer::serve(Handler &handler)
+{
+	while (m_running && readRequest(handler)) {
+		Request &request = handler.request;
+		record(request);
+		uint32_t latency = m_latency;
+		if (latency > 0)
+			std::this_thread::sleep_for(std::chrono::milliseconds(latency));
+
+		bool ok;
+		int status;
+		if (strcmp(request.method, "GET") == 0)
+			ok = sendFile(handler);
+		else if (takeReply(request.method, status, handler.reply))
+			ok = reply(handler, status, handler.reply, strlen(handler.reply));
+		else if (strcmp(request.method, "getUpdates") == 0) {
+			long offset = 0, limit = 100, timeout = 0;
+			findNumber(request.body, "offset", offset);
+			findNumber(request.body, "limit", limit);
+			findNumber(request.body, "timeout", timeout);
+			size_t length = buildUpdates(handler, offset, limit, timeout);
+			ok = reply(handler, 200, handler.reply, length);
+		}
+		else if (strcmp(request.method, "getMe") == 0) {
+			const char *me = "{\"ok\":true,\"result\":{\"id\":1234567890,\"is_bot\":true,"
+			                 "\"first_name\":\"Host\",\"username\":\"host_bot\"}}";
+			ok = reply(handler, 200, me, strlen(me));
+		}
+		else if (strcmp(request.method, "getFile") == 0) {
+			char fileId[64] = "";
+			// file_id is sent in the query string by AsyncTelegram
+			if (!findString(request.body, "file_id", fileId, sizeof(fileId)))
+				findParameter(request.query, "file_id", fileId, sizeof(fileId));
+			size_t length = buildFile(handler, fileId);
+			ok = length > 0 ? reply(handler, 200, handler.reply, length)
+			                : reply(handler, 400, "{\"ok\":false,\"error_code\":400,\"description\":\"Bad Request: invalid file_id\"}", 79);
+		}
+		else {
+			uint32_t messageId;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				messageId = m_messageId++;
+			}
+			int length = snprintf(handler.reply, sizeof(handler.reply),
+			                      "{\"ok\":true,\"result\":{\"message_id\":%u,\"date\":%ld}}", messageId, (long) time(nullptr));
+			ok = reply(handler, 200, handler.reply, length);
+		}
+		if (!ok || !m_keepAlive)
+			break;
+	}
+}
+
+bool FakeTelegramServer::fill(Handler &handler)
+{
+	if (handler.start > 0) {
+		memmove(handler.buffer, handler.buffer + handler.start, handler.end - handler.start);
+		handler.end -= handler.start;
+		handler.start = 0;
+	}
+	if (handler.end == sizeof(handler.buffer))
+		return false;
+	while (m_running) {
+		struct pollfd pfd = {handler.fd, POLLIN, 0};
+		int res = poll(&pfd, 1, POLL_INTERVAL);
+		if (res == 0)
+			continue;
+		if (res < 0 && errno == EINTR)
+			continue;
+		if (res < 0)
+			return false;
+		ssize_t n = recv(handler.fd, handler.buffer + handler.end, sizeof(handler.buffer) - handler.end, 0);
+		if (n <= 0)
+			return false;
+		handler.end += n;
+		return true;
+	}
+	return false;
+}
+
+bool FakeTelegramServer::readLine(Handler &handler, char *line, size_t size)
+{
+	for (;;) {
+		char *begin = handler.buffer + handler.start;
+		char *newline = (char *) memchr(begin, '\n', handler.end - handler.start);
+		if (newline != nullptr) {
+			size_t n = newline - begin;
+			if (n > 0 && begin[n - 1] == '\r')
+				n--;
+			if (n >= size)
+				n = size - 1;
+			memcpy(line, begin, n);
+			line[n] = '\0';
+			handler.start = newline + 1 - handler.buffer;
+			return true;
+		}
+		if (!fill(handler))
+			return false;
+	}
+}
+
+bool FakeTelegramServer::readBody(Handler &handler, size_t length, bool chunked)
+{
+	Request &request = handler.request;
+	for (;;) {
+		size_t part = length;
+		if (chunked) {
+			char line[32];
+			if (!readLine(handler, line, sizeof(line)))
+				return false;
+			part = strtoul(line, nullptr, 16);
+		}
+		while (part > 0) {
+			if (handler.start == handler.end && !fill(handler))
+				return false;
+			size_t n = handler.end - handler.start;
+			if (n > part)
+				n = part;
+			// Only the first bytes of body are recorded
+			if (request.length < REQUEST_BODY - 1) {
+				size_t copy = n < REQUEST_BODY - 1 - request.length ? n : REQUEST_BODY - 1 - request.length;
+				memcpy(request.body + request.length, handler.buffer + handler.start, copy);
+				request.body[request.length + copy] = '\0';
+			}
+			request.length += n;
+			handler.start += n;
+			part -= n;
+		}
+		if (!chunked)
+			return true;
+		char line[32];
+		if (!readLine(handler, line, sizeof(line)))
+			return false;
+		if (length == 0)
+			break;
+		length = 0;
+	}
+	return true;
+}
+
+bool FakeTelegramServer::readRequest(Handler &handler)
+{
+	Request &request = handler.request;
+	memset(&request, 0, offsetof(Request, body));
+	request.body[0] = '\0';
+
+	char line[512];
+	do {
+		if (!readLine(handler, line, sizeof(line)))
+			return false;
+	} while (line[0] == '\0');
+
+	// Request line: VERB target HTTP/1.1, target with or without scheme and host
+	char *target = strchr(line, ' ');
+	if (target == nullptr)
+		return false;
+	*target++ = '\0';
+	char *end = strchr(target, ' ');
+	if (end != nullptr)
+		*end = '\0';
+	if (strncmp(target, "http", 4) == 0) {
+		char *slashes = strstr(target, "//");
+		target = slashes != nullptr ? strchr(slashes + 2, '/') : nullptr;
+		if (target == nullptr)
+			return false;
+	}
+	char *query = strchr(target, '?');
+	if (query != nullptr)
+		*query++ = '\0';
+	copyString(request.query, query != nullptr ? query : "", sizeof(request.query));
+	if (strncmp(target, "/file/bot", 9) == 0) {
+		copyString(request.method, "GET", sizeof(request.method));
+		const char *path = strchr(target + 9, '/');
+		copyString(request.path, path != nullptr ? path + 1 : "", sizeof(request.path));
+	}
+	else {
+		const char *method = strrchr(target, '/');
+		copyString(request.method, method != nullptr ? method + 1 : target, sizeof(request.method));
+	}
+
+	size_t length = 0;
+	bool chunked = false;
+	for (;;) {
+		if (!readLine(handler, line, sizeof(line)))
+			return false;
+		if (line[0] == '\0')
+			break;
+		if (strncasecmp(line, "Content-Length:", 15) == 0)
+			length = strtoul(line + 15, nullptr, 10);
+		else if (strncasecmp(line, "Transfer-Encoding:", 18) == 0 && strstr(line, "chunked") != nullptr)
+			chunked = true;
+		else if (strncasecmp(line, "Range:", 6) == 0) {
+			const char *bytes = strstr(line, "bytes=");
+			if (bytes != nullptr)
+				request.rangeStart = strtoul(bytes + 6, nullptr, 10);
+		}
+	}
+	return readBody(handler, length, chunked);
+}
+
+bool FakeTelegramServer::reply(Handler &handler, int status, const char *body, size_t length)
+{
+	const char *reason = status == 200 ? "OK" : (status == 206 ? "Partial Content" : (status == 429 ? "Too Many Requests" : "Error"));
+	char headers[256];
+	int n = snprintf(headers, sizeof(headers),
+	                 "HTTP/1.1 %d %s\r\nContent-Type: application/json\r\nContent-Length: %u\r\nConnection: %s\r\n\r\n",
+	                 status, reason, (unsigned) length, m_keepAlive ? "keep-alive" : "close");
+	struct iovec iov[2] = {{headers, (size_t) n}, {(void *) body, length}};
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 2;
+	size_t total = n + length;
+	while (total > 0) {
+		ssize_t sent = sendmsg(handler.fd, &msg, MSG_NOSIGNAL);
+		if (sent < 0 && errno == EINTR)
+			continue;
+		if (sent <= 0)
+			return false;
+		total -= sent;
+		// Skip what was sent
+		while (sent > 0 && msg.msg_iovlen > 0) {
+			if ((size_t) sent >= msg.msg_iov[0].iov_len) {
+				sent -= msg.msg_iov[0].iov_len;
+				msg.msg_iov++;
+				msg.msg_iovlen--;
+			}
+			else {
+				msg.msg_iov[0].iov_base = (char *) msg.msg_iov[0].iov_base + sent;
+				msg.msg_iov[0].iov_len -= sent;
+				sent = 0;
+			}
+		}
+	}
+	return true;
+}
+
+void FakeTelegramServer::record(const Request &request)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		Request &entry = m_requests[m_requestCount % MAX_REQUESTS];
+		entry = request;
+		entry.id = ++m_requestCount;
+		for (MethodCount &method : m_methods) {
+			if (method.method[0] == '\0')
+				copyString(method.method, request.method, sizeof(method.method));
+			if (strcmp(method.method, request.method) == 0) {
+				method.count++;
+				break;
+			}
+		}
+	}
+	m_changed.notify_all();
+}
+
+size_t FakeTelegramServer::buildUpdates(Handler &handler, int32_t offset, int limit, uint32_t timeout)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	// Updates with id lower than offset are confirmed
+	while (m_updateCount > 0 && m_updates[m_updateHead].id < offset) {
+		m_updateHead = (m_updateHead + 1) % MAX_UPDATES;
+		m_updateCount--;
+	}
+	if (m_updateCount == 0 && timeout > 0 && m_maxHold > 0) {
+		uint32_t hold = timeout * 1000 < m_maxHold ? timeout * 1000 : m_maxHold;
+		m_changed.wait_for(lock, std::chrono::milliseconds(hold), [this]() { return !m_running || m_updateCount > 0; });
+	}
+
+	size_t length = snprintf(handler.reply, sizeof(handler.reply), "{\"ok\":true,\"result\":[");
+	for (size_t i = 0; i < m_updateCount && (int) i < limit; i++) {
+		const Update &update = m_updates[(m_updateHead + i) % MAX_UPDATES];
+		if (length + update.length + 4 > sizeof(handler.reply))
+			break;
+		if (i > 0)
+			handler.reply[length++] = ',';
+		memcpy(handler.reply + length, update.json, update.length);
+		length += update.length;
+	}
+	length += snprintf(handler.reply + length, sizeof(handler.reply) - length, "]}");
+	return length;
+}
+
+size_t FakeTelegramServer::buildFile(Handler &handler, const char *fileId)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (size_t i = 0; i < m_fileCount; i++) {
+		const File &file = m_files[i];
+		if (strcmp(file.fileId, fileId) == 0)
+			return snprintf(handler.reply, sizeof(handler.reply),
+			                "{\"ok\":true,\"result\":{\"file_id\":\"%s\",\"file_unique_id\":\"%s\",\"file_size\":%u,\"file_path\":\"%s\"}}",
+			                file.fileId, file.fileId, (unsigned) file.size, file.path);
+	}
+	return 0;
+}
+
+bool FakeTelegramServer::sendFile(Handler &handler)
+{
+	const Request &request = handler.request;
+	const uint8_t *data = nullptr;
+	size_t size = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (size_t i = 0; i < m_fileCount; i++) {
+			if (strcmp(m_files[i].path, request.path) == 0) {
+				data = m_files[i].data;
+				size = m_files[i].size;
+			}
+		}
+	}
+	if (data == nullptr)
+		return reply(handler, 404, "{\"ok\":false,\"error_code\":404,\"description\":\"Not Found\"}", 55);
+	if (request.rangeStart >= size && size > 0)
+		return reply(handler, 416, "", 0);
+	return reply(handler, request.rangeStart > 0 ? 206 : 200, (const char *) data + request.rangeStart, size - request.rangeStart);
+}
+
+bool FakeTelegramServer::takeReply(const char *method, int &status, char *body)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (Reply &reply : m_replies) {
+		if (reply.used && strcmp(reply.method, method) == 0) {
+			status = reply.status;
+			copyString(body, reply.body, REPLY_SIZE);
+			reply.used = false;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+bool FakeTelegramServer::pushUpdate(const char *json)
+{
+	size_t length = strlen(json);
+	if (length < 2 || length > UPDATE_SIZE || json[0] != '{')
+		return false;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_updateCount == MAX_UPDATES)
+			return false;
+		Update &update = m_updates[(m_updateHead + m_updateCount) % MAX_UPDATES];
+		update.id = m_nextUpdateId++;
+		// {"update_id":N, + members of json
+		int n = snprintf(update.json, sizeof(update.json), "{\"update_id\":%d%s", update.id, json[1] == '}' ? "" : ",");
+		memcpy(update.json + n, json + 1, length - 1);
+		update.length = n + length - 1;
+		m_updateCount++;
+	}
+	m_changed.notify_all();
+	return true;
+}
+
+size_t FakeTelegramServer::pendingUpdates()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_updateCount;
+}
+
+bool FakeTelegramServer::pushReply(const char *method, int status, const char *body)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (Reply &reply : m_replies) {
+		if (!reply.used) {
+			reply.used = true;
+			copyString(reply.method, method, sizeof(reply.method));
+			reply.status = status;
+			copyString(reply.body, body, sizeof(reply.body));
+			return true;
+		}
+	}
+	return false;
+}
+
+bool FakeTelegramServer::addFile(const char *fileId, const char *path, const uint8_t *data, size_t size)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_fileCount == MAX_FILES)
+		return false;
+	File &file = m_files[m_fileCount++];
+	copyString(file.fileId, fileId, sizeof(file.fileId));
+	copyString(file.path, path, sizeof(file.path));
+	file.data = data;
+	file.size = size;
+	return true;
+}
+
+void FakeTelegramServer::setLongPoll(uint32_t maxHold)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_maxHold = maxHold;
+}
+
+void FakeTelegramServer::setLatency(uint32_t latency)
+{
+	m_latency = latency;
+}
+
+void FakeTelegramServer::setKeepAlive(bool keepAlive)
+{
+	m_keepAlive = keepAlive;
+}
+
+uint32_t FakeTelegramServer::requestCount()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_requestCount;
+}
+
+uint32_t FakeTelegramServer::requestCount(const char *method)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (const MethodCount &count : m_methods) {
+		if (strcmp(count.method, method) == 0)
+			return count.count;
+	}
+	return 0;
+}
+
+bool FakeTelegramServer::request(uint32_t id, Request &request)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (id == 0 || id > m_requestCount || m_requestCount - id >= MAX_REQUESTS)
+		return false;
+	request = m_requests[(id - 1) % MAX_REQUESTS];
+	return true;
+}
+
+bool FakeTelegramServer::lastRequest(const char *method, Request &request)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (uint32_t id = m_requestCount; id > 0 && m_requestCount - id < MAX_REQUESTS; id--) {
+		const Request &entry = m_requests[(id - 1) % MAX_REQUESTS];
+		if (strcmp(entry.method, method) == 0) {
+			request = entry;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool FakeTelegramServer::waitRequests(const char *method, uint32_t count, uint32_t timeout)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	return m_changed.wait_for(lock, std::chrono::milliseconds(timeout), [this, method, count]() {
+		if (method == nullptr)
+			return m_requestCount >= count;
+		for (const MethodCount &entry : m_methods) {
+			if (strcmp(entry.method, method) == 0)
+				return entry.count >= count;
+		}
+		return count == 0;
+	});
+}
+
+void FakeTelegramServer::clearRequests()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_requestCount = 0;
+	memset(m_methods, 0, sizeof(m_methods));
+}
@@ -0,0 +1,160 @@
+#ifndef FAKE_TELEGRAM_SERVER_H
+#define FAKE_TELEGRAM_SERVER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Bot API server on localhost, used by host tests and benchmarks (see HostNetwork::redirect()).
+// It accepts HTTP/1.1 requests as sent by the library (absolute or relative URL, LF or CRLF line
+// endings, Content-Length or chunked body, pipelined on a keep-alive connection).
+// After start() it doesn't allocate memory, so heap counters of the process measure only the bot.
+class FakeTelegramServer {
+public:
+	static const size_t MAX_CONNECTIONS = 8;        // connections served at the same time
+	static const size_t MAX_UPDATES = 64;           // updates not yet confirmed with offset
+	static const size_t UPDATE_SIZE = 2048;         // max length of an update
+	static const size_t MAX_REPLIES = 16;           // scripted replies
+	static const size_t REPLY_SIZE = 1024;
+	static const size_t MAX_REQUESTS = 256;         // requests recorded (oldest are dropped)
+	static const size_t REQUEST_BODY = 2048;        // bytes of body recorded for each request
+	static const size_t MAX_FILES = 4;
+
+	struct Request {
+		uint32_t    id;                 // number of request received since start (from 1)
+		char        method[32];         // i.e. "sendMessage", or "GET" for file downloads
+		char        path[128];          // requested file (downloads only)
+		char        query[96];          // query string of the URL, without '?'
+		uint32_t    rangeStart;         // first byte requested (downloads only)
+		size_t      length;             // whole body length
+		char        body[REQUEST_BODY]; // first bytes of body (null terminated)
+	};
+
+	FakeTelegramServer();
+	~FakeTelegramServer();
+
+	// listen on 127.0.0.1 (port = 0 for any free port)
+	bool start(uint16_t port = 0);
+	void stop();
+	inline uint16_t port() const { return m_port; }
+
+	// queue an update, given as JSON object without "update_id" (assigned here)
+	// returns false if queue is full or update too long
+	bool pushUpdate(const char *json);
+
+	// updates not yet confirmed by a getUpdates request with a greater offset
+	size_t pendingUpdates();
+
+	// the next request of method gets this reply instead of the default one
+	bool pushReply(const char *method, int status, const char *body);
+
+	// file served by getFile and downloads (data must stay valid)
+	bool addFile(const char *fileId, const char *path, const uint8_t *data, size_t size);
+
+	// hold getUpdates requests with a timeout until an update is queued, up to maxHold ms
+	// (0 = reply immediately, default)
+	void setLongPoll(uint32_t maxHold);
+
+	// delay of each reply (ms)
+	void setLatency(uint32_t latency);
+
+	// close connection after each reply
+	void setKeepAlive(bool keepAlive);
+
+	uint32_t requestCount();
+	uint32_t requestCount(const char *method);
+
+	// copy of a request still in the log (id from 1 to requestCount())
+	bool request(uint32_t id, Request &request);
+
+	// last request of method
+	bool lastRequest(const char *method, Request &request);
+
+	// wait until count requests of method (nullptr for any) have been received
+	bool waitRequests(const char *method, uint32_t count, uint32_t timeout);
+
+	// forget requests received and counters
+	void clearRequests();
+
+private:
+	struct Update {
+		int32_t     id;
+		size_t      length;
+		char        json[UPDATE_SIZE + 24];
+	};
+
+	struct Reply {
+		bool        used;
+		char        method[32];
+		int         status;
+		char        body[REPLY_SIZE];
+	};
+
+	struct File {
+		char            fileId[64];
+		char            path[128];
+		const uint8_t*  data;
+		size_t          size;
+	};
+
+	struct MethodCount {
+		char        method[32];
+		uint32_t    count;
+	};
+
+	// state of a connection handler
+	struct Handler {
+		int         fd;
+		size_t      start;
+		size_t      end;
+		char        buffer[16384];
+		char        reply[65536];
+		Request     request;
+	};
+
+	void acceptLoop();
+	void handlerLoop(Handler *handler);
+	void serve(Handler &handler);
+	bool readRequest(Handler &handler);
+	bool readLine(Handler &handler, char *line, size_t size);
+	bool readBody(Handler &handler, size_t length, bool chunked);
+	bool fill(Handler &handler);
+	bool reply(Handler &handler, int status, const char *body, size_t length);
+	void record(const Request &request);
+	size_t buildUpdates(Handler &handler, int32_t offset, int limit, uint32_t timeout);
+	size_t buildFile(Handler &handler, const char *fileId);
+	bool sendFile(Handler &handler);
+	bool takeReply(const char *method, int &status, char *body);
+
+	std::mutex              m_mutex;
+	std::condition_variable m_changed;
+	std::atomic<bool>       m_running{false};
+	int                     m_listen = -1;
+	uint16_t                m_port = 0;
+	std::thread             m_acceptThread;
+	std::thread             m_threads[MAX_CONNECTIONS];
+	Handler*                m_handlers = nullptr;
+	int                     m_waiting[MAX_CONNECTIONS];     // accepted connections not yet served
+	size_t                  m_waitingCount = 0;
+
+	Update                  m_updates[MAX_UPDATES];
+	size_t                  m_updateHead = 0;
+	size_t                  m_updateCount = 0;
+	int32_t                 m_nextUpdateId = 100000;
+	Reply                   m_replies[MAX_REPLIES];
+	File                    m_files[MAX_FILES];
+	size_t                  m_fileCount = 0;
+	Request                 m_requests[MAX_REQUESTS];
+	uint32_t                m_requestCount = 0;
+	MethodCount             m_methods[32];
+	uint32_t                m_messageId = 1;
+
+	uint32_t                m_maxHold = 0;
+	std::atomic<uint32_t>   m_latency{0};
+	std::atomic<bool>       m_keepAlive{true};
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Minimal test helpers of host programs: CHECK() prints failed conditions and finish()
+// ends the process with the result. Tasks started by the library are detached threads
+// still running at the end, so finish() exits without running static destructors.
+
+#if defined(ESP32)
+	#define ESP_FLAVOR  "esp32"
+#else
+	#define ESP_FLAVOR  "esp8266"
+#endif
+
+static int s_failures = 0;
+
+#define CHECK(cond) do { \
+		if (!(cond)) { \
+			printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+			s_failures++; \
+		} \
+	} while (0)
+
+#define CHECK_STR(actual, expected) do { \
+		const char *_a = (actual), *_e = (expected); \
+		if (strcmp(_a, _e) != 0) { \
+			printf("%s:%d: \"%s\" != \"%s\"\n", __FILE__, __LINE__, _a, _e); \
+			s_failures++; \
+		} \
+	} while (0)
+
+static inline int finish()
+{
+	printf(s_failures == 0 ? "OK\n" : "%d checks failed\n", s_failures);
+	fflush(stdout);
+	fflush(stderr);
+	_exit(s_failures == 0 ? 0 : 1);
+}
+
+// true if argument was passed on command line
+static inline bool hasArg(int argc, char **argv, const char *arg)
+{
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], arg) == 0)
+			return true;
+	}
+	return false;
+}
+
+#endif
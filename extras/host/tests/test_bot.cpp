@@ -0,0 +1,250 @@
+// End to end checks of AsyncTelegram against the fake Bot API server
+#include <AsyncTelegram.h>
+#include "HostHeap.h"
+#include "HostNetwork.h"
+#include "FakeTelegramServer.h"
+#include "HostTest.h"
+
+static FakeTelegramServer server;
+static AsyncTelegram bot;
+
+// Call getNewMessage() as loop() does, until a message arrives or timeout expires
+static MessageType waitMessage(TBMessage &msg, uint32_t timeout = 5000)
+{
+	uint32_t start = millis();
+	while (millis() - start < timeout) {
+		MessageType type = bot.getNewMessage(msg);
+		if (type != MessageNoData)
+			return type;
+#if defined(ESP8266)
+		run_scheduled_functions();
+#endif
+		delay(1);
+	}
+	return MessageNoData;
+}
+
+// Run loop until the server has received count requests of method
+static bool waitRequests(const char *method, uint32_t count, uint32_t timeout = 5000)
+{
+	uint32_t start = millis();
+	TBMessage msg;
+	while (millis() - start < timeout) {
+		if (server.requestCount(method) >= count)
+			return true;
+		bot.getNewMessage(msg);
+#if defined(ESP8266)
+		run_scheduled_functions();
+#endif
+		delay(1);
+	}
+	return false;
+}
+
+static void testText()
+{
+	server.pushUpdate("{\"message\":{\"message_id\":11,\"from\":{\"id\":42,\"is_bot\":false,\"first_name\":\"Ann\","
+	                  "\"username\":\"ann\",\"language_code\":\"it\"},\"chat\":{\"id\":42,\"type\":\"private\"},"
+	                  "\"date\":1700000000,\"text\":\"hello \\\"bot\\\"\"}}");
+	TBMessage msg;
+	CHECK(waitMessage(msg) == MessageText);
+	CHECK(msg.messageID == 11);
+	CHECK(msg.chatId == 42);
+	CHECK(msg.sender.id == 42);
+	CHECK_STR(msg.sender.firstName, "Ann");
+	CHECK_STR(msg.sender.languageCode, "it");
+	CHECK(msg.date == 1700000000);
+	CHECK(msg.text == "hello \"bot\"");
+
+	uint32_t sent = server.requestCount("sendMessage");
+	CHECK(bot.sendMessage(msg, "reply to \"Ann\""));
+	CHECK(waitRequests("sendMessage", sent + 1));
+	FakeTelegramServer::Request request;
+	CHECK(server.lastRequest("sendMessage", request));
+	CHECK(strstr(request.body, "\"chat_id\":42") != nullptr);
+	CHECK(strstr(request.body, "\"text\":\"reply to \\\"Ann\\\"\"") != nullptr);
+}
+
+static void testQuery()
+{
+	InlineKeyboard keyboard;
+	static int calls = 0;
+	keyboard.addButton("ON", "lightON", KeyboardButtonQuery, [](const TBMessage &) { calls++; });
+	keyboard.addButton("OFF", "lightOFF", KeyboardButtonQuery);
+	keyboard.addButton("Say \"hi\"\t\x01", "say", KeyboardButtonQuery);
+	TBMessage chat;
+	chat.chatId = 42;
+	chat.sender.id = 42;
+	uint32_t sent = server.requestCount("sendMessage");
+	CHECK(bot.sendMessage(chat, "Light", keyboard));
+	CHECK(waitRequests("sendMessage", sent + 1));
+	FakeTelegramServer::Request request;
+	CHECK(server.lastRequest("sendMessage", request));
+	CHECK(strstr(request.body, "\"reply_markup\":{\"inline_keyboard\":[[") != nullptr);
+	CHECK(strstr(request.body, "\"callback_data\":\"lightOFF\"") != nullptr);
+	CHECK(strstr(request.body, "{\"text\":\"Say \\\"hi\\\"\\t\\u0001\",\"callback_data\":\"say\"}") != nullptr);
+
+	server.pushUpdate("{\"callback_query\":{\"id\":\"987654\",\"from\":{\"id\":42,\"is_bot\":false,\"first_name\":\"Ann\"},"
+	                  "\"message\":{\"message_id\":12,\"chat\":{\"id\":42},\"date\":1700000001,\"text\":\"Light\"},"
+	                  "\"chat_instance\":\"-1234\",\"data\":\"lightON\"}}");
+	TBMessage msg;
+	CHECK(waitMessage(msg) == MessageQuery);
+	CHECK_STR(msg.callbackQueryID, "987654");
+	CHECK_STR(msg.callbackQueryData, "lightON");
+	CHECK(msg.messageID == 12);
+	CHECK(msg.chatId == 42);
+	CHECK(calls == 1);
+}
+
+static void testReplyFlags()
+{
+	// Flags of force_reply are merged in the keyboard, members already there are not repeated
+	ReplyKeyboard keyboard;
+	keyboard.addButton("Yes");
+	keyboard.enableSelective();
+	TBMessage chat;
+	chat.chatId = 42;
+	chat.sender.id = 42;
+	chat.force_reply = true;
+	uint32_t sent = server.requestCount("sendMessage");
+	CHECK(bot.sendMessage(chat, "Confirm", keyboard));
+	CHECK(waitRequests("sendMessage", sent + 1));
+	FakeTelegramServer::Request request;
+	CHECK(server.lastRequest("sendMessage", request));
+	const char *selective = strstr(request.body, "\"selective\":true");
+	CHECK(selective != nullptr && strstr(selective + 1, "\"selective\"") == nullptr);
+	CHECK(strstr(request.body, "\"force_reply\":true}}") != nullptr);
+}
+
+static void testLocation()
+{
+	server.pushUpdate("{\"message\":{\"message_id\":13,\"from\":{\"id\":42,\"first_name\":\"Ann\"},\"chat\":{\"id\":42},"
+	                  "\"date\":1700000002,\"location\":{\"longitude\":12.5,\"latitude\":41.875}}}");
+	TBMessage msg;
+	CHECK(waitMessage(msg) == MessageLocation);
+	CHECK(msg.location.longitude == 12.5f);
+	CHECK(msg.location.latitude == 41.875f);
+}
+
+static void testReuse()
+{
+	// Same TBMessage for all updates: fields of the previous one are not left over
+	TBMessage msg;
+	server.pushUpdate("{\"message\":{\"message_id\":14,\"from\":{\"id\":42,\"first_name\":\"Ann\"},\"chat\":{\"id\":42},"
+	                  "\"date\":1700000004,\"location\":{\"longitude\":12.5,\"latitude\":41.875}}}");
+	CHECK(waitMessage(msg) == MessageLocation);
+	server.pushUpdate("{\"message\":{\"message_id\":15,\"chat\":{\"id\":43},\"text\":\"no date\",\"caption\":\"ignored\"}}");
+	CHECK(waitMessage(msg) == MessageText);
+	CHECK(msg.messageID == 15);
+	CHECK(msg.chatId == 43);
+	CHECK(msg.date == 0);
+	CHECK(msg.sender.id == 0);
+	CHECK(msg.location.longitude == 0 && msg.location.latitude == 0);
+	CHECK(msg.text == "no date");
+
+	// Caption is the text of a document only
+	server.pushUpdate("{\"message\":{\"message_id\":16,\"chat\":{\"id\":42},\"caption\":\"New configuration\","
+	                  "\"document\":{\"file_name\":\"config.json\",\"file_id\":\"doc16\",\"file_size\":10}}}");
+	uint32_t getFiles = server.requestCount("getFile");
+	CHECK(waitMessage(msg) == MessageDocument);
+	CHECK_STR(msg.document.file_name, "config.json");
+	CHECK(msg.text == "New configuration");
+	// File path is requested only when needed
+	CHECK(msg.document.file_exists);
+	CHECK(msg.document.file_size == 10);
+	CHECK(msg.document.file_path[0] == '\0');
+	CHECK(server.requestCount("getFile") == getFiles);
+	CHECK(server.addFile("doc16", "documents/config.json", (const uint8_t *) "0123456789", 10));
+	CHECK(bot.getFile(msg.document));
+	CHECK(strstr(msg.document.file_path, "/documents/config.json") != nullptr);
+	server.pushUpdate("{\"callback_query\":{\"id\":\"987655\",\"from\":{\"id\":42},\"data\":\"lightOFF\"}}");
+	CHECK(waitMessage(msg) == MessageQuery);
+	CHECK(msg.messageID == 0);
+	CHECK(msg.chatId == 0);
+	CHECK(msg.document.file_name == nullptr);
+	CHECK(msg.text.length() == 0);
+}
+
+static void testBatch()
+{
+	// More updates than a batch: all are handed out in order
+	char update[160];
+	for (int i = 0; i < 12; i++) {
+		snprintf(update, sizeof(update), "{\"message\":{\"message_id\":%d,\"chat\":{\"id\":42},\"date\":1700000003,\"text\":\"n%d\"}}", 100 + i, i);
+		server.pushUpdate(update);
+	}
+	for (int i = 0; i < 12; i++) {
+		TBMessage msg;
+		CHECK(waitMessage(msg) == MessageText);
+		CHECK(msg.messageID == 100 + i);
+	}
+}
+
+static void testDualReset()
+{
+	// Connection is reset while getUpdates is held by the server on the dedicated connection
+	server.setLongPoll(200);
+	bot.setDualConnection(true);
+	CHECK(bot.reset());
+	uint32_t polls = server.requestCount("getUpdates");
+	CHECK(waitRequests("getUpdates", polls + 2));
+	CHECK(bot.reset());
+	server.pushUpdate("{\"message\":{\"message_id\":200,\"chat\":{\"id\":42},\"date\":1700000004,\"text\":\"dual\"}}");
+	TBMessage msg;
+	CHECK(waitMessage(msg) == MessageText);
+	CHECK(msg.messageID == 200);
+	server.setLongPoll(0);
+}
+
+#if defined(ESP32)
+static TelegramConnection connection;
+static AsyncTelegram shared[2];
+
+static void testShared()
+{
+	for (AsyncTelegram &b : shared) {
+		b.setTelegramToken("123456:HOST-TEST");
+		b.setInsecure(true);
+		b.setUpdateTime(50);
+		CHECK(b.setConnection(connection));
+	}
+	CHECK(shared[0].begin());
+	// Client, task and reply buffers are the ones of the connection
+	size_t heap = HostHeap::stats().current;
+	CHECK(shared[1].begin());
+	CHECK(HostHeap::stats().current - heap < BUFFER_SMALL);
+	CHECK(shared[1].userName == "host_bot");
+
+	uint32_t sent = server.requestCount("sendMessage");
+	TBMessage msg;
+	msg.chatId = 42;
+	CHECK(shared[0].sendMessage(msg, "first"));
+	CHECK(shared[1].sendMessage(msg, "second"));
+	CHECK(server.waitRequests("sendMessage", sent + 2, 5000));
+}
+#endif
+
+int main()
+{
+	Serial.setOutput(nullptr);
+	CHECK(server.start());
+	HostNetwork::redirect("127.0.0.1", server.port());
+
+	bot.setTelegramToken("123456:HOST-TEST");
+	bot.setInsecure(true);
+	bot.setUpdateTime(50);
+	CHECK(bot.begin());
+	CHECK(bot.userName == "host_bot");
+
+	testText();
+	testQuery();
+	testReplyFlags();
+	testLocation();
+	testReuse();
+	testBatch();
+	testDualReset();
+#if defined(ESP32)
+	testShared();
+#endif
+	return finish();
+}
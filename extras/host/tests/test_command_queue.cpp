@@ -0,0 +1,134 @@
+// Stress test of CommandQueue: loop task (producer) and http task (consumer) on two threads.
+// Built also as test_command_queue_tsan with ThreadSanitizer (see CMakeLists.txt).
+// Usage: test_command_queue [commands]
+#include <Arduino.h>
+#include <CommandQueue.h>
+#include <atomic>
+#include <thread>
+#include "HostTest.h"
+
+static const char *METHODS[] = {"sendMessage", "sendChatAction", "editMessageReplyMarkup", "answerCallbackQuery"};
+
+// Commands are numbered: method is chosen by number, param holds the number
+static void makeCommand(uint32_t n, const char *&method, char *param, size_t size)
+{
+	method = METHODS[n % 4];
+	// Long params too, so slot buffers are reallocated while the consumer copies them
+	snprintf(param, size, "{\"n\":%u,\"pad\":\"%.*s\"}", n, (int) (n % 97),
+	         "................................................................................................");
+}
+
+struct Consumer {
+	CommandQueue &queue;
+	std::atomic<bool> &done;
+	uint32_t popped = 0;
+	int64_t last = -1;
+	uint32_t errors = 0;
+
+	void run()
+	{
+		String command((char *) 0);
+		String param((char *) 0);
+		for (;;) {
+			bool finished = done.load(std::memory_order_acquire);
+			if (!queue.pop(command, param)) {
+				if (finished)
+					break;
+				std::this_thread::yield();
+				continue;
+			}
+			uint32_t n = strtoul(param.c_str() + 5, nullptr, 10);
+			const char *method;
+			char expected[160];
+			makeCommand(n, method, expected, sizeof(expected));
+			// Commands are taken in the same order, each one once and unchanged
+			if ((int64_t) n <= last || command != method || param != expected)
+				errors++;
+			last = n;
+			popped++;
+		}
+	}
+};
+
+// Producer retries rejected commands: all commands are delivered in order
+static void testReject(uint32_t count)
+{
+	CommandQueue queue;
+	std::atomic<bool> done{false};
+	Consumer consumer{queue, done};
+	std::thread thread(&Consumer::run, &consumer);
+
+	char param[160];
+	const char *method;
+	uint32_t rejected = 0;
+	for (uint32_t n = 0; n < count; n++) {
+		makeCommand(n, method, param, sizeof(param));
+		while (!queue.push(method, param)) {
+			rejected++;
+			std::this_thread::yield();
+		}
+	}
+	// Position of the last command is reached by the consumer
+	uint32_t tail = queue.tail();
+	while (!queue.taken(tail))
+		std::this_thread::yield();
+	done.store(true, std::memory_order_release);
+	thread.join();
+
+	QueueStats stats = queue.getStats();
+	printf("reject:      pushed %u popped %u rejected %u high water %u\n", stats.pushed, stats.popped, stats.rejected, stats.highWater);
+	CHECK(consumer.errors == 0);
+	CHECK(consumer.popped == count);
+	CHECK(stats.pushed == count);
+	CHECK(stats.popped == count);
+	CHECK(stats.rejected == rejected);
+	CHECK(stats.highWater <= COMMAND_QUEUE_SIZE);
+	CHECK(queue.size() == 0);
+}
+
+// Producer never waits: oldest commands are dropped while the consumer is taking them
+static void testDropOldest(uint32_t count)
+{
+	CommandQueue queue;
+	std::atomic<bool> done{false};
+	Consumer consumer{queue, done};
+	std::thread thread(&Consumer::run, &consumer);
+
+	char param[160];
+	const char *method;
+	uint32_t dropped = 0, wrongNames = 0;
+	String droppedMethod;
+	for (uint32_t n = 0; n < count; n++) {
+		makeCommand(n, method, param, sizeof(param));
+		droppedMethod = "";
+		CHECK(queue.push(method, param, true, &droppedMethod));
+		if (droppedMethod.length() > 0) {
+			dropped++;
+			bool known = false;
+			for (const char *m : METHODS)
+				known |= droppedMethod == m;
+			if (!known)
+				wrongNames++;
+		}
+	}
+	done.store(true, std::memory_order_release);
+	thread.join();
+
+	QueueStats stats = queue.getStats();
+	printf("drop oldest: pushed %u popped %u dropped %u high water %u\n", stats.pushed, stats.popped, stats.dropped, stats.highWater);
+	CHECK(consumer.errors == 0);
+	CHECK(wrongNames == 0);
+	CHECK(stats.pushed == count);
+	CHECK(stats.dropped == dropped);
+	CHECK(stats.popped == consumer.popped);
+	CHECK(stats.popped + stats.dropped == count);
+	CHECK(stats.rejected == 0);
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t count = argc > 1 ? strtoul(argv[1], nullptr, 10) : 200000;
+	testReject(count);
+	testDropOldest(count);
+	return finish();
+}
@@ -0,0 +1,63 @@
+// Checks of RateLimiter: chat buckets still in use are never reused, long waits are kept
+#include <Arduino.h>
+#include <RateLimiter.h>
+#include "HostTest.h"
+
+static void sendTo(RateLimiter &limiter, int64_t chatId)
+{
+	String command, param;
+	char json[32];
+	snprintf(json, sizeof(json), "{\"chat_id\":%lld}", (long long) chatId);
+	CHECK(limiter.push("sendMessage", json, chatId));
+	// Wait for the global token only
+	uint32_t start = millis();
+	while (!limiter.pop(command, param, false) && millis() - start < 1000)
+		delay(1);
+	CHECK(param == json);
+}
+
+static void testBusyBuckets()
+{
+	RateLimiter limiter;
+	// All buckets are taken by chats that can't receive another message for a second
+	for (int64_t chat = 1; chat <= RATE_CHAT_SLOTS; chat++)
+		sendTo(limiter, chat);
+
+	// A new chat waits for a free bucket, instead of resetting the limit of another chat
+	String command, param;
+	CHECK(limiter.push("sendMessage", "{\"chat_id\":100}", 100));
+	delay(RATE_GLOBAL_INTERVAL * 2);
+	CHECK(!limiter.pop(command, param, false));
+	CHECK(limiter.push("sendMessage", "{\"chat_id\":1}", 1));
+	CHECK(!limiter.pop(command, param, false));
+
+	// Buckets are free again after the chat interval, messages keep their order
+	delay(RATE_CHAT_INTERVAL + 10);
+	CHECK(limiter.pop(command, param, false));
+	CHECK(param == "{\"chat_id\":100}");
+	delay(RATE_GLOBAL_INTERVAL + 1);
+	CHECK(limiter.pop(command, param, false));
+	CHECK(param == "{\"chat_id\":1}");
+}
+
+static void testLongWait()
+{
+	RateLimiter limiter;
+	String command, param;
+	// Server asks to wait more than the longest time stored: the chat waits as long as possible
+	limiter.retryAfter(42, 7200);
+	CHECK(limiter.push("sendMessage", "{\"chat_id\":42}", 42));
+	CHECK(!limiter.pop(command, param, false));
+
+	// The same for all chats, also without a free bucket for the chat
+	limiter.retryAfter(0, 100000);
+	CHECK(limiter.push("sendMessage", "{\"chat_id\":43}", 43));
+	CHECK(!limiter.pop(command, param, false));
+}
+
+int main()
+{
+	testBusyBuckets();
+	testLongWait();
+	return finish();
+}
@@ -0,0 +1,67 @@
+// Checks of CommandRouter and of command arguments (views of the message text)
+#include <Arduino.h>
+#include <CommandRouter.h>
+#include "HostTest.h"
+
+static TBMessage textMessage(const char *text)
+{
+	TBMessage msg;
+	msg.messageType = MessageText;
+	msg.text = text;
+	return msg;
+}
+
+static void testArgs()
+{
+	CommandRouter router;
+	int calls = 0;
+	CommandArgs last;
+	String first, second;
+	CHECK(router.add("/light", [&](const TBMessage &, const CommandArgs &args) {
+		calls++;
+		last = args;
+		first = args[0].toString();
+		second = args[1].toString();
+	}));
+
+	CHECK(router.route(textMessage("/light on off"), "host_bot"));
+	CHECK(calls == 1);
+	CHECK(last.count() == 2);
+	// Arguments are compared and copied by length, not up to the end of the text
+	CHECK(last[0] == "on");
+	CHECK(last[0].length() == 2);
+	CHECK(last[0] != "on off");
+	CHECK(first == "on");
+	CHECK(second == "off");
+	CHECK(last[1] == "off");
+	CHECK(last[2].length() == 0);
+	CHECK(last.rest() == "on off");
+
+	CHECK(router.route(textMessage("/LIGHT@host_bot  kitchen"), "host_bot"));
+	CHECK(calls == 2);
+	CHECK(last.count() == 1);
+	CHECK(first == "kitchen");
+
+	// Other bots and unknown commands
+	CHECK(!router.route(textMessage("/light@other_bot on"), "host_bot"));
+	CHECK(!router.route(textMessage("/lights on"), "host_bot"));
+	CHECK(!router.route(textMessage("light on"), "host_bot"));
+	CHECK(calls == 2);
+}
+
+static void testToString()
+{
+	const char *text = "abcdef";
+	TBString view(text + 1, 3);
+	CHECK(view.toString() == "bcd");
+	CHECK(view.toString().length() == 3);
+	CHECK(view == "bcd");
+	CHECK(TBString().toString().length() == 0);
+}
+
+int main()
+{
+	testArgs();
+	testToString();
+	return finish();
+}
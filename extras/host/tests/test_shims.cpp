@@ -0,0 +1,241 @@
+// Checks of host shims and fake server, without the library
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <WiFiClientSecure.h>
+#include <FS.h>
+#include "HostHeap.h"
+#include "HostNetwork.h"
+#include "FakeTelegramServer.h"
+#include "HostTest.h"
+#if defined(ESP8266)
+	#include <Ticker.h>
+#endif
+
+static FakeTelegramServer server;
+
+static void testString()
+{
+	String s("abc");
+	s += "defghijklmnop";
+	s += 42;
+	CHECK_STR(s.c_str(), "abcdefghijklmnop42");
+	CHECK(s.length() == 18);
+	CHECK(s.indexOf("klm") == 10);
+	CHECK(s.substring(3, 6) == "def");
+	String t = String("x=") + 5 + ',' + "y";
+	CHECK(t == "x=5,y");
+	s.replace("def", "D");
+	CHECK_STR(s.c_str(), "abcDghijklmnop42");
+	String n((const char *) nullptr);
+	CHECK(n.length() == 0 && n.c_str() != nullptr);
+	String trimmed("  padded \r\n");
+	trimmed.trim();
+	CHECK(trimmed == "padded");
+	CHECK(String("-123").toInt() == -123);
+}
+
+static void testHttp()
+{
+	server.clearRequests();
+	WiFiClientSecure client;
+	client.setInsecure();
+	HTTPClient https;
+	CHECK(https.begin(client, "https://api.telegram.org/bot123:ABC/getMe"));
+	CHECK(https.POST("") == 200);
+	String reply = https.getString();
+	CHECK(reply.indexOf("\"username\":\"host_bot\"") > 0);
+	https.end();
+	CHECK(client.connected());
+
+	// Same connection is reused for next request
+	uint32_t connections = HostNetwork::stats().connections;
+	https.begin(client, "https://api.telegram.org/bot123:ABC/sendMessage");
+	https.addHeader("Content-Type", "application/json");
+	CHECK(https.POST("{\"chat_id\":1,\"text\":\"hello\"}") == 200);
+	CHECK(https.getString().indexOf("\"message_id\":") > 0);
+	https.end();
+	CHECK(HostNetwork::stats().connections == connections);
+
+	FakeTelegramServer::Request request;
+	CHECK(server.lastRequest("sendMessage", request));
+	CHECK_STR(request.body, "{\"chat_id\":1,\"text\":\"hello\"}");
+	CHECK(server.requestCount() == 2);
+
+	// Updates are confirmed with offset
+	server.pushUpdate("{\"message\":{\"text\":\"one\"}}");
+	server.pushUpdate("{\"message\":{\"text\":\"two\"}}");
+	https.begin(client, "https://api.telegram.org/bot123:ABC/getUpdates");
+	CHECK(https.POST("{\"limit\":1,\"timeout\":0,\"offset\":0}") == 200);
+	reply = https.getString();
+	CHECK(reply.indexOf("\"update_id\":100000,\"message\"") > 0);
+	CHECK(reply.indexOf("two") < 0);
+	https.end();
+	https.begin(client, "https://api.telegram.org/bot123:ABC/getUpdates");
+	CHECK(https.POST("{\"limit\":8,\"timeout\":0,\"offset\":100001}") == 200);
+	reply = https.getString();
+	CHECK(reply.indexOf("\"update_id\":100001") > 0);
+	CHECK(server.pendingUpdates() == 1);
+	https.end();
+
+	// Scripted error replies
+	server.pushReply("sendMessage", 429, "{\"ok\":false,\"error_code\":429,\"parameters\":{\"retry_after\":3}}");
+	https.begin(client, "https://api.telegram.org/bot123:ABC/sendMessage");
+	CHECK(https.POST("{}") == 429);
+	CHECK(https.getString().indexOf("retry_after") > 0);
+	https.end();
+
+	// Dropped connections are reported by connected()
+	HostNetwork::dropConnections();
+	CHECK(!client.connected());
+	client.stop();
+}
+
+static void testRawClient()
+{
+	// Pipelined requests with LF line endings, as written on ESP8266
+	WiFiClientSecure client;
+	CHECK(client.connect("api.telegram.org", 443));
+	const char *body = "{\"chat_id\":1}";
+	char request[256];
+	int n = snprintf(request, sizeof(request),
+	                 "POST https://api.telegram.org/bot123:ABC/sendChatAction HTTP/1.1\nHost: api.telegram.org\n"
+	                 "Content-Type: application/json\nContent-Length: %d\n\n%s", (int) strlen(body), body);
+	client.write((const uint8_t *) request, n);
+	client.write((const uint8_t *) request, n);
+	CHECK(server.waitRequests("sendChatAction", 2, 2000));
+
+	static const uint8_t data[] = "0123456789";
+	server.addFile("FILE1", "documents/file_1.txt", data, 10);
+	n = snprintf(request, sizeof(request),
+	             "GET /file/bot123:ABC/documents/file_1.txt HTTP/1.1\r\nHost: api.telegram.org\r\nRange: bytes=4-\r\n\r\n");
+	client.write((const uint8_t *) request, n);
+	client.setTimeout(500);
+	String reply = client.readString();
+	CHECK(reply.indexOf("HTTP/1.1 200") == 0);
+	CHECK(reply.indexOf("HTTP/1.1 206") > 0);
+	CHECK(reply.endsWith("456789"));
+	client.stop();
+}
+
+static void testFS()
+{
+	fs::FS fs("/tmp");
+	fs::File file = fs.open("/asynctelegram_host_test.txt", "w");
+	CHECK(file);
+	file.print("file content");
+	file.close();
+	file = fs.open("/asynctelegram_host_test.txt", "r");
+	CHECK(file.size() == 12);
+	char buf[16] = {0};
+	CHECK(file.readBytes(buf, sizeof(buf)) == 12);
+	CHECK_STR(buf, "file content");
+	file.close();
+	CHECK(fs.remove("/asynctelegram_host_test.txt"));
+	CHECK(!fs.exists("/asynctelegram_host_test.txt"));
+}
+
+static void testHeap()
+{
+	if (!HostHeap::enabled())
+		return;
+	HostHeap::Stats before = HostHeap::stats();
+	char *p = (char *) malloc(1000);
+	p[0] = 1;
+	HostHeap::Stats during = HostHeap::stats();
+	CHECK(during.current >= before.current + 1000);
+	CHECK(during.allocations == before.allocations + 1);
+	free(p);
+	CHECK(HostHeap::stats().current == before.current);
+	CHECK(ESP.getFreeHeap() == HostHeap::SIZE - before.current);
+	uint64_t threadAllocations = HostHeap::threadAllocations();
+	String s("a string longer than the object buffer");
+	CHECK(HostHeap::threadAllocations() == threadAllocations + 1);
+}
+
+#if defined(ESP32)
+struct TaskTest {
+	SemaphoreHandle_t   mutex;
+	QueueHandle_t       queue;
+	TaskHandle_t        caller;
+	int                 counter;
+};
+
+static void testTask(void *args)
+{
+	TaskTest *test = (TaskTest *) args;
+	for (int i = 0; i < 1000; i++) {
+		xSemaphoreTakeRecursive(test->mutex, portMAX_DELAY);
+		test->counter++;
+		xSemaphoreGiveRecursive(test->mutex);
+	}
+	int value = 42;
+	xQueueSend(test->queue, &value, portMAX_DELAY);
+	xTaskNotifyGive(test->caller);
+	vTaskDelete(NULL);
+}
+
+static void testFreeRTOS()
+{
+	TaskTest test;
+	test.mutex = xSemaphoreCreateRecursiveMutex();
+	test.queue = xQueueCreate(2, sizeof(int));
+	test.caller = xTaskGetCurrentTaskHandle();
+	test.counter = 0;
+	TaskHandle_t handle = nullptr;
+	CHECK(xTaskCreate(testTask, "test", 4096, &test, 1, &handle) == pdPASS);
+	CHECK(handle != nullptr);
+	for (int i = 0; i < 1000; i++) {
+		xSemaphoreTakeRecursive(test.mutex, portMAX_DELAY);
+		xSemaphoreTakeRecursive(test.mutex, portMAX_DELAY);
+		test.counter++;
+		xSemaphoreGiveRecursive(test.mutex);
+		xSemaphoreGiveRecursive(test.mutex);
+	}
+	CHECK(ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(2000)) == 1);
+	int value = 0;
+	CHECK(xQueueReceive(test.queue, &value, pdMS_TO_TICKS(100)) == pdTRUE);
+	CHECK(value == 42);
+	CHECK(xQueueReceive(test.queue, &value, 0) == pdFALSE);
+	CHECK(test.counter == 2000);
+	CHECK(ulTaskNotifyTake(pdTRUE, 0) == 0);
+}
+#endif
+
+#if defined(ESP8266)
+static void testTicker()
+{
+	Ticker ticker;
+	int calls = 0;
+	ticker.attach_ms_scheduled(10, [&calls]() { calls++; });
+	uint32_t start = millis();
+	while (millis() - start < 55) {
+		run_scheduled_functions();
+		delay(1);
+	}
+	ticker.detach();
+	CHECK(calls >= 4 && calls <= 6);
+	delay(20);
+	run_scheduled_functions();
+	CHECK(!ticker.active());
+	CHECK(calls <= 6);
+}
+#endif
+
+int main()
+{
+	CHECK(server.start());
+	HostNetwork::redirect("127.0.0.1", server.port());
+
+	testString();
+	testHttp();
+	testRawClient();
+	testFS();
+	testHeap();
+#if defined(ESP32)
+	testFreeRTOS();
+#endif
+#if defined(ESP8266)
+	testTicker();
+#endif
+	return finish();
+}
@@ -12,16 +12,23 @@
 #define errorJson(E)
 #endif
 
+#if defined(ESP32)
+// Methods that change the state of the bot are called from loop task and from event task
+#define LOCK_BOT()  ConnectionLock botLock(m_botMutex)
+#else
+// Event handlers run after loop() with ESP8266
+#define LOCK_BOT()
+#endif
+
 // get fingerprints from https://www.grc.com/fingerprints.htm
 uint8_t default_fingerprint[20] = { 0xF2, 0xAD, 0x29, 0x9C, 0x34, 0x48, 0xDD, 0x8D, 0xF4, 0xCF, 0x52, 0x32, 0xF6, 0x57, 0x33, 0x68, 0x2E, 0x81, 0xC1, 0x90 };
 
-AsyncTelegram::AsyncTelegram() {
+AsyncTelegram::AsyncTelegram() : m_updatesDoc(0) {
     telegramServerIP.fromString(TELEGRAM_IP);
-    httpData.payload.reserve(BUFFER_BIG);
-    httpData.param.reserve(512);
-    httpData.command.reserve(32);
     m_minUpdateTime = MIN_UPDATE_TIME;
-#if defined(ESP8266)
+#if defined(ESP32)
+    m_botMutex = xSemaphoreCreateRecursiveMutex();
+#elif defined(ESP8266)
     m_session = new BearSSL::Session;
     m_cert = new BearSSL::X509List(digicert);
 #endif
@@ -50,334 +57,1266 @@ void AsyncTelegram::setClock(const char* TZ,  uint32_t maxTime)
 
 
 bool AsyncTelegram::begin(){
+    LOCK_BOT();
 
   // Check NTP time, set default if not (Rome, Italy)
   time_t now = time(nullptr);
   if (now < 8 * 3600 * 2) 
     setClock("CET-1CEST,M3.5.0,M10.5.0/3");  
 
-    telegramClient = new WiFiClientSecure;
-    telegramClient->setTimeout(SERVER_TIMEOUT);
+#if defined(ESP32)
+    // Replies are decoded on the same core of http tasks, loop task only takes the records
+    if (m_pipelined && m_parseTask == nullptr) {
+        m_parseRecord = new UpdateRecord;
+        m_record = new UpdateRecord;
+        m_updateQueue = xQueueCreate(PARSE_QUEUE_SIZE, sizeof(UpdateRecord));
+        xTaskCreatePinnedToCore(this->parseTask, "parseTask", 6500, this, 9, &m_parseTask, 0);
+    }
+
+    if (m_connection != nullptr) {
+        // Client, http task and the buffers used to read replies are shared with other bots
+        telegramClient = m_connection->begin(this);
+        m_httpParser = &m_connection->m_parser;
+        m_replyDoc = &m_connection->m_replyDoc;
+        m_dualConnection = false;
+        TBUser user;
+        bool ok = getMe(user);
+        m_ready = true;
+        return ok;
+    }
+#endif
+
+    // Buffers to read replies from own client (shared bots use the ones of the connection)
+    if (m_httpParser == nullptr) {
+        m_httpParser = new HttpResponseParser;
+        m_replyDoc = new DynamicJsonDocument(BUFFER_SMALL);
+    }
+
+    // Clients survive reset(): TLS options (and with ESP8266 the session to be resumed) are kept
+    uint32_t freeHeap = ESP.getFreeHeap();
+    bool created = (telegramClient == nullptr);
+    if (created)
+        telegramClient = newClient();
+#if defined(ESP32)
+    if (m_clientMutex == nullptr)
+        m_clientMutex = xSemaphoreCreateRecursiveMutex();
+    //Start Task with input parameter set to "this" class
+    if (taskHandler == nullptr) {
+        xTaskCreatePinnedToCore(
+            this->httpPostTask,     //Function to implement the task
+            "httpPostTask",         //Name of the task
+            6500,                   //Stack size in words
+            &m_sendTaskArgs,        //Task input parameter
+            10,                     //Priority of the task
+            &taskHandler,           //Task handle.
+            0                       //Core where the task should run
+        );
+    }
+    {
+        // http task can be already running (reset)
+        ConnectionLock lock(m_clientMutex);
+        checkConnection();
+    }
+#else
+    checkConnection();
+#endif
+    if (created)
+        m_connectionHeap[0] = freeHeap - ESP.getFreeHeap();
+
+    if (m_dualConnection) {
+        freeHeap = ESP.getFreeHeap();
+        created = (pollClient == nullptr);
+        if (created)
+            pollClient = newClient();
+#if defined(ESP32)
+        // Once poll task is running, only that task uses pollClient (and connects it again)
+        if (pollTaskHandler == nullptr) {
+            if (m_pollQueue == nullptr)
+                m_pollQueue = new CommandQueue;
+            checkConnection(true);
+            xTaskCreatePinnedToCore(this->httpPostTask, "httpPollTask", 6500, &m_pollTaskArgs, 10, &pollTaskHandler, 0);
+        }
+#else
+        checkConnection(true);
+#endif
+        if (created)
+            m_connectionHeap[1] = freeHeap - ESP.getFreeHeap();
+        log_debug("Heap used by connections: send %u, poll %u\n", m_connectionHeap[0], m_connectionHeap[1]);
+    }
+
+    TBUser user;
+    bool ok = getMe(user);
+    // Event driver can run only after clients have been created
+    m_ready = true;
+    return ok;
+}
+
+
+WiFiClientSecure* AsyncTelegram::newClient()
+{
+    WiFiClientSecure *client = new WiFiClientSecure;
+    client->setTimeout(SERVER_TIMEOUT);
 #if defined(ESP8266)
   #if USE_FINGERPRINT
     setFingerprint(default_fingerprint);
-    telegramClient->setFingerprint(m_fingerprint);
+    client->setFingerprint(m_fingerprint);
   #else
-    telegramClient->setBufferSizes(TCP_MSS, TCP_MSS);
-    telegramClient->setSession(m_session);
+    client->setBufferSizes(TCP_MSS, TCP_MSS);
+    client->setSession(m_session);
     if(m_insecure)
-        telegramClient->setInsecure();
+        client->setInsecure();
     else
-        telegramClient->setTrustAnchors(m_cert);
+        client->setTrustAnchors(m_cert);
   #endif
 
 #elif defined(ESP32)
     if(m_insecure)
-        telegramClient->setInsecure();
+        client->setInsecure();
     else
-        telegramClient->setCACert(digicert);
-    //Start Task with input parameter set to "this" class
-    xTaskCreatePinnedToCore(
-        this->httpPostTask,     //Function to implement the task
-        "httpPostTask",         //Name of the task
-        6500,                   //Stack size in words
-        this,                   //Task input parameter
-        10,                     //Priority of the task
-        &taskHandler,           //Task handle.
-        0                       //Core where the task should run
-    );
+        client->setCACert(digicert);
 #endif
+    return client;
+}
 
-    checkConnection();
-    return getMe(m_user);
+
+void AsyncTelegram::setDualConnection(bool enable)
+{
+    m_dualConnection = enable;
 }
 
 
 bool AsyncTelegram::reset(void){
+    LOCK_BOT();
     if(WiFi.status() != WL_CONNECTED ){
         Serial.println("No connection available.");
 		httpData.timestamp = millis();
         WiFi.reconnect();
     }
     log_debug("Reset connection\n");
+#if defined(ESP32)
+    {
+        // Reply parser can be the one of the shared connection
+        ConnectionLock lock(clientMutex());
+        // Shared connection is kept for the other bots (it is opened again when needed)
+        if (m_connection == nullptr)
+            telegramClient->stop();
+        clearReplies();
+    }
+    // Poll task can be waiting a long poll reply: it will close its connection before next request
+    if (pollClient != nullptr)
+        m_pollReconnect = true;
+#else
     telegramClient->stop();
+    if (pollClient != nullptr)
+        pollClient->stop();
+    clearReplies();
+    m_pollParser.reset();
+#endif
+
+    httpData.waitingReply = false;
+    httpData.payload.clear();
+    httpData.replyReady = false;
+    httpData.timestamp = millis();
+    return begin();
+}
+
+
+bool AsyncTelegram::sendCommand(const char* const&  command, const char* const& param)
+{
+    LOCK_BOT();
+    // Bot sending messages is an active chat too (PollAdaptive)
+    if (strcmp(command, "getUpdates") != 0)
+        m_lastActivity = millis();
+    int64_t chatId = (m_rateLimit || m_coalescer.window() > 0) ? RateLimiter::chatId(param) : 0;
+    // Text merged for the same chat has to be sent before
+    flushCoalesced(chatId);
+
+    if (!m_rateLimit || chatId == 0)
+        return dispatchCommand(command, param);
+
+    if (!m_rateLimiter.push(command, param, chatId)) {
+        log_error("Rate limiter queue full, %s discarded\n", command);
+        return false;
+    }
+    sendScheduled();
+    return true;
+}
+
+
+bool AsyncTelegram::sendCommand(const char* command, int64_t chatId, const RequestBody &body)
+{
+    LOCK_BOT();
+#if defined(ESP8266)
+    // Not rate limited: body is written straight to the socket, after the text merged for the same chat
+    if (!m_rateLimit || chatId == 0) {
+        m_lastActivity = millis();
+        flushCoalesced(chatId);
+        return postRequest(command, body);
+    }
+#endif
+    // Message has to be stored (queue, rate limiter): only one allocation of the exact size
+    size_t length;
+    {
+        RequestWriter sizing;
+        body(sizing);
+        length = sizing.length();
+    }
+    String param((char *)0);
+    if (!param.reserve(length)) {
+        log_error("Not enough memory for %s (%u bytes)\n", command, length);
+        return false;
+    }
+    {
+        RequestWriter json(param);
+        body(json);
+    }
+    return sendCommand(command, param.c_str());
+}
+
+
+bool AsyncTelegram::coalesceMessage(int64_t chatId, const char* text, ParseMode parseMode, bool silent)
+{
+    bool ok = true;
+    size_t len = strlen(text);
+    CoalescedMessage *message = m_coalescer.find(chatId);
+    if (message != nullptr && (message->parseMode != parseMode || message->silent != silent
+                               || message->text.length() + 1 + len > MAX_MESSAGE_LENGTH))
+        ok = sendCoalesced(message);
+
+    while (len > 0) {
+        message = m_coalescer.find(chatId);
+        if (message == nullptr) {
+            // All buffers in use: send the oldest one
+            message = m_coalescer.add(chatId, parseMode, silent);
+            if (message == nullptr) {
+                ok = sendCoalesced(m_coalescer.oldest()) && ok;
+                message = m_coalescer.add(chatId, parseMode, silent);
+            }
+        }
+        // Text longer than max length is split in more messages, outside of formatting entities
+        bool first = message->text.length() == 0;
+        size_t count = MessageCoalescer::cut(text, len, MAX_MESSAGE_LENGTH - message->text.length() - (first ? 0 : 1), parseMode);
+        if (count == 0 && !first) {
+            ok = sendCoalesced(message) && ok;
+            continue;
+        }
+        // An entity longer than a message can't be kept whole
+        if (count == 0)
+            count = MessageCoalescer::cut(text, len, MAX_MESSAGE_LENGTH);
+        if (!first)
+            message->text += '\n';
+        message->text.reserve(message->text.length() + count);
+        for (size_t i = 0; i < count; i++)
+            message->text += text[i];
+        text += count;
+        len -= count;
+        if (len > 0)
+            ok = sendCoalesced(message) && ok;
+    }
+    return ok;
+}
+
+
+bool AsyncTelegram::sendCoalesced(CoalescedMessage *message)
+{
+    // Release buffer first, so sendCommand() will not flush it again
+    message->used = false;
+
+    const char* parseMode = message->parseMode == ParseMarkdownV2 ? "MarkdownV2" : (message->parseMode == ParseHTML ? "HTML" : nullptr);
+    return sendCommand("sendMessage", message->chatId, [&](RequestWriter &json) {
+        json.beginObject();
+        json.addNumber("chat_id", message->chatId);
+        json.addString("text", message->text.c_str());
+        if (parseMode != nullptr)
+            json.addString("parse_mode", parseMode);
+        if (message->silent)
+            json.addBool("disable_notification", true);
+        json.endObject();
+    });
+}
+
+
+bool AsyncTelegram::flushCoalesced(int64_t chatId)
+{
+    CoalescedMessage *merged = chatId != 0 ? m_coalescer.find(chatId) : nullptr;
+    return merged == nullptr || sendCoalesced(merged);
+}
+
+
+void AsyncTelegram::sendScheduled()
+{
+    String command((char *)0);
+    String param((char *)0);
+#if defined(ESP32)
+    CommandQueue *retries = m_retryQueue.load(std::memory_order_acquire);
+    if (m_rateLimiter.size() == 0 && (retries == nullptr || retries->size() == 0))
+        return;
+    // Messages rejected by server with 429 error (from http task)
+    // (without a recipient they wait for the global retry time)
+    uint32_t retryAfter = m_retryAfter.exchange(0);
+    while (retries != nullptr && retries->pop(command, param)) {
+        int64_t chatId = RateLimiter::chatId(param.c_str());
+        m_rateLimiter.retryAfter(chatId, retryAfter > 0 ? retryAfter : 1);
+        if (!m_rateLimiter.push(command.c_str(), param.c_str(), chatId, true))
+            log_error("Rate limiter queue full, %s discarded\n", command.c_str());
+    }
+    // Don't fill the outbound queue, so other commands can be sent
+    while (m_commandQueue.size() < COMMAND_QUEUE_SIZE - 1 && m_rateLimiter.pop(command, param, false))
+        dispatchCommand(command.c_str(), param.c_str());
+#else
+    // Messages are kept until the reply arrives (sent again with 429 error)
+    while (m_repliesInFlight < 32 && m_rateLimiter.size() > 0 && checkConnection()) {
+        if (!m_rateLimiter.pop(command, param, true))
+            break;
+        if (!postCommand(command.c_str(), param.c_str())) {
+            m_rateLimiter.forgetSent();
+            break;
+        }
+        m_rateReplyMask |= 1UL << (m_repliesInFlight - 1);
+    }
+#endif
+}
+
+
+bool AsyncTelegram::dispatchCommand(const char* const&  command, const char* const& param)
+{
+#if defined(ESP32)
+    // With dual connection, getUpdates has its own task and connection
+    if (m_dualConnection && m_pollQueue != nullptr && strcmp(command, "getUpdates") == 0)
+        return m_pollQueue->push(command, param);
+
+    if (m_queuePolicy == QueueBlock) {
+        // Wait for http task to free a slot
+        uint32_t start = millis();
+        while (!m_commandQueue.push(command, param)) {
+            if (millis() - start > SERVER_TIMEOUT) {
+                log_error("Command queue full, %s discarded\n", command);
+                return false;
+            }
+            delay(1);
+        }
+        return true;
+    }
+    String dropped((char *)0);
+    if (!m_commandQueue.push(command, param, m_queuePolicy == QueueDropOldest, &dropped)) {
+        log_error("Command queue full, %s discarded\n", command);
+        return false;
+    }
+    // The reply to a getUpdates dropped will never arrive: poll again instead of waiting for reset
+    if (dropped == "getUpdates") {
+        log_error("Command queue full, getUpdates discarded\n");
+        httpData.waitingReply = false;
+    }
+    return true;
+#else
+    return postCommand(command, param, false);
+#endif
+}
+
+
+bool AsyncTelegram::replyReady()
+{
+#if defined(ESP32)
+    return httpData.replyReady.load(std::memory_order_acquire);
+#else
+    // Reply is parsed directly from the socket
+    return readReplies();
+#endif
+}
+
+
+bool AsyncTelegram::readReplies()
+{
+    while (m_repliesInFlight > 0 && m_httpParser->parseHeaders(*telegramClient)) {
+        if (isUpdateReply())
+            return true;
+
+        // Reply to other commands: check only the result and go on with next one
+        StaticJsonDocument<128> filter;
+        filter["ok"] = true;
+        filter["description"] = true;
+        filter["parameters"]["retry_after"] = true;
+        JsonDocument &reply = *m_replyDoc;
+        HttpBodyStream body(*m_httpParser, *telegramClient);
+        DeserializationError error = deserializeJson(reply, body, DeserializationOption::Filter(filter));
+        bool ok = !error && reply["ok"].as<bool>();
+        if (!ok)
+            log_error("Server reply %d: %s\n", m_httpParser->statusCode(), reply["description"] | error.c_str());
+        uint32_t retryAfter = m_httpParser->statusCode() == 429 ? reply["parameters"]["retry_after"] | 1 : 0;
+        if (m_rateReplyMask & 1) {
+            // Rate limited message: with 429 error it will be sent again after the time suggested by server
+            m_rateLimiter.acknowledge(retryAfter);
+            m_rateReplyMask &= ~1UL;
+        }
+        else if (retryAfter > 0)
+            m_rateLimiter.retryAfter(0, retryAfter);
+        if (m_upload.inFlight() && m_uploadReplyIndex == 0) {
+            // Server can reply before the whole body was sent (i.e. file too large)
+            bool truncated = m_upload.sending();
+            m_upload.finish(ok);
+            if (truncated) {
+                telegramClient->stop();
+                clearReplies();
+                return false;
+            }
+        }
+        finishReply();
+    }
+
+#if defined(ESP8266)
+    // With dual connection getUpdates reply is received on the dedicated connection
+    if (m_dualConnection && httpData.waitingReply && pollClient != nullptr)
+        return m_pollParser.parseHeaders(*pollClient);
+#endif
+    return false;
+}
+
+
+bool AsyncTelegram::waitReply(uint32_t timeout)
+{
+    uint32_t start = millis();
+    while (millis() - start < timeout && telegramClient->connected()) {
+        if (!m_httpParser->parseHeaders(*telegramClient)) {
+            yield();
+            continue;
+        }
+        if (m_repliesInFlight > 1) {
+            // Reply to a previous request: skip it (a discarded getUpdates will be sent again)
+            if (isUpdateReply())
+                httpData.waitingReply = false;
+            if (m_upload.inFlight() && m_uploadReplyIndex == 0)
+                m_upload.finish(m_httpParser->statusCode() == 200);
+            finishReply();
+            continue;
+        }
+        return true;
+    }
+    log_error("No reply from server\n");
+    telegramClient->stop();
+    clearReplies();
+    return false;
+}
+
+
+void AsyncTelegram::finishReply()
+{
+    if (m_rateReplyMask & 1)
+        m_rateLimiter.acknowledge(0);
+    m_rateReplyMask >>= 1;
+    m_httpParser->skipBody(*telegramClient);
+    if (!m_httpParser->complete() || !m_httpParser->keepAlive()) {
+        // Connection can't be reused: replies still in flight are lost
+        telegramClient->stop();
+        clearReplies();
+        return;
+    }
+    m_httpParser->reset();
+    if (m_repliesInFlight > 0)
+        m_repliesInFlight--;
+    if (m_updateReplyIndex > 0)
+        m_updateReplyIndex--;
+    if (m_uploadReplyIndex > 0)
+        m_uploadReplyIndex--;
+}
+
+
+void AsyncTelegram::clearReplies()
+{
+    m_httpParser->reset();
+    m_repliesInFlight = 0;
+    m_updateReplyIndex = 0;
+    m_uploadReplyIndex = 0;
+    m_rateReplyMask = 0;
+    m_rateLimiter.forgetSent();
+#if defined(ESP8266)
+    httpData.waitingReply = false;
+    if (m_upload.inFlight())
+        m_upload.finish(false);
+#endif
+}
+
+
+void AsyncTelegram::writeHeaders(Print &out, const char* command, size_t length)
+{
+    out.print("POST https://" TELEGRAM_HOST "/bot");
+    out.print(m_token);
+    out.print('/');
+    out.print(command);
+    out.print(" HTTP/1.1" "\nHost: api.telegram.org" "\nConnection: keep-alive" "\nContent-Type: application/json");
+    out.print("\nContent-Length: ");
+    out.print(length);
+    out.print("\n\n");
+}
+
+
+void AsyncTelegram::writeRequest(WiFiClientSecure *client, const char* command, const char* param)
+{
+    // Headers and body are collected in the writer buffer, not in a copy of the whole request
+    RequestWriter out(client);
+    writeHeaders(out, command, strlen(param));
+    out.print(param);
+}
+
+
+#if defined(ESP8266)
+bool AsyncTelegram::postRequest(const char* command, const RequestBody &body)
+{
+    size_t length;
+    {
+        RequestWriter sizing;
+        body(sizing);
+        length = sizing.length();
+    }
+
+    // Body of upload in progress must be completed before a new request can be written
+    processUpload(true);
+    if (!checkConnection())
+        return false;
+
+    RequestWriter out(telegramClient);
+    writeHeaders(out, command, length);
+    body(out);
+    out.flush();
+    m_repliesInFlight++;
+    return true;
+}
+#endif
+
+
+// Blocking https POST to server (used with ESP8266)
+bool AsyncTelegram::postCommand(const char* const& command, const char* const& param, bool blocking)
+{
+#if defined(ESP32)
+    // http task must wait until reply is read
+    ConnectionLock lock(clientMutex());
+#endif
+#if defined(ESP8266)
+    // With dual connection getUpdates is sent with the dedicated connection
+    if (m_dualConnection && !blocking && strcmp(command, "getUpdates") == 0) {
+        if (!checkConnection(true))
+            return false;
+        m_pollParser.reset();
+        writeRequest(pollClient, command, param);
+        return true;
+    }
+#endif
+
+    // Body of upload in progress must be completed before a new request can be written
+    processUpload(true);
+
+    bool connected = checkConnection();
+    if(connected){
+        writeRequest(telegramClient, command, param);
+
+        // Replies will be received in the same order requests were sent
+        if (strcmp(command, "getUpdates") == 0)
+            m_updateReplyIndex = m_repliesInFlight;
+        m_repliesInFlight++;
+
+        // Blocking mode
+        if (blocking) {
+            uint32_t timeout = SERVER_TIMEOUT + (!m_dualConnection && httpData.waitingReply ? m_pollTimeout * 1000UL : 0);
+            if (!waitReply(timeout))
+                return false;
+            // Deserialize JSON body straight from the socket
+            HttpBodyStream body(*m_httpParser, *telegramClient);
+            DeserializationError error = deserializeJson(*m_replyDoc, body);
+            finishReply();
+            return !error;
+        }
+        return true;
+    }
+    return false;
+}
+
+
+
+void AsyncTelegram::httpPostTask(void *args){
+#if defined(ESP32)
+
+    Serial.print("\nStart http request task on core ");
+    Serial.println(xPortGetCoreID());
+
+    HttpTaskArgs *taskArgs = (HttpTaskArgs *) args;
+    AsyncTelegram *_this = taskArgs->bot;
+    HTTPClient https;
+    //https.setReuse(true);
+    https.setTimeout(SERVER_TIMEOUT);
+
+    String command((char *)0);
+    String param((char *)0);
+    command.reserve(32);
+    param.reserve(BUFFER_SMALL);
+
+    // Clients are created before their task and kept until the bot is destroyed
+    WiFiClientSecure *client = _this->telegramClient;
+    if (taskArgs->poll)
+        client = _this->pollClient;
+
+    for(;;) {
+        // Same code is used for the outbound commands task and for the dedicated getUpdates task
+        bool closed = false;
+        if (WiFi.status()== WL_CONNECTED) {
+            // Main client can be used by loop task too (blocking commands, downloads)
+            ConnectionLock lock(taskArgs->poll ? nullptr : _this->m_clientMutex);
+            // pollClient is used only by this task: reset() asks to close it
+            if (taskArgs->poll && _this->m_pollReconnect.exchange(false))
+                client->stop();
+            _this->serveRequest(https, client, taskArgs->poll, command, param, closed);
+        }
+        if (closed) {
+            log_debug("\nGoing to delete this task and restart");
+            break;
+        }
+        delay(1);
+    }
+	delay(10);
+    _this->httpData.timestamp = 0;  // Force reset on next call
+    if (taskArgs->poll)
+        _this->pollTaskHandler = nullptr;
+    else
+        _this->taskHandler = nullptr;
+    vTaskDelete(NULL);
+#endif
+}
+
+
+#if defined(ESP32)
+bool AsyncTelegram::serveRequest(HTTPClient &https, WiFiClientSecure *client, bool poll, String &command, String &param, bool &closed)
+{
+    // File upload is sent with the main connection, one block at time (after the commands queued before)
+    if (!poll && m_upload.pending() && m_commandQueue.taken(m_uploadAfter)) {
+        sendUpload(client);
+        return true;
+    }
+
+    CommandQueue &queue = poll ? *m_pollQueue : m_commandQueue;
+    if (!queue.pop(command, param))
+        return false;
+
+    // Connect here (instead of inside HTTPClient) in order to keep track of TLS handshakes
+    if (!client->connected())
+        connectClient(client);
+    bool isUpdate = command.equals("getUpdates");
+    char url[256];
+    sniprintf(url, 256, "https://%s/bot%s/%s", TELEGRAM_HOST, m_token, command.c_str() );
+    https.begin(*client, url);
+    // Long poll request will be held by server up to m_pollTimeout seconds
+    if (isUpdate)
+        https.setTimeout(SERVER_TIMEOUT + m_pollTimeout * 1000);
+    else
+        https.setTimeout(SERVER_TIMEOUT);
+    if( param.length() > 0 ){
+        https.addHeader("Host", TELEGRAM_HOST, false, false);
+        https.addHeader("Connection", "keep-alive", false, false);
+        https.addHeader("Content-Type", "application/json", false, false);
+        https.addHeader("Content-Length", String(param.length()), false, false );
+    }
+
+    uint32_t fetchStart = millis();
+    int httpCode = https.POST(param);
+    if (httpCode == HTTP_CODE_OK || httpCode == HTTP_CODE_MOVED_PERMANENTLY) {
+        // HTTP header has been send and Server response header has been handled
+        if (isUpdate) {
+            httpData.payload  = https.getString();
+            m_pipelineStats.fetchTime = millis() - fetchStart;
+        }
+        httpData.timestamp = millis();
+
+        if(https.header("Connection").equalsIgnoreCase("close")){
+            closed = true;  // Force reset connection
+        }
+    }
+    else {
+        log_error("\nHTTPS error: %d\n", httpCode);
+        if (httpCode == HTTP_CODE_TOO_MANY_REQUESTS && !poll) {
+            // Flood limit: loop task will send again after the time suggested by server
+            StaticJsonDocument<64> filter;
+            filter["parameters"]["retry_after"] = true;
+            StaticJsonDocument<128> reply;
+            deserializeJson(reply, https.getString(), DeserializationOption::Filter(filter));
+            uint32_t retryAfter = reply["parameters"]["retry_after"] | 1;
+            if (retryAfter > m_retryAfter.load())
+                m_retryAfter.store(retryAfter);
+            // Only this task stores commands to be sent again
+            CommandQueue *retries = m_retryQueue.load(std::memory_order_relaxed);
+            if (retries == nullptr) {
+                retries = new CommandQueue;
+                m_retryQueue.store(retries, std::memory_order_release);
+            }
+            if (!retries->push(command.c_str(), param.c_str()))
+                log_error("Retry queue full, %s discarded\n", command.c_str());
+        }
+        //closed = true;    // Force reset connection
+    }
+    https.end();
+
+    // Hand over getUpdates reply (an empty payload let loop task poll again)
+    if (isUpdate) {
+        httpData.replyReady.store(true, std::memory_order_release);
+        if (m_parseTask != nullptr)
+            xTaskNotifyGive(m_parseTask);
+        else if (m_eventTask != nullptr)
+            xTaskNotifyGive(m_eventTask);
+    }
+
+    UBaseType_t uxHighWaterMark = uxTaskGetStackHighWaterMark( NULL );
+    //Serial.printf("Task free memory: %5d\n", (uint16_t)uxHighWaterMark);
+    log_debug("FreeHeap: %6d, MaxBlock: %6d\n", heap_caps_get_free_size(0), heap_caps_get_largest_free_block(0));
+    return true;
+}
+#endif
+
+
+void AsyncTelegram::setPollMode(PollMode mode, uint16_t timeout)
+{
+    m_pollMode = mode;
+    if (timeout > LONG_POLL_TIMEOUT)
+        timeout = LONG_POLL_TIMEOUT;
+    m_longPollTimeout = timeout;
+}
+
+
+uint16_t AsyncTelegram::getPollTimeout()
+{
+#if defined(ESP32)
+    // A request held by server would stop the other bots
+    if (m_connection != nullptr)
+        return 0;
+#endif
+    switch (m_pollMode) {
+        case PollLong:
+            return m_longPollTimeout;
+        case PollAdaptive:
+            if (millis() - m_lastActivity > ADAPTIVE_IDLE_TIME)
+                return m_longPollTimeout;
+            return SHORT_POLL_TIMEOUT;
+        default:
+            return SHORT_POLL_TIMEOUT;
+    }
+}
+
+
+bool AsyncTelegram::getUpdates(){
+    LOCK_BOT();
+    processUpload();
+    // Merged text messages whose time window is expired
+    CoalescedMessage *merged;
+    while ((merged = m_coalescer.expired()) != nullptr)
+        sendCoalesced(merged);
+    sendScheduled();
+
+    // No response from Telegram server for a long time (long poll request is held by server up to m_pollTimeout)
+    uint32_t replyTimeout = m_pollTimeout * 1000UL + SERVER_TIMEOUT;
+    if (replyTimeout < 10*m_minUpdateTime)
+        replyTimeout = 10*m_minUpdateTime;
+    if(millis() - httpData.timestamp > replyTimeout) {
+        Serial.println("Reset connection");
+        reset();
+    }
+
+    // Send message to Telegram server only if enough time has passed since last.
+    // With long polling, re-arm the request as soon as previous reply was received
+    uint16_t pollTimeout = getPollTimeout();
+    if(pollTimeout > SHORT_POLL_TIMEOUT || millis() - m_lastUpdateTime > m_minUpdateTime){
+        m_lastUpdateTime = millis();
+
+        // With ESP8266 the upload is written on main connection: don't put a poll request before or in the middle of it
+        bool uploading = false;
+#if defined(ESP8266)
+        uploading = !m_dualConnection && (m_upload.pending() || m_upload.sending());
+#endif
+        // If previuos reply from server was received
+        if( httpData.waitingReply == false && !uploading) {
+            m_pollTimeout = pollTimeout;
+            String param((char *)0);
+            param.reserve(64);
+            DynamicJsonDocument root(BUFFER_SMALL);
+            root["limit"] = m_batchSize;
+            // polling timeout: add &timeout=<seconds. zero for short polling.
+            root["timeout"] = pollTimeout;
+            root["allowed_updates"] = "message,callback_query";
+            if (m_lastUpdate != 0) {
+                root["offset"] = m_lastUpdate.load();
+            }
+            serializeJson(root, param);
+            httpData.waitingReply = sendCommand("getUpdates", param.c_str());
+        }
+    }
+
+    return replyReady();
+}
+
+
+
+void AsyncTelegram::setUpdateBatch(uint8_t batchSize)
+{
+    if (batchSize < 1)
+        batchSize = 1;
+    if (batchSize > MAX_UPDATES_BATCH)
+        batchSize = MAX_UPDATES_BATCH;
+    m_batchSize = batchSize;
+}
+
+
+bool AsyncTelegram::parseUpdates()
+{
+    // Resize document only here, when no pending updates are still pointing to it
+    size_t capacity = BUFFER_BIG * m_batchSize;
+    if (m_updatesDoc.capacity() != capacity)
+        m_updatesDoc = DynamicJsonDocument(capacity);
+
+#if defined(ESP8266)
+    // Skip HTTP headers and deserialize JSON body straight from the socket,
+    // without copying the reply in an intermediate String
+    DeserializationError error = DeserializationError::IncompleteInput;
+    if (readReplies()) {
+        if (m_dualConnection) {
+            HttpBodyStream body(m_pollParser, *pollClient);
+            error = deserializeJson(m_updatesDoc, body);
+            // Close dedicated connection if it can't be reused
+            if (!m_pollParser.skipBody(*pollClient) || !m_pollParser.keepAlive())
+                pollClient->stop();
+            m_pollParser.reset();
+        }
+        else {
+            HttpBodyStream body(*m_httpParser, *telegramClient);
+            error = deserializeJson(m_updatesDoc, body);
+            finishReply();
+        }
+    }
+#else
+    DeserializationError error = deserializeJson(m_updatesDoc, httpData.payload);
+    httpData.payload.clear();
+#endif
+    httpData.timestamp = millis();
+    httpData.replyReady = false;
+
+    if (error || !m_updatesDoc["ok"].as<bool>()) {
+        log_error("Bad getUpdates reply: %s\n", error.c_str());
+        httpData.waitingReply = false;
+        return false;
+    }
+    debugJson(m_updatesDoc, Serial);
+
+    // Store updates received in the ring buffer and move offset forward,
+    // so next getUpdates request will confirm all of them to the server
+    for (JsonObject update : m_updatesDoc["result"].as<JsonArray>()) {
+        if (m_pendingCount == MAX_UPDATES_BATCH)
+            break;
+        int32_t updateID = update["update_id"];
+        if (updateID == 0)
+            continue;
+        m_pendingUpdates[(m_pendingHead + m_pendingCount) % MAX_UPDATES_BATCH] = update;
+        m_pendingCount++;
+        m_lastUpdate = updateID + 1;
+        m_lastActivity = millis();
+    }
+    // Next request can be sent now (from loop task, while parse task is still decoding in pipelined mode)
+    httpData.waitingReply = false;
+    return m_pendingCount > 0;
+}
+
+
+static void parseUser(JsonObject from, TBUser &user)
+{
+    for (JsonPair kv : from) {
+        const char* key = kv.key().c_str();
+        if (strcmp(key, "id") == 0)
+            user.id = kv.value();
+        else if (strcmp(key, "username") == 0)
+            user.username = kv.value();
+        else if (strcmp(key, "first_name") == 0)
+            user.firstName = kv.value();
+        else if (strcmp(key, "last_name") == 0)
+            user.lastName = kv.value();
+        else if (strcmp(key, "is_bot") == 0)
+            user.isBot = kv.value();
+        else if (strcmp(key, "language_code") == 0)
+            user.languageCode = kv.value();
+    }
+}
+
+
+MessageType AsyncTelegram::parseMessage(JsonObject msg, TBMessage &message)
+{
+    bool hasId = false, hasText = false, isReply = false;
+    MessageType type = MessageNoData;
+    const char* caption = nullptr;
+
+    for (JsonPair kv : msg) {
+        const char* key = kv.key().c_str();
+        JsonVariant value = kv.value();
+
+        switch (key[0]) {
+            case 'm':
+                if (strcmp(key, "message_id") == 0) {
+                    message.messageID = value;
+                    hasId = true;
+                }
+                break;
+            case 'f':
+                if (strcmp(key, "from") == 0)
+                    parseUser(value.as<JsonObject>(), message.sender);
+                break;
+            case 'c':
+                if (strcmp(key, "chat") == 0) {
+                    message.chatId = value["id"];
+                    message.group.title = value["title"];
+                }
+                else if (strcmp(key, "caption") == 0)
+                    caption = value.as<const char*>();
+                else if (strcmp(key, "contact") == 0) {
+                    for (JsonPair c : value.as<JsonObject>()) {
+                        const char* ckey = c.key().c_str();
+                        if (strcmp(ckey, "user_id") == 0)
+                            message.contact.id = c.value();
+                        else if (strcmp(ckey, "first_name") == 0)
+                            message.contact.firstName = c.value();
+                        else if (strcmp(ckey, "last_name") == 0)
+                            message.contact.lastName = c.value();
+                        else if (strcmp(ckey, "phone_number") == 0)
+                            message.contact.phoneNumber = c.value();
+                        else if (strcmp(ckey, "vcard") == 0)
+                            message.contact.vCard = c.value();
+                    }
+                    if (type == MessageNoData || type > MessageContact)
+                        type = MessageContact;
+                }
+                break;
+            case 'd':
+                if (strcmp(key, "date") == 0)
+                    message.date = value;
+                else if (strcmp(key, "document") == 0) {
+                    message.document.file_id = value["file_id"];
+                    message.document.file_name = value["file_name"];
+                    message.document.file_size = value["file_size"] | 0;
+                    message.document.file_exists = message.document.file_id != nullptr;
+                    if (type == MessageNoData)
+                        type = MessageDocument;
+                }
+                break;
+            case 'l':
+                if (strcmp(key, "location") == 0) {
+                    message.location.longitude = value["longitude"];
+                    message.location.latitude = value["latitude"];
+                    type = MessageLocation;
+                }
+                break;
+            case 'r':
+                if (strcmp(key, "reply_to_message") == 0)
+                    isReply = true;
+                break;
+            case 't':
+                if (strcmp(key, "text") == 0) {
+                    message.text = value.as<const char*>();
+                    hasText = true;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    if (!hasId)
+        return MessageNoData;
+    // Caption of a document is handed out as its text
+    if (type == MessageDocument && !hasText && caption != nullptr)
+        message.text = caption;
+    // Same priority as Telegram fields: location, contact, document, reply and then text
+    if (type != MessageNoData)
+        return type;
+    if (isReply)
+        return MessageReply;
+    if (hasText)
+        return MessageText;
+    return MessageNoData;
+}
+
+
+MessageType AsyncTelegram::parseCallbackQuery(JsonObject query, TBMessage &message)
+{
+    bool hasId = false;
+    for (JsonPair kv : query) {
+        const char* key = kv.key().c_str();
+        JsonVariant value = kv.value();
+
+        if (strcmp(key, "id") == 0) {
+            message.callbackQueryID = value;
+            hasId = true;
+        }
+        else if (strcmp(key, "data") == 0)
+            message.callbackQueryData = value;
+        else if (strcmp(key, "from") == 0)
+            parseUser(value.as<JsonObject>(), message.sender);
+        else if (strcmp(key, "chat_instance") == 0)
+            message.chatInstance = value;
+        else if (strcmp(key, "message") == 0) {
+            // the message with the inline keyboard
+            for (JsonPair m : value.as<JsonObject>()) {
+                const char* mkey = m.key().c_str();
+                if (strcmp(mkey, "message_id") == 0)
+                    message.messageID = m.value();
+                else if (strcmp(mkey, "chat") == 0)
+                    message.chatId = m.value()["id"];
+                else if (strcmp(mkey, "text") == 0)
+                    message.text = m.value().as<const char*>();
+                else if (strcmp(mkey, "date") == 0)
+                    message.date = m.value();
+            }
+        }
+    }
+    return hasId ? MessageQuery : MessageNoData;
+}
+
+
+MessageType AsyncTelegram::getNewMessage(TBMessage &message )
+{
+    message.messageType = MessageNoData;
+    // Updates are already being handed out (by event driver or by a handler calling this)
+    if (m_dispatching.exchange(true))
+        return MessageNoData;
+    LOCK_BOT();
+
+    MessageType type = nextMessage(message);
+    if (type != MessageNoData && handleMessage(message))
+        type = MessageNoData;
+    m_dispatching = false;
+    return type;
+}
+
+
+bool AsyncTelegram::handleMessage(const TBMessage &message)
+{
+    if (message.messageType == MessageText && m_commands.route(message, userName.c_str()))
+        return true;
+    MessageHandler &handler = m_handlers[message.messageType];
+    if (handler == nullptr)
+        return false;
+    handler(message);
+    return true;
+}
+
+
+void AsyncTelegram::setHandler(MessageType type, MessageHandler handler)
+{
+    LOCK_BOT();
+    m_handlers[type] = handler;
+    startEvents();
+}
 
-    delete telegramClient;
 
-    httpData.waitingReply = false;
-    httpData.payload.clear();
-    httpData.command.clear();
-    httpData.timestamp = millis();
-    return begin();
+bool AsyncTelegram::addCommand(const char* command, CommandHandler handler)
+{
+    LOCK_BOT();
+    return m_commands.add(command, handler);
 }
 
 
-void AsyncTelegram::sendCommand(const char* const&  command, const char* const& param)
+void AsyncTelegram::startEvents()
 {
+    if (m_eventsStarted)
+        return;
+    m_eventsStarted = true;
 #if defined(ESP32)
-    if(httpData.waitingReply == false){
-        httpData.waitingReply = true;
-        httpData.command = command;
-        httpData.param = param;
-    }
-#else
-    postCommand(command, param, false);
+    // Same core of loop task, so handlers are not run at the same time of http tasks
+    xTaskCreatePinnedToCore(this->eventTask, "eventTask", 8192, this, 1, &m_eventTask, 1);
+#elif defined(ESP8266)
+    // Scheduled callbacks run after loop(), where network can be used
+    m_eventTicker.attach_ms_scheduled(EVENTS_INTERVAL, [this]() { dispatchEvents(); });
 #endif
 }
 
 
-// Blocking https POST to server (used with ESP8266)
-bool AsyncTelegram::postCommand(const char* const& command, const char* const& param, bool blocking)
+void AsyncTelegram::dispatchEvents()
 {
-    bool connected = checkConnection();
-    if(connected){
-        String request;
-        request.reserve(BUFFER_MEDIUM);
-        request = "POST https://" TELEGRAM_HOST "/bot";
-        request += m_token;
-        request += "/";
-        request += command;
-        request += " HTTP/1.1" "\nHost: api.telegram.org" "\nConnection: keep-alive" "\nContent-Type: application/json";
-        request += "\nContent-Length: ";
-        request += strlen(param);
-        request += "\n\n";
-        request += param;
-        telegramClient->print(request);
-        httpData.waitingReply = true;
-
-         // Blocking mode
-        if (blocking) {
-            while (telegramClient->connected()) {
-                yield();
-                String line = telegramClient->readStringUntil('\n');
-                if (line == "\r") break;
-            }
-            // If there are incoming bytes available from the server, read them and print them:
-            while (telegramClient->available()) {
-                yield();
-                httpData.payload  += (char) telegramClient->read();
-            }
-            httpData.waitingReply = false;
-            DeserializationError error = deserializeJson(smallDoc, httpData.payload);
-            return !error;
-        }
-    }
-    return false;
+    if (!m_ready || m_dispatching.exchange(true))
+        return;
+    // Handlers run with the bot locked, so loop task can't send at the same time
+    LOCK_BOT();
+
+    TBMessage message;
+    do {
+        if (nextMessage(message) != MessageNoData && !handleMessage(message))
+            log_debug("No handler for message type %d\n", message.messageType);
+    } while (updatesPending());
+    m_dispatching = false;
 }
 
 
-
-void AsyncTelegram::httpPostTask(void *args){
 #if defined(ESP32)
-
-    Serial.print("\nStart http request task on core ");
-    Serial.println(xPortGetCoreID());
-
-    bool resetTask = false;
+void AsyncTelegram::eventTask(void *args)
+{
     AsyncTelegram *_this = (AsyncTelegram *) args;
-    HTTPClient https;
-    //https.setReuse(true);
-    https.setTimeout(SERVER_TIMEOUT);
-
-    for(;;) {
-        //bool connected = _this->checkConnection();
-        if (_this->httpData.command.length() > 0 &&  WiFi.status()== WL_CONNECTED ) {
-            char url[256];
-            sniprintf(url, 256, "https://%s/bot%s/%s", TELEGRAM_HOST, _this->m_token, _this->httpData.command.c_str() );
-            https.begin(*_this->telegramClient, url);
-            _this->httpData.waitingReply = true;
-            if( _this->httpData.param.length() > 0 ){
-                https.addHeader("Host", TELEGRAM_HOST, false, false);
-                https.addHeader("Connection", "keep-alive", false, false);
-                https.addHeader("Content-Type", "application/json", false, false);
-                https.addHeader("Content-Length", String(_this->httpData.param.length()), false, false );
-            }
+    for (;;) {
+        _this->dispatchEvents();
+        // Sleep until http task hands over a getUpdates reply, or until next job is due
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(_this->eventsWaitTime()));
+    }
+}
 
-            int httpCode = https.POST(_this->httpData.param);
-            if (httpCode == HTTP_CODE_OK || httpCode == HTTP_CODE_MOVED_PERMANENTLY) {
-                // HTTP header has been send and Server response header has been handled
-                _this->httpData.payload  = https.getString();
-                _this->httpData.timestamp = millis();
 
-                if(https.header("Connection").equalsIgnoreCase("close")){
-                    resetTask = true;  // Force reset connection
-                }
-            }
-            else {
-                log_error("\nHTTPS error: %d\n", httpCode);
-                //resetTask = true;    // Force reset connection
-            }
-            _this->httpData.command.clear();
-            _this->httpData.param.clear();
-            https.end();
+uint32_t AsyncTelegram::eventsWaitTime()
+{
+    LOCK_BOT();
+    // Messages waiting to be sent and uploads in progress are handled from here
+    CommandQueue *retries = m_retryQueue.load(std::memory_order_acquire);
+    if (!m_ready || m_rateLimiter.size() > 0 || (retries != nullptr && retries->size() > 0) ||
+            m_coalescer.oldest() != nullptr || m_upload.state() != UploadIdle)
+        return EVENTS_INTERVAL;
+    if (httpData.waitingReply)
+        return EVENTS_MAX_WAIT;
+
+    // Next getUpdates request
+    uint32_t elapsed = millis() - m_lastUpdateTime;
+    if (getPollTimeout() > SHORT_POLL_TIMEOUT || elapsed >= m_minUpdateTime)
+        return EVENTS_INTERVAL;
+    return m_minUpdateTime - elapsed;
+}
+#endif
 
-            UBaseType_t uxHighWaterMark = uxTaskGetStackHighWaterMark( NULL );
-            //Serial.printf("Task free memory: %5d\n", (uint16_t)uxHighWaterMark);
-            log_debug("FreeHeap: %6d, MaxBlock: %6d\n", heap_caps_get_free_size(0), heap_caps_get_largest_free_block(0));
 
-            if (resetTask) {
-                log_debug("\nGoing to delete this task and restart");
-                break;
-            }
-        }
-        delay(1);
-    }
-	delay(10);
-    _this->httpData.timestamp = 0;  // Force reset on next call
-    vTaskDelete(NULL);
+bool AsyncTelegram::updatesPending()
+{
+#if defined(ESP32)
+    if (m_pipelined)
+        return m_updateQueue != nullptr && uxQueueMessagesWaiting(m_updateQueue) > 0;
 #endif
+    return m_pendingCount > 0;
 }
 
 
-bool AsyncTelegram::getUpdates(){
-    // No response from Telegram server for a long time
-    if(millis() - httpData.timestamp > 10*m_minUpdateTime) {
-        Serial.println("Reset connection");
-        reset();
-    }
-
-    // Send message to Telegram server only if enough time has passed since last
-    if(millis() - m_lastUpdateTime > m_minUpdateTime){
-        m_lastUpdateTime = millis();
-
-        // If previuos reply from server was received
-        if( httpData.waitingReply == false) {
-            String param((char *)0);
-            param.reserve(64);
-            DynamicJsonDocument root(BUFFER_SMALL);
-            root["limit"] = 1;
-            // polling timeout: add &timeout=<seconds. zero for short polling.
-            root["timeout"] = 3;
-            root["allowed_updates"] = "message,callback_query";
-            if (m_lastUpdate != 0) {
-                root["offset"] = m_lastUpdate;
+#if defined(ESP32)
+void AsyncTelegram::parseTask(void *args)
+{
+    AsyncTelegram *_this = (AsyncTelegram *) args;
+    PipelineStats &stats = _this->m_pipelineStats;
+    UpdateRecord &record = *_this->m_parseRecord;
+    TBMessage message;
+
+    for (;;) {
+        // Woken up by http task when a getUpdates reply is ready
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (!_this->httpData.replyReady.load(std::memory_order_acquire))
+            continue;
+
+        // Time spent waiting for loop task (queue full) is not counted
+        uint32_t start = micros();
+        uint32_t parseTime = 0;
+        if (_this->parseUpdates()) {
+            while (_this->m_pendingCount > 0) {
+                if (_this->decodeUpdate(message) == MessageNoData)
+                    continue;
+                record.pack(message);
+                if (record.truncated)
+                    stats.truncated++;
+                parseTime += micros() - start;
+
+                record.queued = micros();
+                xQueueSend(_this->m_updateQueue, &record, portMAX_DELAY);
+                stats.updates++;
+                uint8_t queued = uxQueueMessagesWaiting(_this->m_updateQueue);
+                if (queued > stats.highWater)
+                    stats.highWater = queued;
+                if (_this->m_eventTask != nullptr)
+                    xTaskNotifyGive(_this->m_eventTask);
+                start = micros();
             }
-            serializeJson(root, param);
-            sendCommand("getUpdates", param.c_str());
         }
+        stats.parseTime = parseTime + micros() - start;
     }
+}
+#endif
 
-    #if defined(ESP8266)
-
-    // If there are incoming bytes available from the server, read them and store:
-    while (telegramClient->available() ){
-        httpData.payload += (char) telegramClient->read();
-    }
 
-    // We have a message, parse data received
-    if(httpData.payload.length() != 0) {
-        httpData.payload = httpData.payload.substring(httpData.payload.indexOf("{\"ok\":"), httpData.payload.length());
-        return true;
+MessageType AsyncTelegram::decodeUpdate(TBMessage &message)
+{
+    message.messageType = MessageNoData;
+    JsonObject update = m_pendingUpdates[m_pendingHead];
+    m_pendingHead = (m_pendingHead + 1) % MAX_UPDATES_BATCH;
+    m_pendingCount--;
+
+    // Clear all fields left from a previous update (received strings point into m_updatesDoc),
+    // only the options set by the sketch for replies are kept
+    message.chatId = 0;
+    message.messageID = 0;
+    message.date = 0;
+    message.chatInstance = 0;
+    message.sender = TBUser();
+    message.group = TBGroup();
+    message.location = TBLocation();
+    message.contact = TBContact();
+    message.document = TBDocument();
+    message.callbackQueryData = nullptr;
+    message.callbackQueryID = nullptr;
+    message.text = TBString();
+
+    // Single pass over the update: each member is visited once and classified by its key
+    for (JsonPair kv : update) {
+        const char* key = kv.key().c_str();
+        if (strcmp(key, "message") == 0)
+            message.messageType = parseMessage(kv.value().as<JsonObject>(), message);
+        else if (strcmp(key, "callback_query") == 0)
+            message.messageType = parseCallbackQuery(kv.value().as<JsonObject>(), message);
     }
-    #else
-        return ! httpData.waitingReply;
-    #endif
-    return false;
+    return message.messageType;
 }
 
 
-
 // Parse message received from Telegram server
-MessageType AsyncTelegram::getNewMessage(TBMessage &message )
+MessageType AsyncTelegram::nextMessage(TBMessage &message)
 {
     message.messageType = MessageNoData;
-    getUpdates();
-    // We have a message, parse data received
-    if( httpData.payload.length() > 0 ) {
-
-        DynamicJsonDocument root(BUFFER_BIG);
-        deserializeJson(root, httpData.payload);
-        httpData.payload.clear();
-        httpData.timestamp = millis();
-        httpData.waitingReply = false;
+    uint32_t start = micros();
 
-        bool ok = root["ok"];
-        if (!ok) {
-            errorJson(httpData.payload);
-            return MessageNoData;
-        }
-        uint32_t updateID = root["result"][0]["update_id"];
-        if (updateID == 0){
+#if defined(ESP32)
+    if (m_pipelined) {
+        // Replies are decoded by parse task: just take next record
+        getUpdates();
+        if (m_updateQueue == nullptr || xQueueReceive(m_updateQueue, m_record, 0) != pdTRUE)
             return MessageNoData;
+        start = micros();
+        m_pipelineStats.queueTime = start - m_record->queued;
+        m_record->unpack(message);
+    }
+    else
+#endif
+    {
+        // Send a new request to server only when all pending updates were handed out
+        if (m_pendingCount == 0) {
+            getUpdates();
+            // We have a message, parse data received
+            if (!replyReady() || !parseUpdates())
+                return MessageNoData;   // waiting for reply from server
         }
-        m_lastUpdate = updateID + 1;
+        decodeUpdate(message);
+    }
 
-        debugJson(root, Serial);
-
-        if(root["result"][0]["callback_query"]["id"]){
-            // this is a callback query
-            message.callbackQueryID   = root["result"][0]["callback_query"]["id"];
-            message.chatId            = root["result"][0]["callback_query"]["message"]["chat"]["id"];
-            message.sender.id         = root["result"][0]["callback_query"]["from"]["id"];
-            message.sender.username   = root["result"][0]["callback_query"]["from"]["username"];
-            message.sender.firstName  = root["result"][0]["callback_query"]["from"]["first_name"];
-            message.sender.lastName   = root["result"][0]["callback_query"]["from"]["last_name"];
-            message.messageID         = root["result"][0]["callback_query"]["message"]["message_id"];
-            message.text              = root["result"][0]["callback_query"]["message"]["text"].as<String>();
-            message.date              = root["result"][0]["callback_query"]["message"]["date"];
-            message.chatInstance      = root["result"][0]["callback_query"]["chat_instance"];
-            message.callbackQueryData = root["result"][0]["callback_query"]["data"];
-            message.messageType       = MessageQuery;
-            m_inlineKeyboard.checkCallback(message);
-        }
-        else if(root["result"][0]["message"]["message_id"]){
-            // this is a message
-            message.messageID        = root["result"][0]["message"]["message_id"];
-            message.chatId           = root["result"][0]["message"]["chat"]["id"];
-            message.sender.id        = root["result"][0]["message"]["from"]["id"];
-            message.sender.username  = root["result"][0]["message"]["from"]["username"];
-            message.sender.firstName = root["result"][0]["message"]["from"]["first_name"];
-            message.sender.lastName  = root["result"][0]["message"]["from"]["last_name"];
-            message.group.title      = root["result"][0]["message"]["chat"]["title"];
-            message.date             = root["result"][0]["message"]["date"];
-
-            if(root["result"][0]["message"]["location"]){
-                // this is a location message
-                message.location.longitude = root["result"][0]["message"]["location"]["longitude"];
-                message.location.latitude = root["result"][0]["message"]["location"]["latitude"];
-                message.messageType = MessageLocation;
-            }
-            else if(root["result"][0]["message"]["contact"]){
-                // this is a contact message
-                message.contact.id          = root["result"][0]["message"]["contact"]["user_id"];
-                message.contact.firstName   = root["result"][0]["message"]["contact"]["first_name"];
-                message.contact.lastName    = root["result"][0]["message"]["contact"]["last_name"];
-                message.contact.phoneNumber = root["result"][0]["message"]["contact"]["phone_number"];
-                message.contact.vCard       = root["result"][0]["message"]["contact"]["vcard"];
-                message.messageType = MessageContact;
-            }
-            else if(root["result"][0]["message"]["document"]){
-                // this is a document message
-                message.document.file_id      = root["result"][0]["message"]["document"]["file_id"];
-                message.document.file_name    = root["result"][0]["message"]["document"]["file_name"];
-                message.text                  = root["result"][0]["message"]["caption"].as<String>();
-                message.document.file_exists  = getFile(message.document);
-                message.messageType           = MessageDocument;
-            }
-            else if(root["result"][0]["message"]["reply_to_message"]){
-                // this is a reply to message
-                message.text        = root["result"][0]["message"]["text"].as<String>();
-                message.messageType = MessageReply;
-            }
-            else if (root["result"][0]["message"]["text"]) {
-                // this is a text message
-                message.text        = root["result"][0]["message"]["text"].as<String>();
-                message.messageType = MessageText;
-            }
-        }
-        return message.messageType;
+    if (message.messageType == MessageQuery) {
+        m_inlineKeyboard.checkCallback(message);
+        if (m_staticKeyboard != nullptr)
+            m_staticKeyboard->checkCallback(message);
     }
-    return MessageNoData;   // waiting for reply from server
+
+    if (m_pipelined)
+        m_pipelineStats.handleTime = micros() - start;
+    return message.messageType;
 }
 
 
 // Blocking getMe function (we wait for a reply from Telegram server)
 bool AsyncTelegram::getMe(TBUser &user)
 {
+    LOCK_BOT();
+#if defined(ESP32)
+    // Reply document can be the one of the shared connection
+    ConnectionLock lock(clientMutex());
+#endif
     // getMe has top be blocking (wait server reply)
     if (!postCommand("getMe", "", true))
        return false;
 
+    JsonDocument &smallDoc = *m_replyDoc;
     bool ok = smallDoc["ok"];
     if (!ok) {
         errorJson(httpData.payload);
@@ -401,14 +1340,20 @@ bool AsyncTelegram::getMe(TBUser &user)
 
 bool AsyncTelegram::getFile(TBDocument &doc)
 {
+    LOCK_BOT();
     // getFile has to be blocking (wait server reply)
     char cmd[128];
     strcpy(cmd,  "getFile?file_id=");
     strcat(cmd, doc.file_id);
 
+#if defined(ESP32)
+    // Reply document can be the one of the shared connection
+    ConnectionLock lock(clientMutex());
+#endif
     if (!postCommand(cmd, "", true))
        return false;
 
+    JsonDocument &smallDoc = *m_replyDoc;
     bool ok = smallDoc["ok"];
     if (!ok) {
         errorJson(httpData.payload);
@@ -427,149 +1372,167 @@ bool AsyncTelegram::getFile(TBDocument &doc)
 
 
 
-void AsyncTelegram::sendMessage(const TBMessage &msg, const char* message, String keyboard)
+bool AsyncTelegram::sendMessage(const TBMessage &msg, const char* message, const String &keyboard)
 {
-    if (strlen(message) == 0)
-        return;
+    return sendMessageMarkup(msg, message, keyboard.length() != 0 ? keyboard.c_str() : nullptr);
+}
+
+
+bool AsyncTelegram::sendMessage(const TBMessage &msg, const char* message, InlineKeyboard &keyboard)
+{
+    LOCK_BOT();
+    m_inlineKeyboard = keyboard;
+    m_staticKeyboard = nullptr;
+    return sendMessageMarkup(msg, message, keyboard.getJSON().c_str());
+}
 
-    DynamicJsonDocument root(BUFFER_BIG);
-	// Backward compatibility
-	root["chat_id"] = msg.sender.id != 0 ? msg.sender.id : msg.chatId;
-    root["text"] = message;
 
-    if(msg.isMarkdownEnabled)
-        root["parse_mode"] = "MarkdownV2";
+bool AsyncTelegram::sendMessage(const TBMessage &msg, const char* message, const StaticKeyboard &keyboard)
+{
+    LOCK_BOT();
+    m_inlineKeyboard = InlineKeyboard();
+    m_staticKeyboard = &keyboard;
 
-    if(msg.isHTMLenabled)
-        root["parse_mode"] = "HTML";
+    return sendMessageMarkup(msg, message, (PGM_P) keyboard.getJSON(), true);
+}
 
-    if(msg.disable_notification)
-        root["disable_notification"] = true;
 
-    if (keyboard.length() != 0) {
-        DynamicJsonDocument doc(BUFFER_MEDIUM);
-        deserializeJson(doc, keyboard);
-        JsonObject myKeyb = doc.as<JsonObject>();
-        root["reply_markup"] = myKeyb;
-        if(msg.force_reply) {
-            root["reply_markup"]["selective"] = true,
-            root["reply_markup"]["force_reply"] = true;
-        }
+bool AsyncTelegram::sendMessageMarkup(const TBMessage &msg, const char* message, const char* keyboard, bool inFlash)
+{
+    LOCK_BOT();
+    if (strlen(message) == 0)
+        return false;
+
+    // Backward compatibility
+    int64_t chatId = msg.sender.id != 0 ? msg.sender.id : msg.chatId;
+
+    // Plain text messages can be merged with the next ones sent to the same chat
+    if (m_coalescer.window() > 0 && keyboard == nullptr) {
+        ParseMode parseMode = msg.isHTMLenabled ? ParseHTML : (msg.isMarkdownEnabled ? ParseMarkdownV2 : ParseNone);
+        return coalesceMessage(chatId, message, parseMode, msg.disable_notification);
     }
 
-    String param;
-    serializeJson(root, param);
-    sendCommand("sendMessage", param.c_str());
-    debugJson(root, Serial);
+    // Merged in keyboard object while it's copied
+    const char* flags = msg.force_reply ? "\"selective\":true,\"force_reply\":true" : nullptr;
+    const char* parseMode = msg.isHTMLenabled ? "HTML" : (msg.isMarkdownEnabled ? "MarkdownV2" : nullptr);
+    return sendCommand("sendMessage", chatId, [&](RequestWriter &json) {
+        json.beginObject();
+        json.addNumber("chat_id", chatId);
+        json.addString("text", message);
+        if (parseMode != nullptr)
+            json.addString("parse_mode", parseMode);
+        if (msg.disable_notification)
+            json.addBool("disable_notification", true);
+        if (keyboard != nullptr && inFlash)
+            json.addJson("reply_markup", FPSTR(keyboard), flags);
+        else if (keyboard != nullptr)
+            json.addJson("reply_markup", keyboard, flags);
+        json.endObject();
+    });
 }
 
 
-void AsyncTelegram::sendTo(const int32_t userid, String &message, String keyboard) {
+bool AsyncTelegram::sendTo(const int32_t userid, const char* message, String keyboard) {
     TBMessage msg;
     msg.chatId = userid;
-    return sendMessage(msg, message.c_str(), "");
+    return sendMessage(msg, message, keyboard);
 }
 
 
-void AsyncTelegram::sendPhotoByUrl(const uint32_t& chat_id,  const String& url, const String& caption)
+bool AsyncTelegram::sendPhotoByUrl(const uint32_t& chat_id,  const String& url, const String& caption)
 {
     if (url.length() == 0)
-        return;
-	smallDoc.clear();
-    smallDoc["chat_id"] = chat_id;
-    smallDoc["photo"] = url;
-    smallDoc["caption"] = caption;
-
-    char param[256];
-    serializeJson(smallDoc, param, 256);
-    sendCommand("sendPhoto", param);
-    debugJson(smallDoc, Serial);
+        return false;
+    return sendCommand("sendPhoto", chat_id, [&](RequestWriter &json) {
+        json.beginObject();
+        json.addNumber("chat_id", chat_id);
+        json.addString("photo", url.c_str());
+        json.addString("caption", caption.c_str());
+        json.endObject();
+    });
 }
 
 
-void AsyncTelegram::sendToChannel(const char* &channel, String &message, bool silent) {
+bool AsyncTelegram::sendToChannel(const char* &channel, String &message, bool silent) {
     if (message.length() == 0)
-        return;
-    DynamicJsonDocument root(BUFFER_MEDIUM);
-    root["chat_id"] = channel;
-    root["text"] = message;
-    if(silent)
-        root["silent"] = true;
-
-    String param;
-    serializeJson(root, param);
-    sendCommand("sendMessage", param.c_str());
-    debugJson(root, Serial);
+        return false;
+    return sendCommand("sendMessage", RateLimiter::channelId(channel), [&](RequestWriter &json) {
+        json.beginObject();
+        json.addString("chat_id", channel);
+        json.addString("text", message.c_str());
+        if (silent)
+            json.addBool("silent", true);
+        json.endObject();
+    });
 }
 
 
-void AsyncTelegram::endQuery(const TBMessage &msg, const char* message, bool alertMode)
+bool AsyncTelegram::endQuery(const TBMessage &msg, const char* message, bool alertMode)
 {
     if (strlen(msg.callbackQueryID) == 0)
-        return;
-	smallDoc.clear();
-    smallDoc["callback_query_id"] =  msg.callbackQueryID;
-    if (strlen(message) != 0) {
-        smallDoc["text"] = message;
-        if (alertMode)
-            smallDoc["show_alert"] = true;
-        else
-            smallDoc["show_alert"] = false;
-    }
-    char param[BUFFER_SMALL];
-    serializeJson(smallDoc, param, BUFFER_SMALL);
-    sendCommand("answerCallbackQuery", param);
+        return false;
+    return sendCommand("answerCallbackQuery", 0, [&](RequestWriter &json) {
+        json.beginObject();
+        json.addString("callback_query_id", msg.callbackQueryID);
+        if (strlen(message) != 0) {
+            json.addString("text", message);
+            json.addBool("show_alert", alertMode);
+        }
+        json.endObject();
+    });
 }
 
 
-void AsyncTelegram::removeReplyKeyboard(const TBMessage &msg, const char* message, bool selective)
+bool AsyncTelegram::removeReplyKeyboard(const TBMessage &msg, const char* message, bool selective)
 {
-	smallDoc.clear();
-    smallDoc["remove_keyboard"] = true;
-    if (selective) {
-        smallDoc["selective"] = true;
-    }
-    char command[128];
-    serializeJson(smallDoc, command, 128);
-    sendMessage(msg, message, command);
+    return sendMessageMarkup(msg, message, selective ? "{\"remove_keyboard\":true,\"selective\":true}" : "{\"remove_keyboard\":true}");
 }
 
-void AsyncTelegram::editMessageReplyMarkup(TBMessage &msg, String keyboard) // keyboard value defaulted to ""
+bool AsyncTelegram::editMessageReplyMarkup(TBMessage &msg, const String &keyboard) // keyboard value defaulted to ""
 {
-    if (sizeof(msg) == 0)
-        return;
-
-
-    DynamicJsonDocument root(BUFFER_SMALL);
-
-    root["chat_id"] = msg.chatId;
-    root["message_id"] = msg.messageID;
-
-    if (msg.isMarkdownEnabled)
-        root["parse_mode"] = "Markdown";
+    return editMessageMarkup(msg, keyboard.length() != 0 ? keyboard.c_str() : nullptr);
+}
 
-    if (keyboard.length() != 0) {
-        DynamicJsonDocument doc(512);
-        deserializeJson(doc, keyboard);
-        JsonObject myKeyb = doc.as<JsonObject>();
-        root["reply_markup"] = myKeyb;
-    }
 
-    String buffer;
-    serializeJson(root, buffer);
-    sendCommand("editMessageReplyMarkup", buffer.c_str());
-    debugJson(root, Serial);
+bool AsyncTelegram::editMessageMarkup(TBMessage &msg, const char* keyboard, bool inFlash)
+{
+    LOCK_BOT();
+    return sendCommand("editMessageReplyMarkup", msg.chatId, [&](RequestWriter &json) {
+        json.beginObject();
+        json.addNumber("chat_id", msg.chatId);
+        json.addNumber("message_id", msg.messageID);
+        if (msg.isMarkdownEnabled)
+            json.addString("parse_mode", "Markdown");
+        if (keyboard != nullptr && inFlash)
+            json.addJson("reply_markup", FPSTR(keyboard));
+        else if (keyboard != nullptr)
+            json.addJson("reply_markup", keyboard);
+        json.endObject();
+    });
 }
 
-void AsyncTelegram::editMessageReplyMarkup(TBMessage &msg, InlineKeyboard &keyboard)
+bool AsyncTelegram::editMessageReplyMarkup(TBMessage &msg, InlineKeyboard &keyboard)
 {
+    LOCK_BOT();
     m_inlineKeyboard = keyboard;
-    return editMessageReplyMarkup(msg, keyboard.getJSON());
+    m_staticKeyboard = nullptr;
+    return editMessageMarkup(msg, keyboard.getJSON().c_str());
+}
+
+
+bool AsyncTelegram::editMessageReplyMarkup(TBMessage &msg, const StaticKeyboard &keyboard)
+{
+    LOCK_BOT();
+    m_inlineKeyboard = InlineKeyboard();
+    m_staticKeyboard = &keyboard;
+
+    return editMessageMarkup(msg, (PGM_P) keyboard.getJSON(), true);
 }
 
 
 bool AsyncTelegram::serverReply(const char* const& replyMsg)
 {
+    JsonDocument &smallDoc = *m_replyDoc;
 	smallDoc.clear();
     deserializeJson(smallDoc, replyMsg);
     bool ok = smallDoc["ok"];
@@ -582,24 +1545,61 @@ bool AsyncTelegram::serverReply(const char* const& replyMsg)
 }
 
 
-bool AsyncTelegram::checkConnection()
+bool AsyncTelegram::connectClient(WiFiClientSecure *client)
+{
+#if defined(ESP8266)
+    // If server accept the session offered, BearSSL keeps the same session parameters
+    uint8_t session[sizeof(BearSSL::Session)];
+    memcpy(session, m_session, sizeof(session));
+#endif
+    uint32_t start = millis();
+    bool connected = client->connect(telegramServerIP, TELEGRAM_PORT);
+    if (!connected) {
+        // no way, try to connect with hostname
+        connected = client->connect(TELEGRAM_HOST, TELEGRAM_PORT);
+        if (!connected) {
+            Serial.printf("Unable to connect to Telegram server\n");
+            return false;
+        }
+        log_debug("\nConnected using Telegram hostname\n");
+    }
+    else log_debug("\nConnected using Telegram ip address\n");
+
+    uint32_t elapsed = millis() - start;
+    m_tlsStats.lastHandshakeTime = elapsed;
+    m_tlsStats.totalHandshakeTime += elapsed;
+    bool resumed = false;
+#if defined(ESP8266)
+    static const uint8_t noSession[sizeof(BearSSL::Session)] = {0};
+    resumed = memcmp(session, noSession, sizeof(session)) != 0 && memcmp(session, m_session, sizeof(session)) == 0;
+#endif
+    if (resumed)
+        m_tlsStats.resumedHandshakes++;
+    else
+        m_tlsStats.fullHandshakes++;
+    log_debug("TLS handshake (%s): %u ms\n", resumed ? "resumed" : "full", elapsed);
+    return true;
+}
+
+
+bool AsyncTelegram::checkConnection(bool poll)
 {
     if(WiFi.status() != WL_CONNECTED )
         return false;
 
+    WiFiClientSecure *client = poll ? pollClient : telegramClient;
     // Start connection with Telegramn server (if necessary)
-    if(! telegramClient->connected() ){
-        // try to connect
-        if (!telegramClient->connect(telegramServerIP, TELEGRAM_PORT)) {            // no way, try to connect with hostname
-            if (!telegramClient->connect(TELEGRAM_HOST, TELEGRAM_PORT))
-                Serial.printf("Unable to connect to Telegram server\n");
-            else {
-                log_debug("\nConnected using Telegram hostname\n");
-			}
-        }
-        else log_debug("\nConnected using Telegram ip address\n");
+    if(! client->connected() ){
+        // Replies to requests sent with previous connection will never arrive
+        if (!poll)
+            clearReplies();
+#if defined(ESP8266)
+        else
+            m_pollParser.reset();
+#endif
+        connectClient(client);
     }
-    return telegramClient->connected();
+    return client->connected();
 }
 
 // bool AsyncTelegram::checkConnection(){
@@ -726,70 +1726,260 @@ bool AsyncTelegram::sendPhotoByFile(const uint32_t& chat_id, const String& fileN
 bool AsyncTelegram::sendMultipartFormData( const String& command,  const uint32_t& chat_id, const String& fileName,
                                            const char* contentType, const char* binaryPropertyName, fs::FS& fs )
 {
-
-    #define BOUNDARY            "----WebKitFormBoundary7MA4YWxkTrZu0gW"
-    #define END_BOUNDARY        "\r\n--" BOUNDARY "--\r\n"
+    LOCK_BOT();
+    if (!uploadIdle(chat_id))
+        return false;
 
     File myFile = fs.open("/" + fileName, "r");
     if (!myFile) {
         Serial.printf("Failed to open file %s\n", fileName.c_str());
         return false;
     }
+    return m_upload.begin(command.c_str(), chat_id, myFile, fileName.c_str(), contentType, binaryPropertyName);
+}
 
-    if (telegramClient->connected()) {
-        String formData;
-        formData += "--" BOUNDARY;
-        formData += "\r\nContent-disposition: form-data; name=\"chat_id\"\r\n\r\n";
-        formData += String(chat_id);
-        formData += "\r\n--" BOUNDARY;
-        formData += "\r\nContent-disposition: form-data; name=\"";
-        formData += binaryPropertyName;
-        formData += "\"; filename=\"";
-        formData += fileName;
-        formData += "\"\r\nContent-Type: ";
-        formData += contentType;
-        formData += "\r\n\r\n";
-
-        String uri = "POST /bot";
-        uri += m_token;
-        uri += "/";
-        uri += command;
-        uri += " HTTP/1.1";
-        // Send POST request to host
-        telegramClient->println(uri);
-        // Headers
-        telegramClient->println("Host: " TELEGRAM_HOST);
-        telegramClient->print("Content-Length: ");
-        int contentLength = myFile.size() + formData.length() + String(END_BOUNDARY).length();
-        telegramClient->println(String(contentLength));
-        telegramClient->print("Content-Type: multipart/form-data; boundary=");
-        telegramClient->println(BOUNDARY);
-        telegramClient->println();
-        // Body of request
-        telegramClient->print(formData);
-
-        uint8_t buff[BLOCK_SIZE];
-        uint16_t count = 0;
-        while (myFile.available()) {
-            yield();
-            buff[count++] = myFile.read();
-            if (count == BLOCK_SIZE ) {
-                Serial.println(F("Sending binary photo full buffer"));
-                telegramClient->write((const uint8_t *)buff, BLOCK_SIZE);
-                count = 0;
-            }
+
+bool AsyncTelegram::downloadFile(TBDocument &doc, fs::FS &fs, const char* path, bool resume)
+{
+    if (doc.file_path[0] == '\0' && !getFile(doc))
+        return false;
+
+    // Go on with a partial file (if any)
+    uint32_t offset = 0;
+    if (resume && fs.exists(path)) {
+        File partial = fs.open(path, "r");
+        offset = partial.size();
+        partial.close();
+        if (doc.file_size > 0 && offset >= (uint32_t) doc.file_size)
+            offset = 0;
+    }
+    File file = fs.open(path, offset > 0 ? "a" : "w");
+    if (!file) {
+        Serial.printf("Failed to open file %s\n", path);
+        return false;
+    }
+    bool ok = downloadFile(doc, [&file](const uint8_t* data, size_t len) {
+        return file.write(data, len) == len;
+    }, offset);
+    file.close();
+    return ok;
+}
+
+
+bool AsyncTelegram::downloadFile(TBDocument &doc, DownloadCallback callback, uint32_t offset)
+{
+    if (doc.file_path[0] == '\0' && !getFile(doc))
+        return false;
+    // Only the path is needed: file is requested with the bot connection
+    const char* path = strstr(doc.file_path, "/file/bot");
+    if (path == nullptr)
+        return false;
+    LOCK_BOT();
+#if defined(ESP32)
+    // http task must wait until download is completed
+    ConnectionLock lock(clientMutex());
+#endif
+
+    m_downloadStats = DownloadStats();
+    uint32_t start = millis();
+    uint8_t buff[BLOCK_SIZE];
+
+    for (uint8_t attempt = 0; attempt <= DOWNLOAD_RETRIES; attempt++) {
+        if (attempt > 0) {
+            log_debug("Download interrupted at %u bytes, resume\n", offset);
+            m_downloadStats.resumed++;
+        }
+        // Body of upload in progress must be completed before a new request can be written
+        processUpload(true);
+        if (!checkConnection())
+            continue;
+
+        String request;
+        request.reserve(BUFFER_SMALL);
+        request = "GET ";
+        request += path;
+        request += " HTTP/1.1" "\r\nHost: api.telegram.org" "\r\nConnection: keep-alive";
+        if (offset > 0) {
+            request += "\r\nRange: bytes=";
+            request += offset;
+            request += "-";
         }
-        if (count > 0) {
-            Serial.println(F("Sending binary photo remaining buffer"));
-            telegramClient->write((const uint8_t *)buff, count);
+        request += "\r\n\r\n";
+        telegramClient->print(request);
+        m_repliesInFlight++;
+        if (!waitReply(SERVER_TIMEOUT + (!m_dualConnection && httpData.waitingReply ? m_pollTimeout * 1000UL : 0)))
+            continue;
+
+        // With 200 instead of 206 server has ignored Range: skip data already received
+        uint32_t skip = 0;
+        int status = m_httpParser->statusCode();
+        if (status == 200)
+            skip = offset;
+        else if (status != 206) {
+            log_error("Download error %d\n", status);
+            finishReply();
+            return status == 416 && doc.file_size > 0 && offset == (uint32_t) doc.file_size;
+        }
+
+        uint32_t lastData = millis();
+        while (millis() - lastData < SERVER_TIMEOUT) {
+            int len = m_httpParser->readBody(*telegramClient, buff, BLOCK_SIZE);
+            if (len < 0)
+                break;
+            if (len == 0) {
+                yield();
+                continue;
+            }
+            lastData = millis();
+            uint32_t skipped = skip < (uint32_t) len ? skip : len;
+            skip -= skipped;
+            if (len > (int) skipped) {
+                if (!callback(buff + skipped, len - skipped)) {
+                    // Aborted: the rest of the body will not be read
+                    telegramClient->stop();
+                    clearReplies();
+                    return false;
+                }
+                offset += len - skipped;
+                m_downloadStats.bytes += len - skipped;
+            }
         }
 
-        telegramClient->print(END_BOUNDARY);
-        myFile.close();
+        if (m_httpParser->complete()) {
+            finishReply();
+            m_downloadStats.time = millis() - start;
+            if (m_downloadStats.time > 0)
+                m_downloadStats.bytesPerSecond = (uint64_t) m_downloadStats.bytes * 1000 / m_downloadStats.time;
+            log_debug("Downloaded %u bytes in %u ms (%u B/s)\n", m_downloadStats.bytes, m_downloadStats.time, m_downloadStats.bytesPerSecond);
+            return true;
+        }
+        // Connection lost or stalled: a new connection is needed
+        telegramClient->stop();
+        clearReplies();
     }
-    else {
-        Serial.println("\nError: client not connected");
+    log_error("Download failed at %u bytes\n", offset);
+    return false;
+}
+
+
+bool AsyncTelegram::sendPhoto(int64_t chat_id, const uint8_t* data, uint32_t size, const char* fileName)
+{
+    LOCK_BOT();
+    return uploadIdle(chat_id) && m_upload.begin("sendPhoto", chat_id, data, size, fileName, "image/jpeg", "photo");
+}
+
+
+bool AsyncTelegram::sendPhoto(int64_t chat_id, Stream &stream, uint32_t size, const char* fileName)
+{
+    LOCK_BOT();
+    return uploadIdle(chat_id) && m_upload.begin("sendPhoto", chat_id, stream, size, fileName, "image/jpeg", "photo");
+}
+
+
+bool AsyncTelegram::sendDocument(int64_t chat_id, const uint8_t* data, uint32_t size, const char* fileName, const char* contentType)
+{
+    LOCK_BOT();
+    return uploadIdle(chat_id) && m_upload.begin("sendDocument", chat_id, data, size, fileName, contentType, "document");
+}
+
+
+bool AsyncTelegram::sendDocument(int64_t chat_id, Stream &stream, uint32_t size, const char* fileName, const char* contentType)
+{
+    LOCK_BOT();
+    return uploadIdle(chat_id) && m_upload.begin("sendDocument", chat_id, stream, size, fileName, contentType, "document");
+}
+
+
+bool AsyncTelegram::sendDocument(int64_t chat_id, UploadProducer producer, const char* fileName, const char* contentType)
+{
+    LOCK_BOT();
+    return uploadIdle(chat_id) && m_upload.begin("sendDocument", chat_id, producer, fileName, contentType, "document");
+}
+
+
+bool AsyncTelegram::uploadIdle(int64_t chatId)
+{
+    m_upload.update();
+    if (m_upload.state() != UploadIdle) {
+        log_error("Previous upload not finished yet\n");
         return false;
     }
+    // Keep the order of text and files sent to the chat
+    flushCoalesced(chatId);
+    m_uploadAfter = m_commandQueue.tail();
     return true;
 }
+
+
+void AsyncTelegram::processUpload(bool flush)
+{
+#if defined(ESP8266)
+    if (m_upload.pending()) {
+        if (!checkConnection()) {
+            m_upload.finish(false);
+            return;
+        }
+        // Reply will be received in the same order of other requests
+        m_upload.writeHeaders(*telegramClient, m_token);
+        m_uploadReplyIndex = m_repliesInFlight;
+        m_repliesInFlight++;
+    }
+    while (m_upload.sending()) {
+        if (!m_upload.writeBlock(*telegramClient)) {
+            if (m_upload.state() == UploadFailed) {
+                // Request is truncated: connection can't be reused
+                telegramClient->stop();
+                clearReplies();
+            }
+            break;
+        }
+        if (!flush)
+            break;
+        yield();
+    }
+#endif
+    if (!flush)
+        m_upload.update();
+}
+
+
+void AsyncTelegram::sendUpload(WiFiClientSecure *client)
+{
+    if (!client->connected() && !connectClient(client)) {
+        m_upload.finish(false);
+        return;
+    }
+    m_upload.writeHeaders(*client, m_token);
+    while (m_upload.writeBlock(*client))
+        delay(1);
+    if (m_upload.state() == UploadFailed) {
+        client->stop();
+        return;
+    }
+
+    HttpResponseParser parser;
+    uint32_t start = millis();
+    while (!parser.parseHeaders(*client)) {
+        if (millis() - start > SERVER_TIMEOUT || !client->connected()) {
+            log_error("No reply from server\n");
+            client->stop();
+            m_upload.finish(false);
+            return;
+        }
+        delay(1);
+    }
+
+    StaticJsonDocument<64> filter;
+    filter["ok"] = true;
+    filter["description"] = true;
+    StaticJsonDocument<BUFFER_SMALL> doc;
+    HttpBodyStream body(parser, *client);
+    DeserializationError error = deserializeJson(doc, body, DeserializationOption::Filter(filter));
+    bool ok = !error && doc["ok"].as<bool>();
+    if (!ok)
+        log_error("Server reply %d: %s\n", parser.statusCode(), doc["description"] | error.c_str());
+    parser.skipBody(*client);
+    if (!parser.complete() || !parser.keepAlive())
+        client->stop();
+    m_upload.finish(ok);
+}
@@ -11,12 +11,11 @@
 #if defined(ESP32)
     #include <HTTPClient.h>
     #include <WiFiClientSecure.h>
-    #define BLOCK_SIZE          4096        // More memory, increase block size to speed-up a little upload
 #elif defined(ESP8266)
-    #define BLOCK_SIZE          2048
     #include <ESP8266WiFi.h>
     #include <ESP8266HTTPClient.h>
     #include <WiFiClientSecure.h>
+    #include <Ticker.h>
 #else
     #error "This library work only with ESP8266 or ESP32"
 #endif
@@ -29,10 +28,28 @@
 #define USE_FINGERPRINT     0           // use Telegram fingerprint server validation
 #define SERVER_TIMEOUT      10000
 #define MIN_UPDATE_TIME     500
+#define SHORT_POLL_TIMEOUT  3           // getUpdates server side timeout (s) with short polling
+#define LONG_POLL_TIMEOUT   50          // default getUpdates server side timeout (s) with long polling
+#define ADAPTIVE_IDLE_TIME  30000       // with PollAdaptive, switch to long polling after this time (ms) without updates or messages sent
+#define MAX_UPDATES_BATCH   8           // capacity of pending updates buffer (each update reserve BUFFER_BIG bytes)
+#define DOWNLOAD_RETRIES    3           // requests sent to resume an interrupted download
+#define EVENTS_INTERVAL     20          // ms between two checks of event driver while there is work to do
+#define EVENTS_MAX_WAIT     1000        // ms event task can sleep waiting for a reply (ESP32)
+#define PARSE_QUEUE_SIZE    4           // decoded updates waiting for loop task in pipelined mode (ESP32)
 
 #include "DataStructures.h"
+#include "CommandQueue.h"
+#include "HttpResponseParser.h"
+#include "MultipartUpload.h"
+#include "RateLimiter.h"
+#include "MessageCoalescer.h"
+#include "RequestWriter.h"
 #include "InlineKeyboard.h"
 #include "ReplyKeyboard.h"
+#include "StaticKeyboard.h"
+#include "CommandRouter.h"
+#include "UpdateRecord.h"
+#include "TelegramConnection.h"
 #include "Utilities.h"
 #include "serial_log.h"
 #include "ca_cert.h"
@@ -89,13 +106,123 @@ public:
     //    pollingTime: interval time in milliseconds
     void setUpdateTime(uint32_t pollingTime) { m_minUpdateTime = pollingTime;}
 
-    // Get file link and size by unique document ID
+    // set how many updates can be fetched from server with a single getUpdates request.
+    // Updates received are stored in a buffer and handed out one by one with getNewMessage(),
+    // so the next request to server is sent only when all pending updates were read.
+    // params:
+    //    batchSize: max number of updates for each request (1 - MAX_UPDATES_BATCH)
+    void setUpdateBatch(uint8_t batchSize);
+
+    // set the polling strategy used to get updates from server.
+    // With long polling a new getUpdates request is sent as soon as the previous one was answered,
+    // and the server holds it until an update is available or timeout expires.
+    // Keep in mind that an outstanding long poll request will delay other commands sent with
+    // the same connection, so PollAdaptive use short polling while there is recent activity.
+    // params:
+    //    mode   : PollShort, PollLong or PollAdaptive
+    //    timeout: server side timeout in seconds for long polling (max LONG_POLL_TIMEOUT)
+    void setPollMode(PollMode mode, uint16_t timeout = LONG_POLL_TIMEOUT);
+
+    // set what to do when a command is sent while the outbound queue is full (ESP32 only).
+    // Commands are sent from http task in the same order they were queued.
+    // params:
+    //    policy: QueueReject (default), QueueDropOldest or QueueBlock
+    inline void setQueuePolicy(QueuePolicy policy) { m_queuePolicy = policy; }
+
+    // use a dedicated connection (and on ESP32 a dedicated task) for getUpdates requests,
+    // so commands sent never wait behind an outstanding (long) poll request.
+    // Each connection need its own TLS context: check getConnectionHeap() for the cost.
+    // Must be called before begin()
+    // params:
+    //    enable: true -> two connections, false -> single connection (default)
+    void setDualConnection(bool enable);
+
+#if defined(ESP32)
+    // use a connection (and its http task) shared with other bots, instead of creating a new one.
+    // Must be called before begin(). Dual connection and long polling are not used with a shared connection
+    // returns:
+    //    false if connection is already used by MAX_SHARED_BOTS bots
+    inline bool setConnection(TelegramConnection &connection) {
+        if (!connection.attach(this))
+            return false;
+        m_connection = &connection;
+        return true;
+    }
+#endif
+
+    // heap memory (bytes) used by a connection as measured in begin(),
+    // including TLS context and on ESP32 the stack of its task
+    // params:
+    //    poll: true -> dedicated getUpdates connection, false -> main connection
+    inline uint32_t getConnectionHeap(bool poll = false) const { return m_connectionHeap[poll ? 1 : 0]; }
+
+    // get counters and duration of TLS handshakes done with Telegram server.
+    // Only ESP8266 can resume a previous TLS session, with ESP32 all handshakes are full.
+    inline TLSStats getTLSStats() const { return m_tlsStats; }
+
+    // ESP32 only: deserialize and decode getUpdates replies in a dedicated parse task (on core 0),
+    // which puts fixed-size records in a queue. getNewMessage() just takes the next record,
+    // so JSON parsing never runs on loop task. Strings longer than UPDATE_RECORD_STRINGS are truncated.
+    // Must be called before begin()
+    // params:
+    //    enable: true -> pipelined mode, false -> replies parsed in getNewMessage() (default)
+    inline void setPipelined(bool enable) { m_pipelined = enable; }
+
+    // get the time spent in each stage of pipelined mode
+    inline PipelineStats getPipelineStats() const { return m_pipelineStats; }
+
+    // enable/disable the scheduler of messages sent to chats, according to Telegram flood limits
+    // (about 30 messages/s, 1 message/s for each chat and 20 messages/minute for each group).
+    // Messages exceeding the limits, or rejected by server with 429 error, are sent later
+    // while getNewMessage() is called (send functions return false if the message can't be queued).
+    // Default value is true (enabled)
+    inline void setRateLimit(bool enable) { m_rateLimit = enable; }
+
+    // merge text messages sent to the same chat within a time window in a single message
+    // (up to MAX_MESSAGE_LENGTH bytes, longer text is split at UTF-8 boundaries, outside HTML/MarkdownV2 entities).
+    // Only messages without keyboard and with the same parse mode are merged; any other command
+    // or upload sent to the chat flush the merged text before, so the order is kept
+    // params:
+    //    window: merging time window in milliseconds (0 = disabled, default)
+    inline void setCoalesceWindow(uint32_t window) { m_coalescer.setWindow(window); }
+
+    // get counters of rate limited messages
+    inline RateStats getRateStats() const { return m_rateLimiter.getStats(); }
+
+    // get counters of outbound command queue (ESP32 only)
+    inline QueueStats getQueueStats() const { return m_commandQueue.getStats(); }
+
+    // Get file link and size by unique document ID (getNewMessage() leaves file_path empty:
+    // downloadFile() calls this when needed)
     // params
     //   doc   : document structure
     // returns
     //   true if no error
     bool getFile(TBDocument &doc);
 
+    // download a file sent to bot (i.e. msg.document) with the bot connection, in blocks of BLOCK_SIZE bytes.
+    // If transfer is interrupted, it's resumed from last byte received with a HTTP Range request.
+    // params
+    //   doc     : document structure (file_path is requested with getFile() if empty)
+    //   callback: function called with each block received (i.e. write to Update), return false to abort
+    //   offset  : bytes already received (i.e. with a previous download)
+    // returns
+    //   true if the whole file was received
+    bool downloadFile(TBDocument &doc, DownloadCallback callback, uint32_t offset = 0);
+
+    // download a file sent to bot and save in filesystem
+    // params
+    //   doc   : document structure
+    //   fs    : the filesystem where file will be saved
+    //   path  : the full path of file
+    //   resume: if a partial file already exists, download only the missing part
+    // returns
+    //   true if the whole file was saved
+    bool downloadFile(TBDocument &doc, fs::FS &fs, const char* path, bool resume = true);
+
+    // size, duration and throughput of last download
+    inline DownloadStats getDownloadStats() const { return m_downloadStats; }
+
     // use the URL style address "api.telegram.org" or the fixed IP address "149.154.167.198"
     // for all communication with the telegram server
     // Default value is true
@@ -117,60 +244,89 @@ public:
     // get the first unread message from the queue (text and query from inline keyboard).
     // This is a destructive operation: once read, the message will be marked as read
     // so a new getMessage will read the next message (if any).
+    // Strings in message point to a per-bot buffer and are valid until next call of getNewMessage().
     // params
     //   message: the data structure that will contains the data retrieved
     // returns
     //   MessageNoData: an error has occurred
     //   MessageText  : the received message is a text
     //   MessageQuery : the received message is a query (from inline keyboards)
+    // Messages with a registered handler (addCommand(), onText(), ...) are handled here and
+    // MessageNoData is returned
     MessageType getNewMessage(TBMessage &message);
 
+    // Event handlers, called as soon as an update of that type has been received and parsed,
+    // without calling getNewMessage() from loop(). Once a handler is set, updates are handed out
+    // by a dedicated task with ESP32 (handlers run in that task) and by a function scheduled
+    // after loop() with ESP8266. Messages of a type without handler are discarded.
+    inline void onText(MessageHandler handler)      { setHandler(MessageText, handler); }
+    inline void onQuery(MessageHandler handler)     { setHandler(MessageQuery, handler); }
+    inline void onLocation(MessageHandler handler)  { setHandler(MessageLocation, handler); }
+    inline void onContact(MessageHandler handler)   { setHandler(MessageContact, handler); }
+    inline void onDocument(MessageHandler handler)  { setHandler(MessageDocument, handler); }
+    inline void onReply(MessageHandler handler)     { setHandler(MessageReply, handler); }
+
+    // register the handler called by getNewMessage() when a slash command is received.
+    // Command is matched case insensitive, also as "/command@botname" (if addressed to this bot).
+    // params
+    //   command: the command, i.e. "/light"
+    //   handler: function called with the message and its arguments split on white spaces
+    // returns
+    //   false if command is not valid (letters, digits and '_' only, up to 32 characters)
+    bool addCommand(const char* command, CommandHandler handler);
+
     // send a message to the specified telegram user ID
     // params
     //   msg      : the TBMessage telegram recipient with user ID
     //   message : the message to send
     //   keyboard: the inline/reply keyboard (optional)
     //             (in json format or using the inlineKeyboard/ReplyKeyboard class helper)
-    void sendMessage(const TBMessage &msg, const char* message, String keyboard = "");
+    // returns
+    //   true if the message was handed over to the send path (queued, scheduled or sent)
+    bool sendMessage(const TBMessage &msg, const char* message, const String &keyboard = "");
 
     // sendMessage function overloads
-    inline void sendMessage(const TBMessage &msg, String &message, String keyboard = "")
+    inline bool sendMessage(const TBMessage &msg, String &message, const String &keyboard = "")
     {
         return sendMessage(msg, message.c_str(), keyboard);
     }
 
-    inline void sendMessage(const TBMessage &msg, const char* message, InlineKeyboard &keyboard)
-    {
-	m_inlineKeyboard = keyboard;
-        return sendMessage(msg, message, keyboard.getJSON());
-    }
+    bool sendMessage(const TBMessage &msg, const char* message, InlineKeyboard &keyboard);
 
-    inline void sendMessage(const TBMessage &msg, const char* message, ReplyKeyboard &keyboard) {
-        return sendMessage(msg, message, keyboard.getJSON());
+    // send a message with a keyboard declared at compile time (JSON is read straight from flash).
+    // Keyboard is not copied, so it must be static or global
+    bool sendMessage(const TBMessage &msg, const char* message, const StaticKeyboard &keyboard);
+
+    inline bool sendMessage(const TBMessage &msg, const char* message, ReplyKeyboard &keyboard) {
+        return sendMessageMarkup(msg, message, keyboard.getJSON().c_str());
     }
 
     // Send message to a channel. This bot must be in the admin group
-    void sendToChannel(const char*  &channel, String &message, bool silent) ;
+    bool sendToChannel(const char*  &channel, String &message, bool silent) ;
 
     // Send message to a specific user. In order to work properly two conditions is needed:
     //  - You have to find the userid (for example using the bot @JsonBumpBot  https://t.me/JsonDumpBot)
     //  - User has to start your bot in it's own client. For example send a message with @<your bot name>
-    void sendTo(const int32_t userid, String &message, String keyboard = "") ;
+    bool sendTo(const int32_t userid, const char* message, String keyboard = "") ;
+
+    inline bool sendTo(const int32_t userid, String &message, String keyboard = "") {
+        return sendTo(userid, message.c_str(), keyboard);
+    }
 
 	// Backward compatibility.
-	inline void sendToUser(const int32_t userid, String &message, String keyboard = "")  __attribute__ ((deprecated))
+	inline bool sendToUser(const int32_t userid, String &message, String keyboard = "")  __attribute__ ((deprecated))
 	{
-		sendTo(userid, message, keyboard);
+		return sendTo(userid, message, keyboard);
 	}
-	inline void sendToGroup(const int32_t userid, String &message, String keyboard = "")  __attribute__ ((deprecated))
+	inline bool sendToGroup(const int32_t userid, String &message, String keyboard = "")  __attribute__ ((deprecated))
 	{
-		sendTo(userid, message, keyboard);
+		return sendTo(userid, message, keyboard);
 	}
 
-    void sendPhotoByUrl(const uint32_t& chat_id,  const String& url, const String& caption);
+    bool sendPhotoByUrl(const uint32_t& chat_id,  const String& url, const String& caption);
 
-	inline void sendPhotoByUrl(const TBMessage &msg,  const String& url, const String& caption){
-		sendPhotoByUrl(msg.sender.id, url, caption);
+	inline bool sendPhotoByUrl(const TBMessage &msg,  const String& url, const String& caption){
+		return sendPhotoByUrl(msg.sender.id, url, caption);
 	}
 
     bool sendPhotoByFile(const uint32_t& chat_id,  const String& fileName, fs::FS& filesystem);
@@ -179,6 +335,46 @@ public:
         return sendPhotoByFile(msg.sender.id, fileName, filesystem );
     }
 
+    // send a photo or a document stored in memory (i.e. camera_fb_t buffer) or read from a stream.
+    // Bytes go from buffer/stream to the connection without a copy in flash: data must be valid
+    // until the upload callback is called with UploadDone or UploadFailed state
+    // params
+    //   chat_id    : the recipient chat
+    //   data/stream: the source of data
+    //   size       : number of bytes to send
+    //   fileName   : the name of document showed in chat
+    //   contentType: the MIME type of document
+    // returns
+    //   true if upload was started
+    bool sendPhoto(int64_t chat_id, const uint8_t* data, uint32_t size, const char* fileName = "photo.jpg");
+    bool sendPhoto(int64_t chat_id, Stream &stream, uint32_t size, const char* fileName = "photo.jpg");
+    bool sendDocument(int64_t chat_id, const uint8_t* data, uint32_t size, const char* fileName,
+                      const char* contentType = "application/octet-stream");
+    bool sendDocument(int64_t chat_id, Stream &stream, uint32_t size, const char* fileName,
+                      const char* contentType = "application/octet-stream");
+
+    // send a document generated while it is uploaded (i.e. a CSV export of a log).
+    // Size is not needed: body is sent with chunked transfer encoding, one block at time,
+    // so RAM used doesn't depend on size of document.
+    // params
+    //   chat_id    : the recipient chat
+    //   producer   : function that fill next block of data (returns 0 at end of document).
+    //                With ESP32 it's called from http task
+    //   fileName   : the name of document showed in chat
+    //   contentType: the MIME type of document
+    // returns
+    //   true if upload was started
+    bool sendDocument(int64_t chat_id, UploadProducer producer, const char* fileName,
+                      const char* contentType = "text/plain");
+
+    // set the function called while a file is uploaded (sendPhotoByFile) and when upload ends.
+    // Upload is asynchronous: file must not be removed or modified until the callback
+    // is called with UploadDone or UploadFailed state
+    inline void setUploadCallback(UploadCallback callback) { m_upload.setCallback(callback); }
+
+    // state of current upload (UploadIdle if none)
+    inline UploadState getUploadState() const { return m_upload.state(); }
+
     // terminate a query started by pressing an inlineKeyboard button. The steps are:
     // 1) send a message with an inline keyboard
     // 2) wait for a <message> (getNewMessage) of type MessageQuery
@@ -188,7 +384,9 @@ public:
     //   message  : an optional message
     //   alertMode: false -> a simply popup message
     //              true --> an alert message with ok button
-    void endQuery(const TBMessage &msg, const char* message, bool alertMode = false);
+    // returns
+    //   true if the command was handed over to the send path
+    bool endQuery(const TBMessage &msg, const char* message, bool alertMode = false);
 
     // remove an active reply keyboard for a selected user, sending a message
     // params:
@@ -199,7 +397,7 @@ public:
     //                       2) if the bot's message is a reply (has reply_to_message_id), sender of the original message
     // return:
     //   true if no error occurred
-    void removeReplyKeyboard(const TBMessage &msg, const char* message, bool selective = false);
+    bool removeReplyKeyboard(const TBMessage &msg, const char* message, bool selective = false);
 
     // set if unsecure connection has to be used with telegram server.
     // This is for backwar compatibility, but using a root certificate is strongly suggested
@@ -208,8 +406,11 @@ public:
     }
 
     // Use this method to edit only the reply markup of messages.
-    void editMessageReplyMarkup(TBMessage &msg, String keyboard = "");
-    void editMessageReplyMarkup(TBMessage &msg, InlineKeyboard &keyboard);
+    // returns
+    //   true if the command was handed over to the send path
+    bool editMessageReplyMarkup(TBMessage &msg, const String &keyboard = "");
+    bool editMessageReplyMarkup(TBMessage &msg, InlineKeyboard &keyboard);
+    bool editMessageReplyMarkup(TBMessage &msg, const StaticKeyboard &keyboard);
 
 
     void setClock(const char* TZ, uint32_t maxTime = 5000);
@@ -218,32 +419,123 @@ public:
 
 private:
     IPAddress telegramServerIP;
-    StaticJsonDocument<BUFFER_SMALL> smallDoc;
+    JsonDocument*   m_replyDoc = nullptr;       // replies of blocking commands (of the connection if shared)
     const char*     m_token;
     const char*     m_botName;
-    int32_t         m_lastUpdate = 0;
+    std::atomic<int32_t> m_lastUpdate{0};
     uint32_t        m_lastUpdateTime;
     uint32_t        m_minUpdateTime = 2000;
+    uint8_t         m_batchSize = 1;
+
+    PollMode        m_pollMode = PollShort;
+    uint16_t        m_longPollTimeout = LONG_POLL_TIMEOUT;
+    uint16_t        m_pollTimeout = SHORT_POLL_TIMEOUT;     // timeout of last getUpdates request sent
+    uint32_t        m_lastActivity = 0;
+
+    // Last getUpdates reply and ring buffer with updates not yet handed out with getNewMessage().
+    // This is also the arena where TBMessage strings are stored (allocated when first reply is parsed)
+    DynamicJsonDocument m_updatesDoc;
+    JsonObject      m_pendingUpdates[MAX_UPDATES_BATCH];
+    uint8_t         m_pendingHead = 0;
+    uint8_t         m_pendingCount = 0;
 
     bool            m_useDNS = false;
     bool            m_UTF8Encoding = false;
     bool            m_insecure = true;
     uint8_t         m_fingerprint[20];
-    TBUser          m_user;
 
     InlineKeyboard  m_inlineKeyboard;   // last inline keyboard showed in bot
+    const StaticKeyboard* m_staticKeyboard = nullptr;   // or last static keyboard showed
+    CommandRouter   m_commands;
+
+    // Event driven API
+    MessageHandler  m_handlers[MessageReply + 1];
+    bool            m_ready = false;                // begin() has been completed
+    bool            m_eventsStarted = false;
+    std::atomic<bool> m_dispatching{false};         // updates are being handed out
 
     // Struct for store telegram server reply and infos about it
     HttpServerReply httpData;
 
+    // Framing of replies read directly from telegramClient (blocking commands and ESP8266),
+    // of the connection if shared
+    HttpResponseParser* m_httpParser = nullptr;
+    uint8_t         m_repliesInFlight = 0;      // requests sent whose reply was not read yet
+    uint8_t         m_updateReplyIndex = 0;     // replies to be read before getUpdates one
+    uint8_t         m_uploadReplyIndex = 0;     // replies to be read before upload one
+    uint32_t        m_uploadAfter = 0;          // command queue position to be sent before upload (ESP32)
+
+    // File upload sent one block at time
+    MultipartUpload m_upload;
+
+    // Commands waiting to be sent from httpPostTask
+    CommandQueue    m_commandQueue;
+    QueuePolicy     m_queuePolicy = QueueReject;
+
+    // Text messages merged before sending
+    MessageCoalescer m_coalescer;
+
+    // Messages to chats wait here for their turn
+    bool            m_rateLimit = true;
+    RateLimiter     m_rateLimiter;
+    uint32_t        m_rateReplyMask = 0;        // replies in flight that belong to rate limited messages (ESP8266)
+
+    // Dedicated getUpdates connection
+    bool            m_dualConnection = false;
+    uint32_t        m_connectionHeap[2] = {0, 0};
+
+    TLSStats        m_tlsStats;
+    DownloadStats   m_downloadStats;
+    bool            m_pipelined = false;
+    PipelineStats   m_pipelineStats = {0, 0, 0, 0, 0, 0, 0};
+
 #if defined(ESP32)
     // WiFiClientSecure telegramClient;
-    WiFiClientSecure *telegramClient;
-    TaskHandle_t taskHandler;
+    WiFiClientSecure *telegramClient = nullptr;
+    WiFiClientSecure *pollClient = nullptr;
+    TaskHandle_t taskHandler = nullptr;
+    TaskHandle_t pollTaskHandler = nullptr;
+    std::atomic<bool> m_pollReconnect{false};       // poll task must close pollClient (reset)
+    CommandQueue*   m_pollQueue = nullptr;          // getUpdates for poll task (allocated by begin())
+
+    // Exclusive use of telegramClient, shared by http task and loop task (blocking commands, downloads).
+    // Created by begin(), shared bots use the one of the connection
+    SemaphoreHandle_t m_clientMutex = nullptr;
+
+    // Loop task and event task use the bot one at time (recursive: handlers can call any method)
+    SemaphoreHandle_t m_botMutex = nullptr;
+    inline SemaphoreHandle_t clientMutex() const { return m_connection != nullptr ? m_connection->m_mutex : m_clientMutex; }
+
+    // Parameters of http tasks (same code for outbound commands and getUpdates)
+    struct HttpTaskArgs {
+        AsyncTelegram*  bot;
+        bool            poll;
+    };
+    HttpTaskArgs    m_sendTaskArgs = {this, false};
+    HttpTaskArgs    m_pollTaskArgs = {this, true};
+
+    // Commands rejected by server with 429 error, to be sent again by loop task (allocated by http task)
+    std::atomic<CommandQueue*> m_retryQueue{nullptr};
+    std::atomic<uint32_t> m_retryAfter{0};
+
+    // Task that runs event handlers, woken up by http task when updates are received
+    TaskHandle_t    m_eventTask = nullptr;
+    static void eventTask(void *args);
+    uint32_t eventsWaitTime();
+
+    // Pipelined mode: http task -> parse task -> queue of decoded updates -> loop task
+    TaskHandle_t    m_parseTask = nullptr;
+    QueueHandle_t   m_updateQueue = nullptr;
+    UpdateRecord*   m_parseRecord = nullptr;    // record being filled by parse task (allocated by begin())
+    UpdateRecord*   m_record = nullptr;         // strings of last message handed out
+    static void parseTask(void *args);
 #elif defined(ESP8266)
-    BearSSL::WiFiClientSecure* telegramClient;
+    BearSSL::WiFiClientSecure* telegramClient = nullptr;
+    BearSSL::WiFiClientSecure* pollClient = nullptr;
+    HttpResponseParser m_pollParser;
     BearSSL::Session*   m_session;
     BearSSL::X509List*  m_cert;
+    Ticker          m_eventTicker;
 #endif
 
     // send commands to the telegram server. For info about commands, check the telegram api https://core.telegram.org/bots/api
@@ -255,6 +547,20 @@ private:
     //   a string containing the Telegram JSON response
     bool postCommand(const char* const& command, const char* const& param, bool blocking = false);
 
+    // write a JSON POST request for the command on the selected connection
+    void writeRequest(WiFiClientSecure *client, const char* command, const char* param);
+
+    // write request line and headers of a JSON POST request with a body of length bytes
+    void writeHeaders(Print &out, const char* command, size_t length);
+
+#if defined(ESP8266)
+    // send a request on telegramClient writing the body straight to the socket (sizing pass first)
+    bool postRequest(const char* command, const RequestBody &body);
+#endif
+
+    // create a new client with the TLS options selected
+    WiFiClientSecure* newClient();
+
 
     /*  postCommand() must be a blocking function. It will send an http request to server and wait for reply.
         Keeping connection with server opened, we can save a lot of time but with ESP32 we can start
@@ -265,23 +571,121 @@ private:
     */
     static void httpPostTask(void *args);
 
-    // helper function used to select the properly working mode with ESP8266/ESP32
-    void sendCommand(const char* const&  command, const char* const& param);
+#if defined(ESP32)
+    friend class TelegramConnection;
 
+    // Shared connection (nullptr if this bot has its own)
+    TelegramConnection* m_connection = nullptr;
 
-    // upload documents to Telegram server https://core.telegram.org/bots/api#sending-files
+    // send the upload pending or the next command in queue (http task or shared connection task)
     // params
-    //   command   : the command to send, i.e. getMe
+    //   poll  : use getUpdates queue (dual connection)
+    //   closed: set if server has closed the connection
+    // returns
+    //   true if a request was sent
+    bool serveRequest(HTTPClient &https, WiFiClientSecure *client, bool poll, String &command, String &param, bool &closed);
+#endif
+
+    // helper function used to select the properly working mode with ESP8266/ESP32.
+    // Messages to chats go through the rate limiter
+    // returns
+    //   false if command was discarded (outbound queue full)
+    bool sendCommand(const char* const&  command, const char* const& param);
+
+    // same as above, with body written by a RequestWriter (chatId is 0 if not sent to a chat)
+    bool sendCommand(const char* command, int64_t chatId, const RequestBody &body);
+
+    // send the command immediately (ESP8266) or put in outbound queue (ESP32)
+    bool dispatchCommand(const char* const&  command, const char* const& param);
+
+    // hand over to the send path the rate limited messages that can be sent now
+    void sendScheduled();
+
+    // merge a text message with the previous ones sent to the same chat
+    bool coalesceMessage(int64_t chatId, const char* text, ParseMode parseMode, bool silent);
+
+    // send the text merged for a chat and release its buffer
+    bool sendCoalesced(CoalescedMessage *message);
+
+    // send text merged for a chat (if any), before a command to the same chat
+    bool flushCoalesced(int64_t chatId);
+
+    // set the handler of a message type and start the event driver
+    void setHandler(MessageType type, MessageHandler handler);
+    void startEvents();
+
+    // hand out all the updates received to the event handlers
+    void dispatchEvents();
+
+    // get next update received (polling server if none is pending) and run keyboard callbacks
+    MessageType nextMessage(TBMessage &message);
+
+    // take next update received from the ring buffer and fill message
+    MessageType decodeUpdate(TBMessage &message);
+
+    // true if some update received was not handed out yet
+    bool updatesPending();
+
+    // call the handler registered for a message
+    // returns
+    //   true if message was handled
+    bool handleMessage(const TBMessage &message);
+
+    // sendMessage and editMessageReplyMarkup with the keyboard JSON, copied verbatim in request
+    // (null if none, inFlash if it's a StaticKeyboard)
+    bool sendMessageMarkup(const TBMessage &msg, const char* message, const char* keyboard, bool inFlash = false);
+    bool editMessageMarkup(TBMessage &msg, const char* keyboard, bool inFlash = false);
+
+    // true if the reply for last getUpdates request can be parsed
+    bool replyReady();
+
+    // read replies received on telegramClient without waiting for more data.
+    // Replies to other commands are checked and discarded.
+    // returns
+    //   true when the headers of getUpdates reply were received and body can be parsed
+    bool readReplies();
+
+    inline bool isUpdateReply() { return !m_dualConnection && httpData.waitingReply && m_updateReplyIndex == 0; }
+
+    // wait for the reply to last request sent on telegramClient, skipping replies to previous ones
+    // returns
+    //   true when headers were received and body can be read
+    bool waitReply(uint32_t timeout);
+
+    // consume the rest of current reply, so the connection is ready for next one
+    void finishReply();
+
+    // forget all replies in flight (i.e. connection closed)
+    void clearReplies();
+
+
+    // start the upload of a document to Telegram server https://core.telegram.org/bots/api#sending-files
+    // params
+    //   command   : the command to send, i.e. sendPhoto
     //   chat_id   : the char to upload
     //   filename  : the name of document uploaded
     //   contentType  : the content type of document uploaded
     //   binaryPropertyName: the type of data
     // returns
-    //   true if no error
+    //   true if upload was started (progress and result are notified with upload callback)
     bool sendMultipartFormData( const String& command,  const uint32_t& chat_id,
                             const String& fileName, const char* contentType,
                             const char* binaryPropertyName, fs::FS& fs );
 
+    // notify the result of previous upload (if any) and send the text merged for the chat of the new one,
+    // which will be sent after the commands already queued
+    // returns
+    //   true if a new upload can start
+    bool uploadIdle(int64_t chatId);
+
+    // go on with current upload (ESP8266 write next block) and notify progress
+    // params
+    //   flush: write the whole remaining body without notify (a new request has to be written)
+    void processUpload(bool flush = false);
+
+    // send the whole upload and wait for the reply (ESP32 http task)
+    void sendUpload(WiFiClientSecure *client);
+
     // get some information about the bot
     // params
     //   user: the data structure that will contains the data retreived
@@ -289,7 +693,28 @@ private:
     //   true if no error occurred
     bool getMe(TBUser &user);
 
-    bool checkConnection();
+    // connect to server if necessary
+    // params
+    //   poll: true -> dedicated getUpdates connection, false -> main connection
+    bool checkConnection(bool poll = false);
+
+    // open a TLS connection with server and update handshake counters
+    bool connectClient(WiFiClientSecure *client);
+
+    // deserialize last getUpdates reply and push all updates received in pending buffer
+    // returns
+    //   true if at least one update was stored
+    bool parseUpdates();
+
+    // single pass parsers used by getNewMessage(): every member of the update is visited
+    // only once and the message type is classified while fields are filled
+    // returns
+    //   the type of message or MessageNoData if not supported
+    MessageType parseMessage(JsonObject msg, TBMessage &message);
+    MessageType parseCallbackQuery(JsonObject query, TBMessage &message);
+
+    // server side timeout (s) to be used for next getUpdates request, according to polling mode
+    uint16_t getPollTimeout();
 
     bool serverReply(const char* const&  replyMsg);
 
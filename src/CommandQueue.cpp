@@ -0,0 +1,101 @@
+#include "CommandQueue.h"
+
+#define QUEUE_MASK  (COMMAND_QUEUE_SIZE - 1)
+
+static_assert((COMMAND_QUEUE_SIZE & QUEUE_MASK) == 0, "COMMAND_QUEUE_SIZE must be a power of 2");
+
+
+CommandQueue::CommandQueue() : m_enqueuePos(0), m_dequeuePos(0), m_pushed(0), m_popped(0)
+{
+	for (uint32_t i = 0; i < COMMAND_QUEUE_SIZE; i++)
+		m_slots[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+
+bool CommandQueue::push(const char* command, const char* param, bool dropOldest, String *dropped)
+{
+	// Only one producer: enqueue position doesn't need compare and swap
+	uint32_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+	Slot *slot = &m_slots[pos & QUEUE_MASK];
+	if (slot->sequence.load(std::memory_order_acquire) != pos) {
+		// Queue full
+		if (!dropOldest) {
+			m_rejected++;
+			return false;
+		}
+		if (take(dropped, nullptr))
+			m_dropped++;
+		// Oldest slot is claimed now (by us or by consumer): wait until it is released
+		while (slot->sequence.load(std::memory_order_acquire) != pos)
+			yield();
+	}
+
+	slot->command = command;
+	slot->param = param;
+	slot->sequence.store(pos + 1, std::memory_order_release);
+	m_enqueuePos.store(pos + 1, std::memory_order_relaxed);
+	m_pushed.fetch_add(1, std::memory_order_relaxed);
+
+	uint8_t waiting = size();
+	if (waiting > m_highWater)
+		m_highWater = waiting;
+	return true;
+}
+
+
+bool CommandQueue::pop(String &command, String &param)
+{
+	if (take(&command, &param)) {
+		m_popped.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+	return false;
+}
+
+
+bool CommandQueue::take(String *command, String *param)
+{
+	uint32_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+	Slot *slot;
+	for (;;) {
+		slot = &m_slots[pos & QUEUE_MASK];
+		int32_t diff = (int32_t)(slot->sequence.load(std::memory_order_acquire) - (pos + 1));
+		if (diff == 0) {
+			// Slot is ready: try to claim it (producer could be dropping the same one)
+			if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (diff < 0)
+			return false;	// Queue empty
+		else
+			pos = m_dequeuePos.load(std::memory_order_relaxed);
+	}
+
+	// Copy instead of move, in order to keep the slot buffers allocated
+	if (command != nullptr)
+		*command = slot->command;
+	if (param != nullptr)
+		*param = slot->param;
+	slot->sequence.store(pos + COMMAND_QUEUE_SIZE, std::memory_order_release);
+	return true;
+}
+
+
+uint8_t CommandQueue::size() const
+{
+	uint32_t enqueued = m_enqueuePos.load(std::memory_order_acquire);
+	uint32_t dequeued = m_dequeuePos.load(std::memory_order_acquire);
+	return (uint8_t)(enqueued - dequeued);
+}
+
+
+QueueStats CommandQueue::getStats() const
+{
+	QueueStats stats;
+	stats.pushed = m_pushed.load(std::memory_order_relaxed);
+	stats.popped = m_popped.load(std::memory_order_relaxed);
+	stats.dropped = m_dropped;
+	stats.rejected = m_rejected;
+	stats.highWater = m_highWater;
+	return stats;
+}
@@ -0,0 +1,84 @@
+#ifndef COMMAND_QUEUE
+#define COMMAND_QUEUE
+
+#include <Arduino.h>
+#include <atomic>
+
+#ifndef COMMAND_QUEUE_SIZE
+#define COMMAND_QUEUE_SIZE      4       // number of commands that can wait to be sent (must be a power of 2)
+#endif
+
+enum QueuePolicy {
+	QueueReject     = 0,	// new command is discarded and the send function return false
+	QueueDropOldest = 1,	// oldest command not yet sent is discarded to make room for the new one
+	QueueBlock      = 2		// caller wait until a slot is free (up to SERVER_TIMEOUT)
+};
+
+struct QueueStats {
+	uint32_t pushed;		// commands stored in queue
+	uint32_t popped;		// commands taken from http task
+	uint32_t dropped;		// commands discarded with QueueDropOldest policy
+	uint32_t rejected;		// commands discarded because queue was full
+	uint8_t  highWater;		// max number of commands waiting at the same time
+};
+
+
+// Bounded lock-free queue of pre-serialized commands shared between the loop task (producer)
+// and the http task (consumer). Each slot has a sequence number, so the producer can also
+// safely discard the oldest command while the consumer is working (Vyukov bounded queue).
+// Slot strings are never moved out: buffers are reused and no allocation is needed once warm.
+class CommandQueue
+{
+public:
+	CommandQueue();
+
+	// store a new command (producer side)
+	// params:
+	//   command   : the Telegram API method, i.e. sendMessage
+	//   param     : the JSON serialized parameters
+	//   dropOldest: if queue is full, discard the oldest command instead the new one
+	//   dropped   : if not null, filled with the method of the command discarded (if any)
+	// returns:
+	//   true if command was stored
+	bool push(const char* command, const char* param, bool dropOldest = false, String *dropped = nullptr);
+
+	// take the oldest command (consumer side)
+	// returns:
+	//   true if command and param were filled
+	bool pop(String &command, String &param);
+
+	// number of commands waiting to be sent
+	uint8_t size() const;
+
+	// position of the next command pushed
+	inline uint32_t tail() const { return m_enqueuePos.load(std::memory_order_relaxed); }
+
+	// true when all commands pushed before position were taken by the consumer
+	inline bool taken(uint32_t position) const {
+		return (int32_t)(m_dequeuePos.load(std::memory_order_acquire) - position) >= 0;
+	}
+
+	QueueStats getStats() const;
+
+private:
+	struct Slot {
+		std::atomic<uint32_t> sequence;
+		String command;
+		String param;
+	};
+
+	Slot 					m_slots[COMMAND_QUEUE_SIZE];
+	std::atomic<uint32_t> 	m_enqueuePos;
+	std::atomic<uint32_t> 	m_dequeuePos;
+
+	std::atomic<uint32_t> 	m_pushed;
+	std::atomic<uint32_t> 	m_popped;
+	uint32_t 				m_dropped = 0;
+	uint32_t 				m_rejected = 0;
+	uint8_t 				m_highWater = 0;
+
+	// claim the oldest slot and copy the fields requested (or just discard it)
+	bool take(String *command, String *param);
+};
+
+#endif
@@ -0,0 +1,107 @@
+#include "CommandRouter.h"
+
+static inline bool isSpace(char c)
+{
+	return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+}
+
+
+CommandRouter::CommandRouter()
+{
+	Node root = {'\0', 0, 0, 0};
+	m_nodes.push_back(root);
+}
+
+
+uint16_t CommandRouter::findChild(uint16_t node, char key) const
+{
+	for (uint16_t i = m_nodes[node].child; i != 0; i = m_nodes[i].next) {
+		if (m_nodes[i].key == key)
+			return i;
+	}
+	return 0;
+}
+
+
+bool CommandRouter::add(const char* command, CommandHandler handler)
+{
+	if (*command == '/')
+		command++;
+	size_t len = strlen(command);
+	if (len == 0 || len > MAX_COMMAND_LENGTH)
+		return false;
+	for (size_t i = 0; i < len; i++) {
+		if (!isalnum((uint8_t) command[i]) && command[i] != '_')
+			return false;
+	}
+
+	uint16_t node = 0;
+	for (size_t i = 0; i < len; i++) {
+		char key = tolower((uint8_t) command[i]);
+		uint16_t child = findChild(node, key);
+		if (child == 0) {
+			if (m_nodes.size() >= UINT16_MAX)
+				return false;
+			// New node becomes the first child
+			Node newNode = {key, 0, m_nodes[node].child, 0};
+			child = m_nodes.size();
+			m_nodes.push_back(newNode);
+			m_nodes[node].child = child;
+		}
+		node = child;
+	}
+
+	if (m_nodes[node].handler != 0)
+		m_handlers[m_nodes[node].handler - 1] = handler;
+	else {
+		m_handlers.push_back(handler);
+		m_nodes[node].handler = m_handlers.size();
+	}
+	return true;
+}
+
+
+bool CommandRouter::route(const TBMessage &msg, const char* botName) const
+{
+	const char* text = msg.text.c_str();
+	if (*text != '/' || m_handlers.empty())
+		return false;
+
+	// Walk the trie along the command name
+	const char* p = text + 1;
+	uint16_t node = 0;
+	for (; *p != '\0' && *p != '@' && !isSpace(*p); p++) {
+		node = findChild(node, tolower((uint8_t) *p));
+		if (node == 0)
+			return false;
+	}
+	if (m_nodes[node].handler == 0)
+		return false;
+
+	// "/command@botname" is for this bot only if name matches
+	if (*p == '@') {
+		const char* name = ++p;
+		while (*p != '\0' && !isSpace(*p))
+			p++;
+		size_t len = p - name;
+		if (botName == nullptr || strlen(botName) != len || strncasecmp(name, botName, len) != 0)
+			return false;
+	}
+
+	// Split arguments on white spaces, pointing into text
+	CommandArgs args;
+	while (isSpace(*p))
+		p++;
+	args.m_rest = TBString(p, msg.text.length() - (p - text));
+	while (*p != '\0' && args.m_count < MAX_COMMAND_ARGS) {
+		const char* arg = p;
+		while (*p != '\0' && !isSpace(*p))
+			p++;
+		args.m_args[args.m_count++] = TBString(arg, p - arg);
+		while (isSpace(*p))
+			p++;
+	}
+
+	m_handlers[m_nodes[node].handler - 1](msg, args);
+	return true;
+}
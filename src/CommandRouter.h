@@ -0,0 +1,81 @@
+#ifndef COMMAND_ROUTER
+#define COMMAND_ROUTER
+
+#include <Arduino.h>
+#include <functional>
+#include <vector>
+#include "DataStructures.h"
+
+#ifndef MAX_COMMAND_ARGS
+#define MAX_COMMAND_ARGS        8       // arguments split for a command (others are left in rest())
+#endif
+#define MAX_COMMAND_LENGTH      32      // Telegram commands are up to 32 characters
+
+
+// Arguments of a command, as views of the message text (valid until next getNewMessage()).
+// Single arguments are not null terminated where they end (c_str() runs to the end of the text):
+// compare them with ==, equals() or startsWith(), or copy them with toString()
+class CommandArgs
+{
+public:
+	// number of arguments split
+	inline uint8_t count() const { return m_count; }
+
+	// argument i (empty if there are fewer arguments)
+	inline TBString operator[](uint8_t i) const { return i < m_count ? m_args[i] : TBString(); }
+
+	// all the text after the command (null terminated)
+	inline TBString rest() const { return m_rest; }
+
+private:
+	friend class CommandRouter;
+
+	TBString 	m_args[MAX_COMMAND_ARGS];
+	uint8_t 	m_count = 0;
+	TBString 	m_rest;
+};
+
+// Called when a registered command is received
+using CommandHandler = std::function<void(const TBMessage &msg, const CommandArgs &args)>;
+
+
+// Dispatch of slash commands (i.e. "/light@mybot on") to registered handlers.
+// Commands are stored in a trie (first child / next sibling nodes), so a message is matched
+// in a single pass over its text, whatever the number of commands. Matching is case insensitive.
+class CommandRouter
+{
+public:
+	CommandRouter();
+
+	// register the handler of a command (with or without the leading '/').
+	// A command already registered gets the new handler
+	// returns:
+	//   false if command is empty, too long, or has characters other than letters, digits and '_'
+	bool add(const char* command, CommandHandler handler);
+
+	// call the handler of the command in a text message, if any.
+	// Commands addressed to another bot (i.e. "/start@otherbot") are ignored
+	// params:
+	//   botName: username of this bot
+	// returns:
+	//   true if a handler was called
+	bool route(const TBMessage &msg, const char* botName) const;
+
+	inline size_t size() const { return m_handlers.size(); }
+
+private:
+	struct Node {
+		char 		key;
+		uint16_t 	child;			// first child (0 if none, root is never a child)
+		uint16_t 	next;			// next sibling (0 if none)
+		uint16_t 	handler;		// handler index + 1 (0 if no command ends here)
+	};
+
+	std::vector<Node> 			m_nodes;
+	std::vector<CommandHandler> m_handlers;
+
+	// child of node with key, 0 if none
+	uint16_t findChild(uint16_t node, char key) const;
+};
+
+#endif
@@ -3,6 +3,8 @@
 #define DATA_STRUCTURES
 
 #include <Arduino.h>
+#include <atomic>
+#include <functional>
 
 #define BUFFER_BIG       	2048 		// json parser buffer size (ArduinoJson v6)
 #define BUFFER_MEDIUM     	1028 		// json parser buffer size (ArduinoJson v6)
@@ -18,21 +20,120 @@ enum MessageType {
 	MessageReply 	= 6
 };
 
+enum PollMode {
+	PollShort    = 0,	// new getUpdates request every setUpdateTime() ms
+	PollLong     = 1,	// keep one getUpdates request always outstanding on server
+	PollAdaptive = 2	// short polling while chat is active, long polling when idle
+};
+
 
 // Here we store the stuff related to the Telegram server reply
 struct HttpServerReply {
-    bool        waitingReply = false;
-    uint32_t    timestamp;
+    std::atomic<bool> waitingReply {false};
+    std::atomic<uint32_t> timestamp {0};     // written by http task too (ESP32)
     String      payload;
 
-    // Task sharing variables
-    // Here we can share data with task for handling the request to server
-    String      command;
-    String      param;
+    // Set by http task when payload holds a getUpdates reply, cleared once parsed.
+    // Payload can't be touched by the other side while owned (ESP32 only)
+    std::atomic<bool> replyReady {false};
 } ;
 
 
 
+// Read-only view of a string stored in the bot arena (the document holding last getUpdates reply).
+// No heap allocation is needed and it stays valid until next call to getNewMessage().
+// Use toString() if the value has to be kept longer.
+struct TBString {
+	const char*  str = nullptr;
+	size_t       len = 0;
+
+	TBString() {}
+	TBString(const char* s) : str(s), len(s != nullptr ? strlen(s) : 0) {}
+	TBString(const char* s, size_t l) : str(s), len(l) {}
+
+	inline const char* c_str() const { return str != nullptr ? str : ""; }
+	inline size_t length() const { return len; }
+	explicit inline operator const char*() const { return c_str(); }
+
+	inline bool equals(const char* s, size_t n) const {
+		return n == len && memcmp(c_str(), s, len) == 0;
+	}
+
+	inline bool equals(const char* s) const {
+		return s != nullptr ? equals(s, strlen(s)) : len == 0;
+	}
+
+	inline bool equalsIgnoreCase(const char* s) const {
+		return s != nullptr && strlen(s) == len && strncasecmp(c_str(), s, len) == 0;
+	}
+
+	inline bool startsWith(const char* prefix) const {
+		size_t n = strlen(prefix);
+		return n <= len && strncmp(c_str(), prefix, n) == 0;
+	}
+
+	// Search is bounded by len: a view is not null terminated where it ends (i.e. command arguments)
+	inline int indexOf(const char* s, size_t from = 0) const {
+		size_t n = strlen(s);
+		if (from > len || n > len - from)
+			return -1;
+		for (size_t i = from; i + n <= len; i++) {
+			if (memcmp(c_str() + i, s, n) == 0)
+				return (int) i;
+		}
+		return -1;
+	}
+
+	String substring(size_t from, size_t to = (size_t)-1) const {
+		String out;
+		if (to > len)
+			to = len;
+		if (from >= to)
+			return out;
+		out.reserve(to - from);
+		for (size_t i = from; i < to; i++)
+			out += str[i];
+		return out;
+	}
+
+	// Copy of the len bytes of the view
+	inline String toString() const { return substring(0); }
+};
+
+// Compare the text, not the pointers (i.e. msg.text == "/start")
+inline bool operator==(const TBString &a, const TBString &b) { return a.equals(b.c_str(), b.length()); }
+inline bool operator==(const TBString &a, const char* b) { return a.equals(b); }
+inline bool operator==(const TBString &a, const String &b) { return a.equals(b.c_str(), b.length()); }
+inline bool operator==(const char* a, const TBString &b) { return b.equals(a); }
+inline bool operator==(const String &a, const TBString &b) { return b.equals(a.c_str(), a.length()); }
+inline bool operator!=(const TBString &a, const TBString &b) { return !(a == b); }
+inline bool operator!=(const TBString &a, const char* b) { return !(a == b); }
+inline bool operator!=(const TBString &a, const String &b) { return !(a == b); }
+inline bool operator!=(const char* a, const TBString &b) { return !(a == b); }
+inline bool operator!=(const String &a, const TBString &b) { return !(a == b); }
+
+
+// Last file download (downloadFile)
+struct DownloadStats {
+	uint32_t bytes = 0;				// bytes received
+	uint32_t time = 0;				// ms
+	uint32_t bytesPerSecond = 0;
+	uint8_t  resumed = 0;			// transfer interrupted and resumed with a HTTP Range request
+};
+
+// Called for each block of a file downloaded (return false to abort)
+using DownloadCallback = std::function<bool(const uint8_t* data, size_t len)>;
+
+
+// TLS handshakes done with Telegram server
+struct TLSStats {
+	uint32_t fullHandshakes = 0;
+	uint32_t resumedHandshakes = 0;
+	uint32_t lastHandshakeTime = 0;		// ms
+	uint32_t totalHandshakeTime = 0;	// ms
+};
+
+
 struct TBUser {
 	int32_t  id = 0;
 	bool     isBot;
@@ -85,8 +186,11 @@ struct TBMessage {
 	TBDocument       document;
 	const char*      callbackQueryData;
 	const char*   	 callbackQueryID;
-	String      	 text;
+	TBString      	 text;
 };
 
+// Called when a message of the type it was registered for is received
+using MessageHandler = std::function<void(const TBMessage &msg)>;
+
 #endif
 
@@ -0,0 +1,292 @@
+#include "HttpResponseParser.h"
+
+
+HttpResponseParser::HttpResponseParser()
+{
+	reset();
+}
+
+
+void HttpResponseParser::reset()
+{
+	m_state = StatusLine;
+	m_lineLen = 0;
+	m_statusCode = 0;
+	m_contentLength = -1;
+	m_remaining = 0;
+	m_chunked = false;
+	m_keepAlive = true;
+}
+
+
+bool HttpResponseParser::parseHeaders(Stream &stream)
+{
+	while ((m_state == StatusLine || m_state == HeaderLine) && stream.available() > 0) {
+		int c = stream.read();
+		if (c < 0)
+			break;
+		if (c == '\n') {
+			m_line[m_lineLen] = '\0';
+			parseLine();
+			m_lineLen = 0;
+		}
+		else if (c != '\r' && m_lineLen < HTTP_LINE_SIZE - 1)
+			m_line[m_lineLen++] = (char) c;
+	}
+	return headersDone();
+}
+
+
+void HttpResponseParser::parseLine()
+{
+	if (m_state == StatusLine) {
+		// i.e. "HTTP/1.1 200 OK"
+		if (m_lineLen == 0)
+			return;
+		if (strncmp(m_line, "HTTP/1.", 7) != 0) {
+			m_state = Failed;
+			return;
+		}
+		m_keepAlive = (m_line[7] != '0');
+		const char *code = strchr(m_line, ' ');
+		m_statusCode = code != nullptr ? atoi(code + 1) : 0;
+		m_state = HeaderLine;
+		return;
+	}
+
+	if (m_lineLen == 0) {
+		headersEnd();
+		return;
+	}
+	if (strncasecmp(m_line, "Content-Length:", 15) == 0)
+		m_contentLength = atol(m_line + 15);
+	else if (strncasecmp(m_line, "Transfer-Encoding:", 18) == 0)
+		m_chunked = strstr(m_line + 18, "chunked") != nullptr;
+	else if (strncasecmp(m_line, "Connection:", 11) == 0) {
+		if (strstr(m_line + 11, "close") != nullptr)
+			m_keepAlive = false;
+		else if (strstr(m_line + 11, "keep-alive") != nullptr)
+			m_keepAlive = true;
+	}
+}
+
+
+void HttpResponseParser::headersEnd()
+{
+	// Interim response (100 Continue): a new status line will follow
+	if (m_statusCode >= 100 && m_statusCode < 200) {
+		reset();
+		return;
+	}
+	if (m_statusCode == 204 || m_statusCode == 304) {
+		m_state = Complete;
+	}
+	else if (m_chunked) {
+		m_state = ChunkSize;
+	}
+	else if (m_contentLength >= 0) {
+		m_remaining = m_contentLength;
+		m_state = m_remaining > 0 ? BodyData : Complete;
+	}
+	else {
+		// No framing: body ends when server close the connection
+		m_remaining = -1;
+		m_keepAlive = false;
+		m_state = BodyData;
+	}
+}
+
+
+bool HttpResponseParser::readLine(Stream &stream)
+{
+	m_lineLen = 0;
+	char c;
+	while (stream.readBytes(&c, 1) == 1) {
+		if (c == '\n') {
+			m_line[m_lineLen] = '\0';
+			return true;
+		}
+		if (c != '\r' && m_lineLen < HTTP_LINE_SIZE - 1)
+			m_line[m_lineLen++] = c;
+	}
+	return false;
+}
+
+
+int HttpResponseParser::readBody(Stream &stream)
+{
+	char c;
+	for (;;) {
+		switch (m_state) {
+			case BodyData:
+				if (m_remaining == 0) {
+					m_state = Complete;
+					return -1;
+				}
+				if (stream.readBytes(&c, 1) != 1) {
+					// Without framing, a closed connection is the end of body
+					m_state = m_remaining < 0 ? Complete : Failed;
+					return -1;
+				}
+				if (m_remaining > 0)
+					m_remaining--;
+				return (uint8_t) c;
+
+			case ChunkSize:
+				if (!readLine(stream)) {
+					m_state = Failed;
+					return -1;
+				}
+				// Chunk extensions after ';' are ignored by strtol
+				m_remaining = strtol(m_line, nullptr, 16);
+				m_state = m_remaining > 0 ? ChunkData : Trailer;
+				break;
+
+			case ChunkData:
+				if (stream.readBytes(&c, 1) != 1) {
+					m_state = Failed;
+					return -1;
+				}
+				if (--m_remaining == 0)
+					m_state = ChunkDataEnd;
+				return (uint8_t) c;
+
+			case ChunkDataEnd:
+				// CRLF after chunk data
+				m_state = readLine(stream) ? ChunkSize : Failed;
+				break;
+
+			case Trailer:
+				// Trailer headers (if any) end with an empty line
+				if (!readLine(stream)) {
+					m_state = Failed;
+					return -1;
+				}
+				if (m_lineLen == 0)
+					m_state = Complete;
+				break;
+
+			default:
+				return -1;
+		}
+	}
+}
+
+
+int HttpResponseParser::readBody(Client &client, uint8_t *buffer, size_t size)
+{
+	if (m_state != BodyData && m_state != ChunkData) {
+		int c = readBody((Stream &) client);
+		if (c < 0)
+			return -1;
+		buffer[0] = (uint8_t) c;
+		return 1;
+	}
+	if (m_state == BodyData && m_remaining == 0) {
+		m_state = Complete;
+		return -1;
+	}
+
+	int available = client.available();
+	if (available <= 0) {
+		if (!client.connected()) {
+			// Without framing, a closed connection is the end of body
+			m_state = (m_state == BodyData && m_remaining < 0) ? Complete : Failed;
+			return -1;
+		}
+		return 0;
+	}
+	size_t len = (size_t) available < size ? available : size;
+	if (m_remaining > 0 && (size_t) m_remaining < len)
+		len = m_remaining;
+	int count = client.read(buffer, len);
+	if (count <= 0)
+		return 0;
+	if (m_remaining > 0) {
+		m_remaining -= count;
+		if (m_state == ChunkData && m_remaining == 0)
+			m_state = ChunkDataEnd;
+	}
+	return count;
+}
+
+
+int HttpResponseParser::readBodyBlock(Stream &stream, uint8_t *buffer, size_t size)
+{
+	if ((m_state != BodyData && m_state != ChunkData) || m_remaining == 0 || size == 0) {
+		// Chunk framing (and end of body) is handled by the single byte reader
+		int c = readBody(stream);
+		if (c < 0)
+			return -1;
+		buffer[0] = (uint8_t) c;
+		return 1;
+	}
+
+	// Don't wait for more bytes than the ones already available (at least one)
+	int available = stream.available();
+	size_t len = available > 0 ? min((size_t) available, size) : 1;
+	if (m_remaining > 0 && (size_t) m_remaining < len)
+		len = m_remaining;
+	size_t count = stream.readBytes((char *) buffer, len);
+	if (count == 0) {
+		// Without framing, a closed connection is the end of body
+		m_state = (m_state == BodyData && m_remaining < 0) ? Complete : Failed;
+		return -1;
+	}
+	if (m_remaining > 0) {
+		m_remaining -= count;
+		if (m_state == ChunkData && m_remaining == 0)
+			m_state = ChunkDataEnd;
+	}
+	return count;
+}
+
+
+bool HttpResponseParser::skipBody(Stream &stream)
+{
+	uint8_t buffer[HTTP_BODY_BUFFER];
+	while (readBodyBlock(stream, buffer, sizeof(buffer)) >= 0)
+		yield();
+	return complete();
+}
+
+
+
+HttpBodyStream::HttpBodyStream(HttpResponseParser &parser, Stream &stream) :
+	m_parser(parser), m_stream(stream)
+{
+	// Parser itself waits for data up to the underlying stream timeout
+	setTimeout(0);
+}
+
+
+bool HttpBodyStream::fill()
+{
+	if (m_position < m_length)
+		return true;
+	m_position = 0;
+	m_length = m_parser.readBodyBlock(m_stream, m_buffer, sizeof(m_buffer));
+	if (m_length < 0)
+		m_length = 0;
+	return m_length > 0;
+}
+
+
+int HttpBodyStream::available()
+{
+	if (m_position < m_length)
+		return m_length - m_position;
+	return m_parser.complete() ? 0 : m_stream.available();
+}
+
+
+int HttpBodyStream::read()
+{
+	return fill() ? m_buffer[m_position++] : -1;
+}
+
+
+int HttpBodyStream::peek()
+{
+	return fill() ? m_buffer[m_position] : -1;
+}
@@ -0,0 +1,112 @@
+#ifndef HTTP_RESPONSE_PARSER
+#define HTTP_RESPONSE_PARSER
+
+#include <Arduino.h>
+#include <Client.h>
+
+#define HTTP_LINE_SIZE      64          // longer header lines are truncated (only known headers are needed)
+#define HTTP_BODY_BUFFER    128         // body bytes read at once by HttpBodyStream
+
+
+// Incremental parser for HTTP/1.1 responses read from a WiFiClientSecure.
+// Status line and headers are consumed only when bytes are available, so it never blocks and
+// can be resumed on next call. Once headers are complete, the body (Content-Length, chunked or
+// until close) can be read with readBody() or through a HttpBodyStream (i.e. with deserializeJson):
+// JSON is parsed while it's read, so the body reader waits for data up to the stream timeout.
+// After skipBody() the stream points exactly to the next response, so connection can be reused.
+class HttpResponseParser
+{
+public:
+	HttpResponseParser();
+
+	// prepare the parser for a new response
+	void reset();
+
+	// consume status line and headers available on stream without waiting for more data
+	// returns:
+	//   true when all headers have been received and body can be read
+	bool parseHeaders(Stream &stream);
+
+	// read one byte of body, waiting for data up to stream timeout
+	// returns:
+	//   the byte read or -1 at the end of body (or on error)
+	int readBody(Stream &stream);
+
+	// read a block of body (up to the data available, at least one byte), waiting for data up to stream timeout
+	// returns:
+	//   the number of bytes copied in buffer, -1 at the end of body (or on error)
+	int readBodyBlock(Stream &stream, uint8_t *buffer, size_t size);
+
+	// read a block of body with data already available on client, without waiting (i.e. file download).
+	// Chunk framing is handled by the single byte reader
+	// returns:
+	//   the number of bytes copied in buffer, 0 if no data is available yet, -1 at the end of body (or on error)
+	int readBody(Client &client, uint8_t *buffer, size_t size);
+
+	// read and discard the remaining part of body
+	// returns:
+	//   true if the response was fully received
+	bool skipBody(Stream &stream);
+
+	inline bool headersDone() const { return m_state >= BodyData; }
+	inline bool complete() const { return m_state == Complete; }
+	inline int statusCode() const { return m_statusCode; }
+	inline bool keepAlive() const { return m_keepAlive; }
+	inline bool isChunked() const { return m_chunked; }
+	inline int32_t contentLength() const { return m_contentLength; }
+
+private:
+	enum ParserState {
+		StatusLine,
+		HeaderLine,
+		BodyData,		// Content-Length body, or until connection close if m_remaining < 0
+		ChunkSize,
+		ChunkData,
+		ChunkDataEnd,
+		Trailer,
+		Complete,
+		Failed
+	};
+
+	ParserState m_state;
+	char 		m_line[HTTP_LINE_SIZE];
+	uint8_t 	m_lineLen;
+	int 		m_statusCode;
+	int32_t 	m_contentLength;
+	int32_t 	m_remaining;
+	bool 		m_chunked;
+	bool 		m_keepAlive;
+
+	void parseLine();
+	void headersEnd();
+	bool readLine(Stream &stream);
+};
+
+
+// Stream adapter used to read only the body of a response (chunks are decoded).
+// Body is read from the underlying stream one block at time
+class HttpBodyStream : public Stream
+{
+public:
+	HttpBodyStream(HttpResponseParser &parser, Stream &stream);
+
+	int available();
+	int read();
+	int peek();
+	size_t write(uint8_t) { return 0; }
+	void flush() {}
+
+private:
+	HttpResponseParser 	&m_parser;
+	Stream 				&m_stream;
+	uint8_t 			m_buffer[HTTP_BODY_BUFFER];
+	int16_t 			m_length = 0;
+	int16_t 			m_position = 0;
+
+	// read next block of body
+	// returns:
+	//   false at the end of body
+	bool fill();
+};
+
+#endif
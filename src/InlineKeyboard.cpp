@@ -1,11 +1,21 @@
 #include "InlineKeyboard.h"
+#include "RequestWriter.h"
+#include "Utilities.h"
 
+// FNV-1a hash of a string
+static uint32_t hashString(const char* str)
+{
+	uint32_t hash = 2166136261UL;
+	for (; *str != '\0'; str++) {
+		hash ^= (uint8_t) *str;
+		hash *= 16777619UL;
+	}
+	return hash;
+}
 
 
 InlineKeyboard::InlineKeyboard()
 {
-	m_json = "{\"inline_keyboard\":[[]]}\"";
-
 }
 
 InlineKeyboard::~InlineKeyboard(){} 
@@ -13,15 +23,10 @@ InlineKeyboard::~InlineKeyboard(){}
 
 bool InlineKeyboard::addRow()
 {
-	if(m_jsonSize < BUFFER_MEDIUM) m_jsonSize = BUFFER_MEDIUM;	
-	DynamicJsonDocument doc(m_jsonSize + 128);	 // Current size + space for new row (empty)
-	deserializeJson(doc, m_json);
-	JsonArray  rows = doc["inline_keyboard"];	
-	rows.createNestedArray();
-	m_json.clear();
-	serializeJson(doc, m_json);
-	doc.shrinkToFit();
-	m_jsonSize = doc.memoryUsage();
+	if (m_rows == UINT8_MAX)
+		return false;
+	m_rows++;
+	m_changed = true;
 	return true;
 }
 
@@ -30,47 +35,72 @@ bool InlineKeyboard::addButton(const char* text, const char* command, InlineKeyb
 {
 	if ((buttonType != KeyboardButtonURL) && (buttonType != KeyboardButtonQuery))
 		return false;
-	
-	InlineButton *inlineButton = new InlineButton();
-	if (_firstButton == nullptr) 
-		_firstButton = inlineButton;
-	else
-		_lastButton->nextButton = inlineButton;
-	inlineButton->argCallback = onClick;
-	inlineButton->btnName = (char*)command;
-	_lastButton = inlineButton;
-	m_buttonsCounter++;
-	
-	// As reccomended use local JsonDocument instead global
-	// inline keyboard json structure will be stored in a String var
-	if(m_jsonSize < BUFFER_MEDIUM) m_jsonSize = BUFFER_MEDIUM;	
-	DynamicJsonDocument doc(m_jsonSize + 256);	 // Current size + space for new object (button)
-	deserializeJson(doc, m_json);
-
-	JsonArray  rows = doc["inline_keyboard"];	
-	JsonObject button = rows[rows.size()-1].createNestedObject();
-
-	button["text"] = text ; 
-	if(KeyboardButtonURL == buttonType) 
-		button["url"] = command;	
-	else if (KeyboardButtonQuery == buttonType) 		
-		button["callback_data"] = command;	
-
-	// Store inline keyboard json structure
-	m_json.clear();
-	serializeJson(doc, m_json);
-	doc.shrinkToFit();
-	m_jsonSize = doc.memoryUsage();
+
+	// Only the new button is stored, JSON will be generated when needed
+	InlineButton button;
+	button.text = storeString(text);
+	button.data = storeString(command);
+	button.hash = hashString(command);
+	button.row = m_rows - 1;
+	button.type = buttonType;
+	button.argCallback = onClick;
+	m_buttons.push_back(button);
+	if (onClick != nullptr)
+		addCallback(m_buttons.size() - 1);
+	m_changed = true;
 	return true;	
 }
 
 
+void InlineKeyboard::addCallback(uint16_t index)
+{
+	// Keep the table at most half full, so probe sequences stay short
+	if ((size_t(m_callbacksCount) + 1) * 2 > m_callbacks.size()) {
+		std::vector<uint16_t> old;
+		old.swap(m_callbacks);
+		m_callbacks.assign(old.empty() ? 8 : old.size() * 2, 0);
+		for (uint16_t slot : old) {
+			if (slot != 0)
+				insertCallback(slot - 1);
+		}
+	}
+	insertCallback(index);
+	m_callbacksCount++;
+}
+
+
+void InlineKeyboard::insertCallback(uint16_t index)
+{
+	size_t mask = m_callbacks.size() - 1;
+	size_t i = m_buttons[index].hash & mask;
+	while (m_callbacks[i] != 0)
+		i = (i + 1) & mask;
+	m_callbacks[i] = index + 1;
+}
+
+
+uint16_t InlineKeyboard::storeString(const char* str)
+{
+	uint16_t offset = m_strings.size();
+	m_strings.insert(m_strings.end(), str, str + strlen(str) + 1);
+	return offset;
+}
+
+
 // Check if a callback function has to be called for this button query message
 void InlineKeyboard::checkCallback( const TBMessage &msg)  {
-	char* buttonName = (char*) msg.callbackQueryData;
-	for(InlineButton *_button = _firstButton; _button != nullptr; _button = _button->nextButton){
-		if( strstr(_button->btnName, buttonName) != nullptr && _button->argCallback != nullptr)	
-			_button->argCallback(msg);
+	const char* buttonName = msg.callbackQueryData;
+	if (buttonName == nullptr || m_callbacks.empty())
+		return;
+
+	uint32_t hash = hashString(buttonName);
+	size_t mask = m_callbacks.size() - 1;
+	for (size_t i = hash & mask; m_callbacks[i] != 0; i = (i + 1) & mask) {
+		const InlineButton &button = m_buttons[m_callbacks[i] - 1];
+		if (button.hash == hash && strcmp(&m_strings[button.data], buttonName) == 0) {
+			button.argCallback(msg);
+			return;
+		}
 	}
 } 
 
@@ -78,26 +108,56 @@ void InlineKeyboard::checkCallback( const TBMessage &msg)  {
 // Get total number of keyboard buttons
 int InlineKeyboard::getButtonsNumber() 
 {
-	return m_buttonsCounter;
+	return m_buttons.size();
 }
 
 
 
-String InlineKeyboard::getJSON() const
+const String& InlineKeyboard::getJSON() const
 {
+	if (!m_changed)
+		return m_json;
+
+	// Single pass on buttons: rows are already in order
+	// Button members take at most 32 bytes besides text and data
+	m_json.reserve(m_strings.size() + m_buttons.size() * 32 + m_rows * 3 + 24);
+	m_json = "";
+	RequestWriter out(m_json);
+	out.print("{\"inline_keyboard\":[[");
+	uint8_t row = 0;
+	bool first = true;
+	for (const InlineButton &button : m_buttons) {
+		for (; row < button.row; row++) {
+			out.print("],[");
+			first = true;
+		}
+		if (!first)
+			out.write(',');
+		first = false;
+		out.print("{\"text\":");
+		jsonEscape(out, &m_strings[button.text]);
+		out.print(button.type == KeyboardButtonURL ? ",\"url\":" : ",\"callback_data\":");
+		jsonEscape(out, &m_strings[button.data]);
+		out.write('}');
+	}
+	for (; row < m_rows - 1; row++)
+		out.print("],[");
+	out.print("]]}");
+	out.flush();
+	m_changed = false;
 	return m_json;
 }
 
 
 String InlineKeyboard::getJSONPretty() const
 {
-	uint16_t jsonSize;
-	if(m_jsonSize < BUFFER_SMALL) jsonSize = BUFFER_SMALL;	
-	DynamicJsonDocument doc(jsonSize + 128);	// Current size + space for new lines
-	deserializeJson(doc, m_json);
+	String json = getJSON();
+	DynamicJsonDocument doc(json.length() * 2 + BUFFER_SMALL);
+	deserializeJson(doc, json);
 	
 	String serialized;		
 	serializeJsonPretty(doc, serialized);
 	return serialized;
 }
 
+
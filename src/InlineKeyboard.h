@@ -1,9 +1,10 @@
 
-#ifndef INLINE_KEYBOARD
-#define INLINE_KEYBOARD
+#ifndef INLINE_KEYBOARD_H
+#define INLINE_KEYBOARD_H
 
 
 #include <functional>
+#include <vector>
 #include <ArduinoJson.h>
 #include "DataStructures.h"
 
@@ -20,10 +21,14 @@ class InlineKeyboard
 
 using CallbackType = std::function<void(const TBMessage &msg)>;
 
+// Labels and data are stored in a single buffer, buttons keep only the offsets
 struct InlineButton{
-	char 		*btnName;
+	uint16_t 	text;
+	uint16_t 	data;
+	uint32_t 	hash;		// hash of data, to find the callback
+	uint8_t 	row;
+	InlineKeyboardButtonType type;
 	CallbackType argCallback;
-	InlineButton *nextButton;
 } ;
 
 
@@ -50,26 +55,39 @@ public:
 	bool addButton(const char* text, const char* command, InlineKeyboardButtonType buttonType, CallbackType onClick = nullptr);
 
 	// generate a string that contains the inline keyboard formatted in a JSON structure.
+	// JSON is built only once, when keyboard is sent for the first time after a change.
 	// Useful for CTBot::sendMessage()
 	// returns:
 	//   the JSON of the inline keyboard
-	String getJSON(void) const ;
+	const String& getJSON(void) const ;
 	String getJSONPretty(void) const;
 
 
 private:
 	friend class AsyncTelegram;
 
-	String 			m_json;
-	String 			m_name;
-	size_t 			m_jsonSize = BUFFER_MEDIUM;
+	std::vector<InlineButton> m_buttons;
+	std::vector<char> m_strings;
+	uint8_t			m_rows = 1;
 
-	uint8_t			m_buttonsCounter = 0;
-	InlineButton 	*_firstButton = nullptr;
-	InlineButton 	*_lastButton = nullptr;
+	// Open addressing hash table of buttons with a callback (index + 1, 0 if slot is empty).
+	// Size is a power of 2 and at most half of slots are used
+	std::vector<uint16_t> m_callbacks;
+	uint16_t		m_callbacksCount = 0;
 
+	mutable String 	m_json;
+	mutable bool 	m_changed = true;
 
-	// Check if a callback function has to be called for a button query reply message
+	// copy a string in buffer and get its offset
+	uint16_t storeString(const char* str);
+
+	// add a button to the callbacks table
+	void addCallback(uint16_t index);
+	void insertCallback(uint16_t index);
+
+
+	// Check if a callback function has to be called for a button query reply message.
+	// Callback data must match exactly, if more buttons have the same data the first one is used
 	void checkCallback(const TBMessage &msg) ;
 
 
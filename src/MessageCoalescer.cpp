@@ -0,0 +1,158 @@
+#include "MessageCoalescer.h"
+
+
+CoalescedMessage* MessageCoalescer::find(int64_t chatId)
+{
+	for (CoalescedMessage &message : m_messages) {
+		if (message.used && message.chatId == chatId)
+			return &message;
+	}
+	return nullptr;
+}
+
+
+CoalescedMessage* MessageCoalescer::add(int64_t chatId, ParseMode parseMode, bool silent)
+{
+	for (CoalescedMessage &message : m_messages) {
+		if (message.used)
+			continue;
+		message.chatId = chatId;
+		message.parseMode = parseMode;
+		message.silent = silent;
+		message.start = millis();
+		// Keep the buffer allocated with previous messages
+		message.text = "";
+		message.used = true;
+		return &message;
+	}
+	return nullptr;
+}
+
+
+CoalescedMessage* MessageCoalescer::expired()
+{
+	uint32_t now = millis();
+	for (CoalescedMessage &message : m_messages) {
+		if (message.used && now - message.start >= m_window)
+			return &message;
+	}
+	return nullptr;
+}
+
+
+CoalescedMessage* MessageCoalescer::oldest()
+{
+	CoalescedMessage *oldest = nullptr;
+	for (CoalescedMessage &message : m_messages) {
+		if (message.used && (oldest == nullptr || (int32_t)(message.start - oldest->start) < 0))
+			oldest = &message;
+	}
+	return oldest;
+}
+
+
+// MarkdownV2 entities that can be open at a split point
+#define MD_BOLD         0x01
+#define MD_ITALIC       0x02
+#define MD_UNDERLINE    0x04
+#define MD_STRIKE       0x08
+#define MD_SPOILER      0x10
+#define MD_CODE         0x20
+#define MD_PRE          0x40
+#define MD_LINK         0x80
+
+
+size_t MessageCoalescer::cut(const char* text, size_t len, size_t maxLen, ParseMode parseMode)
+{
+	if (len <= maxLen)
+		return len;
+
+	// Last points where text can be split: anywhere, and after a new line (i.e. between two merged messages)
+	size_t split = 0;
+	size_t line = 0;
+	uint8_t open = 0;		// MarkdownV2 entities open
+	uint8_t depth = 0;		// HTML elements open
+	for (size_t i = 0; i <= maxLen; ) {
+		// UTF-8 continuation bytes are 10xxxxxx
+		if (open == 0 && depth == 0 && ((uint8_t) text[i] & 0xC0) != 0x80) {
+			split = i;
+			if (i > 0 && text[i - 1] == '\n')
+				line = i;
+		}
+		if (i == maxLen)
+			break;
+		i += scanToken(text + i, len - i, parseMode, open, depth);
+	}
+
+	if (line > maxLen / 2)
+		return line;
+	return split;
+}
+
+
+size_t MessageCoalescer::scanToken(const char* text, size_t len, ParseMode parseMode, uint8_t &open, uint8_t &depth)
+{
+	if (parseMode == ParseHTML) {
+		// A tag or a character reference is a single token
+		const char* end = nullptr;
+		if (text[0] == '<')
+			end = (const char*) memchr(text, '>', len);
+		else if (text[0] == '&')
+			end = (const char*) memchr(text, ';', len);
+		if (end == nullptr)
+			return 1;
+		if (text[0] == '<') {
+			if (text[1] == '/')
+				depth = depth > 0 ? depth - 1 : 0;
+			else if (end[-1] != '/')
+				depth++;
+		}
+		return end - text + 1;
+	}
+
+	if (parseMode != ParseMarkdownV2)
+		return 1;
+	// Escaped character
+	if (text[0] == '\\')
+		return len > 1 ? 2 : 1;
+	bool twice = len > 1 && text[1] == text[0];
+	if (text[0] == '`') {
+		if (len > 2 && twice && text[2] == '`' && !(open & MD_CODE)) {
+			open ^= MD_PRE;
+			return 3;
+		}
+		if (!(open & MD_PRE))
+			open ^= MD_CODE;
+		return 1;
+	}
+	// Inside code only the closing marker counts
+	if (open & (MD_CODE | MD_PRE))
+		return 1;
+	switch (text[0]) {
+		case '*':	open ^= MD_BOLD; return 1;
+		case '~':	open ^= MD_STRIKE; return 1;
+		case '_':
+			if (twice) {
+				open ^= MD_UNDERLINE;
+				return 2;
+			}
+			open ^= MD_ITALIC;
+			return 1;
+		case '|':
+			if (twice) {
+				open ^= MD_SPOILER;
+				return 2;
+			}
+			return 1;
+		case '[':	open |= MD_LINK; return 1;
+		case ']':
+			if ((open & MD_LINK) && len > 1 && text[1] == '(') {
+				// Link text and URL are a single entity
+				const char* end = (const char*) memchr(text, ')', len);
+				open &= ~MD_LINK;
+				return end != nullptr ? end - text + 1 : len;
+			}
+			return 1;
+	}
+	return 1;
+}
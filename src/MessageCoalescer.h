@@ -0,0 +1,68 @@
+#ifndef MESSAGE_COALESCER
+#define MESSAGE_COALESCER
+
+#include <Arduino.h>
+
+#define MAX_MESSAGE_LENGTH      4096    // max length of a Telegram text message
+#ifndef COALESCE_SLOTS
+#define COALESCE_SLOTS          4       // chats whose messages can be merged at the same time
+#endif
+
+enum ParseMode {
+	ParseNone       = 0,
+	ParseMarkdownV2 = 1,
+	ParseHTML       = 2
+};
+
+// Text merged from messages sent to the same chat
+struct CoalescedMessage {
+	int64_t 	chatId;
+	String 		text;
+	ParseMode 	parseMode;
+	bool 		silent;
+	uint32_t 	start;			// when first message was merged (ms)
+	bool 		used = false;
+};
+
+
+// Buffers for text messages sent to the same chat inside a time window, so they can be
+// sent with a single sendMessage request. Messages are merged only if parse mode and
+// notification option are the same, and are joined with a new line. Used only from loop task.
+class MessageCoalescer
+{
+public:
+	// set the merging time window (ms), 0 to disable
+	inline void setWindow(uint32_t window) { m_window = window; }
+	inline uint32_t window() const { return m_window; }
+
+	// get the message being merged for a chat (nullptr if none)
+	CoalescedMessage* find(int64_t chatId);
+
+	// start a new message for a chat
+	// returns:
+	//   nullptr if all buffers are in use
+	CoalescedMessage* add(int64_t chatId, ParseMode parseMode, bool silent);
+
+	// get a message whose time window is expired (nullptr if none)
+	CoalescedMessage* expired();
+
+	// get the message started first (nullptr if none)
+	CoalescedMessage* oldest();
+
+	// length of the first part of text that can be sent within maxLen bytes:
+	// text is split after a new line if possible, never inside a UTF-8 character and,
+	// with a parse mode, never inside an entity (HTML tag or element, MarkdownV2 style or link)
+	// returns:
+	//   0 if text can't be split before maxLen (i.e. an entity longer than maxLen)
+	static size_t cut(const char* text, size_t len, size_t maxLen, ParseMode parseMode = ParseNone);
+
+private:
+	// length of the token starting at text[0] (a tag, an escaped character, a style marker...)
+	// and how it changes the entities open
+	static size_t scanToken(const char* text, size_t len, ParseMode parseMode, uint8_t &open, uint8_t &depth);
+
+	CoalescedMessage 	m_messages[COALESCE_SLOTS];
+	uint32_t 			m_window = 0;
+};
+
+#endif
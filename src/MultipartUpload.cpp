@@ -0,0 +1,214 @@
+#include "MultipartUpload.h"
+#include "serial_log.h"
+
+#define BOUNDARY            "----WebKitFormBoundary7MA4YWxkTrZu0gW"
+#define END_BOUNDARY        "\r\n--" BOUNDARY "--\r\n"
+#define CHUNK_HEADER_SIZE   6           // "%04X\r\n": BLOCK_SIZE fit in 4 hex digits (leading zeros are allowed)
+
+
+MultipartUpload::MultipartUpload() : m_sent(0), m_state(UploadIdle)
+{
+}
+
+
+bool MultipartUpload::begin(const char* command, int64_t chat_id, File file, const char* fileName,
+							const char* contentType, const char* propertyName)
+{
+	if (state() != UploadIdle)
+		return false;
+	m_file = file;
+	m_source = &m_file;
+	return prepare(command, chat_id, file.size(), fileName, contentType, propertyName);
+}
+
+
+bool MultipartUpload::begin(const char* command, int64_t chat_id, Stream &source, uint32_t size, const char* fileName,
+							const char* contentType, const char* propertyName)
+{
+	if (state() != UploadIdle)
+		return false;
+	m_source = &source;
+	return prepare(command, chat_id, size, fileName, contentType, propertyName);
+}
+
+
+bool MultipartUpload::begin(const char* command, int64_t chat_id, const uint8_t* data, uint32_t size, const char* fileName,
+							const char* contentType, const char* propertyName)
+{
+	if (state() != UploadIdle || data == nullptr)
+		return false;
+	m_data = data;
+	return prepare(command, chat_id, size, fileName, contentType, propertyName);
+}
+
+
+bool MultipartUpload::begin(const char* command, int64_t chat_id, UploadProducer producer, const char* fileName,
+							const char* contentType, const char* propertyName)
+{
+	if (state() != UploadIdle || producer == nullptr)
+		return false;
+	m_producer = producer;
+	return prepare(command, chat_id, 0, fileName, contentType, propertyName);
+}
+
+
+bool MultipartUpload::prepare(const char* command, int64_t chat_id, uint32_t size, const char* fileName,
+							  const char* contentType, const char* propertyName)
+{
+	m_command = command;
+	m_total = size;
+	m_sent.store(0, std::memory_order_relaxed);
+	m_notified = 0;
+
+	m_formData = "--" BOUNDARY;
+	m_formData += "\r\nContent-disposition: form-data; name=\"chat_id\"\r\n\r\n";
+	char id[24];
+	snprintf(id, sizeof(id), "%lld", (long long) chat_id);
+	m_formData += id;
+	m_formData += "\r\n--" BOUNDARY;
+	m_formData += "\r\nContent-disposition: form-data; name=\"";
+	m_formData += propertyName;
+	m_formData += "\"; filename=\"";
+	m_formData += fileName;
+	m_formData += "\"\r\nContent-Type: ";
+	m_formData += contentType;
+	m_formData += "\r\n\r\n";
+
+	// Hand over to the sender (http task with ESP32)
+	m_state.store(UploadPending, std::memory_order_release);
+	return true;
+}
+
+
+void MultipartUpload::writeHeaders(Client &client, const char* token)
+{
+	String request;
+	request.reserve(256 + m_formData.length());
+	request = "POST /bot";
+	request += token;
+	request += "/";
+	request += m_command;
+	request += " HTTP/1.1" "\r\nHost: api.telegram.org" "\r\nConnection: keep-alive";
+	if (m_producer != nullptr) {
+		// Form data is sent as first chunk
+		char chunkSize[16];
+		snprintf(chunkSize, sizeof(chunkSize), "%X\r\n", (unsigned) m_formData.length());
+		request += "\r\nTransfer-Encoding: chunked";
+		request += "\r\nContent-Type: multipart/form-data; boundary=" BOUNDARY "\r\n\r\n";
+		request += chunkSize;
+		request += m_formData;
+		request += "\r\n";
+	}
+	else {
+		request += "\r\nContent-Length: ";
+		request += m_formData.length() + m_total + strlen(END_BOUNDARY);
+		request += "\r\nContent-Type: multipart/form-data; boundary=" BOUNDARY "\r\n\r\n";
+		request += m_formData;
+	}
+	client.print(request);
+	m_state.store(UploadSending, std::memory_order_release);
+}
+
+
+bool MultipartUpload::writeBlock(Client &client)
+{
+	if (m_producer != nullptr)
+		return writeChunk(client);
+
+	uint32_t sent = m_sent.load(std::memory_order_relaxed);
+	size_t len = m_total - sent < BLOCK_SIZE ? m_total - sent : BLOCK_SIZE;
+	if (len > 0) {
+		size_t written = 0;
+		if (m_data != nullptr) {
+			// Memory buffer: no copy needed
+			written = client.write(m_data + sent, len);
+		}
+		else {
+			uint8_t buff[BLOCK_SIZE];
+			len = m_source->readBytes((char*) buff, len);
+			if (len > 0)
+				written = client.write(buff, len);
+		}
+		if (len == 0 || written != len) {
+			log_error("Upload of %s failed at %u bytes\n", m_command.c_str(), sent);
+			finish(false);
+			return false;
+		}
+		m_sent.store(sent + len, std::memory_order_release);
+		if (sent + len < m_total)
+			return true;
+	}
+
+	client.print(END_BOUNDARY);
+	close();
+	m_state.store(UploadWaitReply, std::memory_order_release);
+	return false;
+}
+
+
+bool MultipartUpload::writeChunk(Client &client)
+{
+	// Chunk size, data and CRLF are written with a single call (one TLS record)
+	uint8_t buff[CHUNK_HEADER_SIZE + BLOCK_SIZE + 2];
+	uint32_t sent = m_sent.load(std::memory_order_relaxed);
+	size_t len = m_producer(buff + CHUNK_HEADER_SIZE, BLOCK_SIZE);
+	if (len > BLOCK_SIZE)
+		len = BLOCK_SIZE;
+	if (len > 0) {
+		char header[CHUNK_HEADER_SIZE + 1];
+		snprintf(header, sizeof(header), "%04X\r\n", (unsigned) len);
+		memcpy(buff, header, CHUNK_HEADER_SIZE);
+		buff[CHUNK_HEADER_SIZE + len] = '\r';
+		buff[CHUNK_HEADER_SIZE + len + 1] = '\n';
+		size_t size = CHUNK_HEADER_SIZE + len + 2;
+		if (client.write(buff, size) != size) {
+			log_error("Upload of %s failed at %u bytes\n", m_command.c_str(), sent);
+			finish(false);
+			return false;
+		}
+		m_sent.store(sent + len, std::memory_order_release);
+		return true;
+	}
+
+	// Last chunk with closing boundary, then the zero-length chunk
+	char last[64];
+	snprintf(last, sizeof(last), "%X\r\n" END_BOUNDARY "\r\n0\r\n\r\n", (unsigned) strlen(END_BOUNDARY));
+	client.print(last);
+	close();
+	m_state.store(UploadWaitReply, std::memory_order_release);
+	return false;
+}
+
+
+void MultipartUpload::close()
+{
+	if (m_file)
+		m_file.close();
+	m_source = nullptr;
+	m_data = nullptr;
+	m_producer = nullptr;
+}
+
+
+void MultipartUpload::finish(bool ok)
+{
+	close();
+	m_state.store(ok ? UploadDone : UploadFailed, std::memory_order_release);
+}
+
+
+void MultipartUpload::update()
+{
+	UploadState current = state();
+	if (current == UploadIdle || current == UploadPending)
+		return;
+
+	uint32_t sent = m_sent.load(std::memory_order_acquire);
+	bool completed = (current == UploadDone || current == UploadFailed);
+	if (m_callback != nullptr && (completed || sent != m_notified))
+		m_callback(current, sent, m_total);
+	m_notified = sent;
+
+	if (completed)
+		m_state.store(UploadIdle, std::memory_order_release);
+}
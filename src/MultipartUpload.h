@@ -0,0 +1,124 @@
+#ifndef MULTIPART_UPLOAD
+#define MULTIPART_UPLOAD
+
+#include <Arduino.h>
+#include <FS.h>
+#include <Client.h>
+#include <atomic>
+#include <functional>
+
+#if defined(ESP32)
+    #define BLOCK_SIZE          4096        // More memory, increase block size to speed-up a little upload
+#else
+    #define BLOCK_SIZE          2048
+#endif
+
+enum UploadState {
+	UploadIdle      = 0,
+	UploadPending   = 1,	// waiting to be sent
+	UploadSending   = 2,	// body is being sent block by block
+	UploadWaitReply = 3,	// body sent, waiting for server reply
+	UploadDone      = 4,	// server has accepted the file
+	UploadFailed    = 5
+};
+
+// Called from loop task (inside getNewMessage) each time some blocks were sent and once on completion
+// params:
+//   state: UploadSending, UploadWaitReply, UploadDone or UploadFailed
+//   sent : bytes of file sent
+//   total: size of file (0 if unknown, i.e. generated with a producer)
+using UploadCallback = std::function<void(UploadState state, uint32_t sent, uint32_t total)>;
+
+// Called each time a new block of a generated document has to be sent
+// (from http task with ESP32, from loop task inside getNewMessage with ESP8266)
+// params:
+//   buffer: where data has to be copied
+//   size  : max number of bytes that can be copied
+// returns:
+//   number of bytes copied, 0 when document is complete
+using UploadProducer = std::function<size_t(uint8_t* buffer, size_t size)>;
+
+
+// Multipart/form-data upload of a single file, stream, memory buffer or generated data (sendPhoto, sendDocument).
+// The request is prepared from the loop task, then body is written one BLOCK_SIZE block at time
+// by the http task (ESP32) or on each getNewMessage() call (ESP8266), so loop is never blocked
+// for the whole upload. State and counters are atomic: progress can be read from the loop task.
+class MultipartUpload
+{
+public:
+	MultipartUpload();
+
+	// prepare a new upload of a file already opened
+	// params:
+	//   command     : the Telegram API method, i.e. sendPhoto
+	//   chat_id     : the recipient chat
+	//   file        : the file to send (closed when upload ends)
+	//   fileName    : the name of document uploaded
+	//   contentType : the MIME type of document uploaded
+	//   propertyName: the form field for the file (i.e. photo, document)
+	// returns:
+	//   false if previous upload is not finished yet
+	bool begin(const char* command, int64_t chat_id, File file, const char* fileName,
+				const char* contentType, const char* propertyName);
+
+	// prepare a new upload reading size bytes from a stream.
+	// Stream must be valid until upload ends
+	bool begin(const char* command, int64_t chat_id, Stream &source, uint32_t size, const char* fileName,
+				const char* contentType, const char* propertyName);
+
+	// prepare a new upload of a memory buffer (i.e. camera_fb_t->buf).
+	// Bytes are written from the buffer straight to the client, so it must be valid until upload ends
+	bool begin(const char* command, int64_t chat_id, const uint8_t* data, uint32_t size, const char* fileName,
+				const char* contentType, const char* propertyName);
+
+	// prepare a new upload of data generated while it is sent.
+	// Size is not known in advance, so body is sent with "Transfer-Encoding: chunked"
+	bool begin(const char* command, int64_t chat_id, UploadProducer producer, const char* fileName,
+				const char* contentType, const char* propertyName);
+
+	// write request line, headers and the first part of form data
+	void writeHeaders(Client &client, const char* token);
+
+	// read next block from source and write it to the client
+	// returns:
+	//   true if there is still data to be sent
+	bool writeBlock(Client &client);
+
+	// set the final state of upload, according to server reply
+	void finish(bool ok);
+
+	// notify progress with the callback and release the upload once completed (loop task only)
+	void update();
+
+	inline void setCallback(UploadCallback callback) { m_callback = callback; }
+
+	inline UploadState state() const { return (UploadState) m_state.load(std::memory_order_acquire); }
+	inline bool pending() const { return state() == UploadPending; }
+	inline bool sending() const { return state() == UploadSending; }
+	inline bool inFlight() const { return state() == UploadSending || state() == UploadWaitReply; }
+
+private:
+	String 					m_command;
+	String 					m_formData;		// form data before the binary content
+	File 					m_file;			// owned source, if any
+	Stream*					m_source = nullptr;
+	const uint8_t*			m_data = nullptr;
+	UploadProducer			m_producer = nullptr;
+	uint32_t 				m_total = 0;
+	std::atomic<uint32_t> 	m_sent;
+	std::atomic<uint8_t> 	m_state;
+	uint32_t 				m_notified = 0;
+	UploadCallback 			m_callback = nullptr;
+
+	// build the form data and hand over the upload to the sender
+	bool prepare(const char* command, int64_t chat_id, uint32_t size, const char* fileName,
+				const char* contentType, const char* propertyName);
+
+	// write the next block of a chunked body
+	bool writeChunk(Client &client);
+
+	// release the source of data
+	void close();
+};
+
+#endif
@@ -0,0 +1,256 @@
+#include "RateLimiter.h"
+
+#define MAX_WAIT_TIME       3600000UL   // longest wait stored: a token time farther than this is a past one
+
+
+static bool tokenReady(uint32_t nextTime, uint32_t now)
+{
+	uint32_t wait = nextTime - now;
+	return wait == 0 || wait > MAX_WAIT_TIME;
+}
+
+
+// time when a token will be available after some seconds (clamped, so it's never taken for a past one)
+static uint32_t tokenTime(uint32_t now, uint32_t seconds)
+{
+	return now + (seconds < MAX_WAIT_TIME / 1000 ? seconds * 1000UL : MAX_WAIT_TIME);
+}
+
+
+int64_t RateLimiter::chatId(const char* param)
+{
+	const char *id = strstr(param, "\"chat_id\":");
+	if (id == nullptr)
+		return 0;
+	id += strlen("\"chat_id\":");
+	if (*id != '"')
+		return strtoll(id, nullptr, 10);
+	return channelId(id + 1);
+}
+
+
+int64_t RateLimiter::channelId(const char* name)
+{
+	// FNV-1a hash as a negative id, so group limits are used
+	uint32_t hash = 2166136261UL;
+	for (const char *c = name; *c != '\0' && *c != '"'; c++) {
+		hash ^= (uint8_t) *c;
+		hash *= 16777619UL;
+	}
+	return -(int64_t) hash - 1;
+}
+
+
+bool RateLimiter::allocate()
+{
+	if (m_slots == nullptr)
+		m_slots = new Slots;
+	return m_slots != nullptr;
+}
+
+
+bool RateLimiter::push(const char* command, const char* param, int64_t chatId, bool retry)
+{
+	if (!allocate()) {
+		m_stats.rejected++;
+		return false;
+	}
+	Entry *slot = nullptr;
+	Entry *oldestSent = nullptr;
+	for (Entry &entry : m_slots->entries) {
+		if (entry.state == EntryFree) {
+			slot = &entry;
+			break;
+		}
+		if (entry.state == EntrySent && (oldestSent == nullptr || (int32_t)(entry.sequence - oldestSent->sequence) < 0))
+			oldestSent = &entry;
+	}
+	// Messages waiting for their reply don't block the new ones: the oldest gives up the retry
+	if (slot == nullptr && oldestSent != nullptr) {
+		slot = oldestSent;
+		m_released++;
+		m_stats.released++;
+	}
+	if (slot == nullptr) {
+		m_stats.rejected++;
+		return false;
+	}
+
+	slot->command = command;
+	slot->param = param;
+	slot->chatId = chatId;
+	slot->sequence = retry ? 0 : ++m_sequence;
+	slot->state = EntryWaiting;
+	if (retry)
+		m_stats.retried++;
+
+	uint8_t waiting = size();
+	if (waiting > m_stats.highWater)
+		m_stats.highWater = waiting;
+	return true;
+}
+
+
+bool RateLimiter::pop(String &command, String &param, bool keep)
+{
+	uint32_t now = millis();
+	if (m_slots == nullptr || !tokenReady(m_globalTime, now))
+		return false;
+
+	Entry *next = nullptr;
+	for (Entry &entry : m_slots->entries) {
+		if (entry.state != EntryWaiting || (next != nullptr && entry.sequence >= next->sequence))
+			continue;
+		// Only the oldest message to each chat can be sent
+		bool first = true;
+		for (Entry &other : m_slots->entries) {
+			if (other.state == EntryWaiting && other.chatId == entry.chatId && other.sequence < entry.sequence) {
+				first = false;
+				break;
+			}
+		}
+		if (first && chatReady(entry.chatId, now))
+			next = &entry;
+	}
+	if (next == nullptr)
+		return false;
+
+	if (next->chatId != 0)
+		getBucket(next->chatId, now)->nextTime = now + (next->chatId < 0 ? RATE_GROUP_INTERVAL : RATE_CHAT_INTERVAL);
+	m_globalTime = now + RATE_GLOBAL_INTERVAL;
+
+	// Copy instead of move, in order to keep the entry buffers allocated
+	command = next->command;
+	param = next->param;
+	if (keep) {
+		next->state = EntrySent;
+		next->sequence = ++m_sentSequence;
+	}
+	else
+		next->state = EntryFree;
+	m_stats.sent++;
+	return true;
+}
+
+
+void RateLimiter::acknowledge(uint32_t seconds)
+{
+	// Replies arrive in the same order: the first ones are for the messages released
+	if (m_released > 0) {
+		m_released--;
+		if (seconds > 0)
+			retryAfter(0, seconds);
+		return;
+	}
+
+	if (m_slots == nullptr)
+		return;
+	Entry *oldest = nullptr;
+	for (Entry &entry : m_slots->entries) {
+		if (entry.state == EntrySent && (oldest == nullptr || (int32_t)(entry.sequence - oldest->sequence) < 0))
+			oldest = &entry;
+	}
+	if (oldest == nullptr)
+		return;
+
+	if (seconds == 0) {
+		oldest->state = EntryFree;
+		return;
+	}
+	// Send again before the other messages, once the chat is allowed
+	retryAfter(oldest->chatId, seconds);
+	oldest->state = EntryWaiting;
+	oldest->sequence = 0;
+	m_stats.retried++;
+}
+
+
+void RateLimiter::forgetSent()
+{
+	m_released = 0;
+	if (m_slots == nullptr)
+		return;
+	for (Entry &entry : m_slots->entries) {
+		if (entry.state == EntrySent)
+			entry.state = EntryFree;
+	}
+}
+
+
+void RateLimiter::retryAfter(int64_t chatId, uint32_t seconds)
+{
+	uint32_t now = millis();
+	uint32_t until = tokenTime(now, seconds);
+	// Without a free bucket for the chat, all messages wait
+	Bucket *bucket = (chatId != 0 && allocate()) ? getBucket(chatId, now) : nullptr;
+	if (bucket == nullptr) {
+		if (tokenReady(m_globalTime, until))
+			m_globalTime = until;
+		return;
+	}
+	if (tokenReady(bucket->nextTime, until))
+		bucket->nextTime = until;
+}
+
+
+uint8_t RateLimiter::size() const
+{
+	if (m_slots == nullptr)
+		return 0;
+	uint8_t waiting = 0;
+	for (const Entry &entry : m_slots->entries) {
+		if (entry.state == EntryWaiting)
+			waiting++;
+	}
+	return waiting;
+}
+
+
+RateLimiter::Bucket* RateLimiter::findBucket(int64_t chatId)
+{
+	if (m_slots == nullptr)
+		return nullptr;
+	for (Bucket &bucket : m_slots->buckets) {
+		if (bucket.chatId == chatId)
+			return &bucket;
+	}
+	return nullptr;
+}
+
+
+RateLimiter::Bucket* RateLimiter::idleBucket(uint32_t now)
+{
+	// A bucket with the token available is the same as a new one: reusing it doesn't lose any limit
+	for (Bucket &bucket : m_slots->buckets) {
+		if (bucket.chatId == 0 || tokenReady(bucket.nextTime, now))
+			return &bucket;
+	}
+	return nullptr;
+}
+
+
+RateLimiter::Bucket* RateLimiter::getBucket(int64_t chatId, uint32_t now)
+{
+	Bucket *bucket = findBucket(chatId);
+	if (bucket != nullptr)
+		return bucket;
+
+	bucket = idleBucket(now);
+	if (bucket != nullptr) {
+		bucket->chatId = chatId;
+		bucket->nextTime = now;
+	}
+	return bucket;
+}
+
+
+bool RateLimiter::chatReady(int64_t chatId, uint32_t now)
+{
+	if (chatId == 0)
+		return true;
+	Bucket *bucket = findBucket(chatId);
+	if (bucket != nullptr)
+		return tokenReady(bucket->nextTime, now);
+	// A new chat waits until the token of another one is available
+	return idleBucket(now) != nullptr;
+}
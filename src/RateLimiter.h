@@ -0,0 +1,114 @@
+#ifndef RATE_LIMITER
+#define RATE_LIMITER
+
+#include <Arduino.h>
+
+#define RATE_GLOBAL_INTERVAL    34      // ms between two messages (about 30 messages/s)
+#define RATE_CHAT_INTERVAL      1000    // ms between two messages to the same private chat
+#define RATE_GROUP_INTERVAL     3000    // ms between two messages to the same group or channel (20 messages/minute)
+#define RATE_CHAT_SLOTS         8       // chats with a recent message tracked at the same time (others wait)
+#ifndef RATE_QUEUE_SIZE
+#define RATE_QUEUE_SIZE         8       // messages that can wait for their turn
+#endif
+
+struct RateStats {
+	uint32_t sent;			// messages handed over to the send path
+	uint32_t retried;		// messages sent again after a 429 reply (Too Many Requests)
+	uint32_t rejected;		// messages discarded because queue was full
+	uint32_t released;		// messages sent whose slot was reused before the reply (not sent again with 429)
+	uint8_t  highWater;		// max number of messages waiting at the same time
+};
+
+
+// Scheduler for messages sent to chats, according to Telegram flood limits.
+// There is a token bucket (one token capacity) for all messages and one for each chat, so
+// a burst of messages is sent at the max rate allowed instead of getting the bot throttled.
+// Messages to the same chat keep their order, while messages to other chats can go first.
+// Used only from loop task.
+class RateLimiter
+{
+public:
+	RateLimiter() {}
+	~RateLimiter() { delete m_slots; }
+	RateLimiter(const RateLimiter&) = delete;
+	RateLimiter& operator=(const RateLimiter&) = delete;
+
+	// get the recipient of a JSON serialized command
+	// returns:
+	//   chat_id (string ids like "@channel" are hashed as a group), 0 if there is no recipient
+	//   (messages without a recipient are limited only by the global rate)
+	static int64_t chatId(const char* param);
+
+	// get the id used for a chat known by its username (i.e. "@channel"), the same found by chatId()
+	static int64_t channelId(const char* name);
+
+	// store a message to be sent when allowed. If queue is full, the slot of the oldest message
+	// already sent (waiting for its reply) is reused
+	// params:
+	//   retry: message was rejected by server and must be sent before the others
+	// returns:
+	//   false if queue is full of messages waiting to be sent
+	bool push(const char* command, const char* param, int64_t chatId, bool retry = false);
+
+	// take the oldest message that can be sent now, consuming the tokens
+	// params:
+	//   keep: keep message until acknowledge() is called with the server reply
+	// returns:
+	//   true if command and param were filled
+	bool pop(String &command, String &param, bool keep);
+
+	// server reply for the oldest message kept with pop()
+	// params:
+	//   seconds: time to wait before sending again (0 if message was delivered)
+	void acknowledge(uint32_t seconds);
+
+	// discard all messages kept with pop() (replies will never arrive)
+	void forgetSent();
+
+	// don't send messages to a chat (or to anyone if chatId == 0) for some seconds (at most one hour)
+	void retryAfter(int64_t chatId, uint32_t seconds);
+
+	// number of messages waiting to be sent
+	uint8_t size() const;
+
+	inline RateStats getStats() const { return m_stats; }
+
+private:
+	enum EntryState : uint8_t { EntryFree, EntryWaiting, EntrySent };
+
+	struct Entry {
+		String 		command;
+		String 		param;
+		int64_t 	chatId;
+		uint32_t 	sequence;		// order of arrival (or order of sending if EntrySent)
+		EntryState 	state = EntryFree;
+	};
+
+	struct Bucket {
+		int64_t 	chatId = 0;
+		uint32_t 	nextTime = 0;	// when next token will be available (ms)
+	};
+
+	// Allocated with the first message, so bots that don't send to chats don't pay for it
+	struct Slots {
+		Entry 		entries[RATE_QUEUE_SIZE];
+		Bucket 		buckets[RATE_CHAT_SLOTS];
+	};
+
+	Slots* 		m_slots = nullptr;
+	uint32_t 	m_globalTime = 0;
+	uint32_t 	m_sequence = 0;
+	uint32_t 	m_sentSequence = 0;
+	uint8_t 	m_released = 0;		// replies still to come for messages whose slot was reused
+	RateStats 	m_stats = {0, 0, 0, 0, 0};
+
+	bool allocate();
+	Bucket* findBucket(int64_t chatId);
+	Bucket* idleBucket(uint32_t now);
+	// returns:
+	//   the bucket of the chat (a new one if possible), nullptr if all are in use
+	Bucket* getBucket(int64_t chatId, uint32_t now);
+	bool chatReady(int64_t chatId, uint32_t now);
+};
+
+#endif
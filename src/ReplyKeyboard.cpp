@@ -1,10 +1,10 @@
 #include "ReplyKeyboard.h"
+#include "RequestWriter.h"
 #include "Utilities.h"
 
 
 ReplyKeyboard::ReplyKeyboard()
 {	
-	m_json = "{\"keyboard\":[[]]}\"";
 }
 
 ReplyKeyboard::~ReplyKeyboard() {} 
@@ -12,16 +12,10 @@ ReplyKeyboard::~ReplyKeyboard() {}
 
 bool ReplyKeyboard::addRow()
 {
-	if(m_jsonSize < BUFFER_MEDIUM) m_jsonSize = BUFFER_MEDIUM;	
-	DynamicJsonDocument doc(m_jsonSize + 128);	 // Current size + space for new row (empty)
-
-	deserializeJson(doc, m_json);
-	JsonArray rows = doc["keyboard"];	
-	rows.createNestedArray();
-	m_json.clear();
-	serializeJson(doc, m_json);
-	doc.shrinkToFit();
-	m_jsonSize = doc.memoryUsage();
+	if (m_rows == UINT8_MAX)
+		return false;
+	m_rows++;
+	m_changed = true;
 	return true;
 }
 
@@ -32,32 +26,15 @@ bool ReplyKeyboard::addButton(const char* text, ReplyKeyboardButtonType buttonTy
 		(buttonType != KeyboardButtonLocation) && 
 		(buttonType != KeyboardButtonSimple))
 		return false;
-	// As reccomended use local JsonDocument instead global
-	// inline keyboard json structure will be stored in a String var	
-	if(m_jsonSize < BUFFER_MEDIUM) m_jsonSize = BUFFER_MEDIUM;	
-	DynamicJsonDocument doc(m_jsonSize + 256);	 // Current size + space for new object (button)
-	deserializeJson(doc, m_json);
-
-	JsonArray  rows = doc["keyboard"];	
-	JsonObject button = rows[rows.size()-1].createNestedObject();
-
-	button["text"] = text; 
-	switch (buttonType){
-		case KeyboardButtonContact:
-			button["request_contact"] = true;
-			break;
-		case KeyboardButtonLocation:
-			button["request_location"] = true;
-			break;	
-		default: 
-			break;
-	}
 
-	// Store inline keyboard json structure
-	m_json.clear();
-	serializeJson(doc, m_json);
-	doc.shrinkToFit();
-	m_jsonSize = doc.memoryUsage();
+	// Only the new button is stored, JSON will be generated when needed
+	ReplyButton button;
+	button.text = m_strings.size();
+	button.row = m_rows - 1;
+	button.type = buttonType;
+	m_strings.insert(m_strings.end(), text, text + strlen(text) + 1);
+	m_buttons.push_back(button);
+	m_changed = true;
 	return true;
 
 }
@@ -65,49 +42,72 @@ bool ReplyKeyboard::addButton(const char* text, ReplyKeyboardButtonType buttonTy
 
 void ReplyKeyboard::enableResize() 
 {
-	if(m_jsonSize < BUFFER_MEDIUM) m_jsonSize = BUFFER_MEDIUM;	
-	DynamicJsonDocument doc(m_jsonSize + 128);   // Current size + space for new field
-	deserializeJson(doc, m_json);
-	doc["resize_keyboard"] = true;
-	m_json.clear();
-	serializeJson(doc, m_json);
+	m_resize = true;
+	m_changed = true;
 }
 
 void ReplyKeyboard::enableOneTime() 
 {
-	if(m_jsonSize < BUFFER_MEDIUM) m_jsonSize = BUFFER_MEDIUM;	
-	DynamicJsonDocument doc(m_jsonSize + 128);	// Current size + space for new field
-	deserializeJson(doc, m_json);
-	doc["one_time_keyboard"] = true;
-	m_json.clear();
-	serializeJson(doc, m_json);
+	m_oneTime = true;
+	m_changed = true;
 }
 
 void ReplyKeyboard::enableSelective() 
 {	
-	if(m_jsonSize < BUFFER_MEDIUM) m_jsonSize = BUFFER_MEDIUM;	
-	DynamicJsonDocument doc(m_jsonSize + 128);  // Current size + space for new field
-	deserializeJson(doc, m_json);
-	doc["selective"] = true;
-	m_json.clear();
-	serializeJson(doc, m_json);
+	m_selective = true;
+	m_changed = true;
 }
 
-String ReplyKeyboard::getJSON() const
+const String& ReplyKeyboard::getJSON() const
 {
+	if (!m_changed)
+		return m_json;
+
+	// Single pass on buttons: rows are already in order
+	m_json.reserve(m_strings.size() + m_buttons.size() * 32 + m_rows * 3 + 96);
+	m_json = "";
+	RequestWriter out(m_json);
+	out.print("{\"keyboard\":[[");
+	uint8_t row = 0;
+	bool first = true;
+	for (const ReplyButton &button : m_buttons) {
+		for (; row < button.row; row++) {
+			out.print("],[");
+			first = true;
+		}
+		if (!first)
+			out.write(',');
+		first = false;
+		out.print("{\"text\":");
+		jsonEscape(out, &m_strings[button.text]);
+		if (button.type == KeyboardButtonContact)
+			out.print(",\"request_contact\":true");
+		else if (button.type == KeyboardButtonLocation)
+			out.print(",\"request_location\":true");
+		out.write('}');
+	}
+	for (; row < m_rows - 1; row++)
+		out.print("],[");
+	out.print("]]");
+	if (m_resize)
+		out.print(",\"resize_keyboard\":true");
+	if (m_oneTime)
+		out.print(",\"one_time_keyboard\":true");
+	if (m_selective)
+		out.print(",\"selective\":true");
+	out.write('}');
+	out.flush();
+	m_changed = false;
 	return m_json;
 }
 
 String ReplyKeyboard::getJSONPretty() const
 {
-	uint16_t jsonSize;
-	if(m_jsonSize < BUFFER_MEDIUM) jsonSize = BUFFER_MEDIUM;	
-	DynamicJsonDocument doc(jsonSize + 128);	// Current size + space for new lines
-	deserializeJson(doc, m_json);
+	String json = getJSON();
+	DynamicJsonDocument doc(json.length() * 2 + BUFFER_SMALL);
+	deserializeJson(doc, json);
 
 	String serialized;		
 	serializeJsonPretty(doc, serialized);
 	return serialized;
 }
-
-
@@ -1,12 +1,13 @@
 
-#ifndef REPLY_KEYBOARD
-#define REPLY_KEYBOARD
+#ifndef REPLY_KEYBOARD_H
+#define REPLY_KEYBOARD_H
 
 // for using int_64 data
 #define ARDUINOJSON_USE_LONG_LONG 	1 
 
 #include <ArduinoJson.h>
 #include <Arduino.h>
+#include <vector>
 #include "DataStructures.h"
 
 enum ReplyKeyboardButtonType {
@@ -19,8 +20,22 @@ enum ReplyKeyboardButtonType {
 class ReplyKeyboard
 {
 private:
-	String m_json;
-	size_t m_jsonSize = BUFFER_MEDIUM;
+	// Labels are stored in a single buffer, buttons keep only the offsets
+	struct ReplyButton {
+		uint16_t 	text;
+		uint8_t 	row;
+		ReplyKeyboardButtonType type;
+	};
+
+	std::vector<ReplyButton> m_buttons;
+	std::vector<char> m_strings;
+	uint8_t 	m_rows = 1;
+	bool 		m_resize = false;
+	bool 		m_oneTime = false;
+	bool 		m_selective = false;
+
+	mutable String 	m_json;
+	mutable bool 	m_changed = true;
 
 public:
 	ReplyKeyboard();
@@ -52,9 +67,10 @@ public:
 	void enableSelective(void);
 
 	// generate a string that contains the inline keyboard formatted in a JSON structure. 
+	// JSON is built only once, when keyboard is sent for the first time after a change.
 	// returns:
 	//   the JSON of the inline keyboard 
-	String getJSON(void) const;
+	const String& getJSON(void) const;
 	String getJSONPretty() const;
 };
 
@@ -0,0 +1,205 @@
+#include "RequestWriter.h"
+#include "Utilities.h"
+
+size_t RequestWriter::write(uint8_t c)
+{
+	m_length++;
+	if (m_out == nullptr && m_string == nullptr)
+		return 1;
+	if (m_used == REQUEST_WRITER_BUFFER)
+		flush();
+	m_buffer[m_used++] = c;
+	return 1;
+}
+
+
+size_t RequestWriter::write(const uint8_t *buffer, size_t size)
+{
+	append((const char *) buffer, size, false);
+	return size;
+}
+
+
+void RequestWriter::append(const char* data, size_t len, bool progmem)
+{
+	m_length += len;
+	if (m_out == nullptr && m_string == nullptr)
+		return;
+	for (size_t done = 0; done < len; ) {
+		if (m_used == REQUEST_WRITER_BUFFER)
+			flush();
+		size_t chunk = min(len - done, (size_t) (REQUEST_WRITER_BUFFER - m_used));
+		if (progmem)
+			memcpy_P(m_buffer + m_used, data + done, chunk);
+		else
+			memcpy(m_buffer + m_used, data + done, chunk);
+		m_used += chunk;
+		done += chunk;
+	}
+}
+
+
+void RequestWriter::flush()
+{
+	if (m_used == 0)
+		return;
+	if (m_out != nullptr)
+		m_out->write((const uint8_t *) m_buffer, m_used);
+	else if (m_string != nullptr) {
+		// Escaped JSON has no null characters
+		m_buffer[m_used] = '\0';
+		*m_string += m_buffer;
+	}
+	m_used = 0;
+}
+
+
+void RequestWriter::beginObject()
+{
+	write('{');
+	m_first = true;
+}
+
+
+void RequestWriter::endObject()
+{
+	write('}');
+	m_first = false;
+}
+
+
+void RequestWriter::addKey(const char* key)
+{
+	if (!m_first)
+		write(',');
+	m_first = false;
+	jsonEscape(*this, key);
+	write(':');
+}
+
+
+void RequestWriter::addString(const char* key, const char* value)
+{
+	addKey(key);
+	jsonEscape(*this, value != nullptr ? value : "");
+}
+
+
+void RequestWriter::addNumber(const char* key, int64_t value)
+{
+	addKey(key);
+	// Print has no overload for 64 bit integers
+	char digits[24];
+	char *p = digits + sizeof(digits);
+	uint64_t abs = value < 0 ? -(uint64_t) value : (uint64_t) value;
+	do {
+		*--p = '0' + abs % 10;
+		abs /= 10;
+	} while (abs != 0);
+	if (value < 0)
+		*--p = '-';
+	write((const uint8_t *) p, digits + sizeof(digits) - p);
+}
+
+
+void RequestWriter::addBool(const char* key, bool value)
+{
+	addKey(key);
+	print(value ? "true" : "false");
+}
+
+
+void RequestWriter::addJson(const char* key, const char* json, const char* members)
+{
+	addKey(key);
+	addObject(json, strlen(json), false, members);
+}
+
+
+void RequestWriter::addJson(const char* key, const __FlashStringHelper* json, const char* members)
+{
+	addKey(key);
+	addObject((PGM_P) json, strlen_P((PGM_P) json), true, members);
+}
+
+
+// Length of the JSON string starting at text (opening quote included), 0 if not terminated
+static size_t stringLength(const char* text, size_t len, bool progmem)
+{
+	for (size_t i = 1; i < len; i++) {
+		char c = progmem ? (char) pgm_read_byte(text + i) : text[i];
+		if (c == '\\')
+			i++;
+		else if (c == '"')
+			return i + 1;
+	}
+	return 0;
+}
+
+
+// Check if the object has a member with this key (quotes included), without parsing the values
+static bool hasMember(const char* json, size_t len, bool progmem, const char* key, size_t keyLen)
+{
+	int depth = 0;
+	for (size_t i = 0; i < len; i++) {
+		char c = progmem ? (char) pgm_read_byte(json + i) : json[i];
+		if (c == '{' || c == '[')
+			depth++;
+		else if (c == '}' || c == ']')
+			depth--;
+		else if (c == '"') {
+			size_t n = stringLength(json + i, len - i, progmem);
+			if (n == 0)
+				return false;
+			if (depth == 1 && n == keyLen) {
+				bool same = progmem ? memcmp_P(key, json + i, n) == 0 : memcmp(key, json + i, n) == 0;
+				if (same)
+					return true;
+			}
+			i += n - 1;
+		}
+	}
+	return false;
+}
+
+
+void RequestWriter::addObject(const char* json, size_t len, bool progmem, const char* members)
+{
+	// Members are inserted before the closing brace, without parsing the object
+	size_t end = len;
+	if (members != nullptr) {
+		while (end > 0 && (char) pgm_read_byte(json + end - 1) != '}')
+			end--;
+	}
+	if (members == nullptr || end == 0) {
+		append(json, len, progmem);
+		return;
+	}
+
+	// No comma if object is empty
+	size_t last = end - 1;
+	while (last > 0 && isspace((char) pgm_read_byte(json + last - 1)))
+		last--;
+	bool empty = last > 0 && (char) pgm_read_byte(json + last - 1) == '{';
+
+	append(json, end - 1, progmem);
+	// Members already in the object are kept, the others are added
+	for (const char *member = members; *member != '\0'; ) {
+		const char *next = member;
+		if (*next == '"')
+			next += stringLength(next, strlen(next), false);
+		size_t keyLen = next - member;
+		// Values are literals or strings without commas
+		next = strchr(next, ',');
+		if (next == nullptr)
+			next = member + strlen(member);
+		if (keyLen == 0 || !hasMember(json, end, progmem, member, keyLen)) {
+			if (!empty)
+				write(',');
+			empty = false;
+			write((const uint8_t *) member, next - member);
+		}
+		member = *next == ',' ? next + 1 : next;
+	}
+	append(json + end - 1, len - end + 1, progmem);
+}
@@ -0,0 +1,66 @@
+#ifndef REQUEST_WRITER
+#define REQUEST_WRITER
+
+#include <Arduino.h>
+#include <functional>
+
+#ifndef REQUEST_WRITER_BUFFER
+#define REQUEST_WRITER_BUFFER   512     // bytes collected before each write to the output (one TLS record at most)
+#endif
+
+// Writes a JSON request body field by field, with string values escaped on the fly.
+// Output is collected in a small buffer and written to a Print (i.e. the TLS client) or appended to a String.
+// Without output only the length is counted: a body is written twice, first to get the Content-Length
+// and then to send it, so the whole request is never stored in memory.
+class RequestWriter : public Print
+{
+public:
+	// sizing pass: nothing is written, length() is the size of the body
+	RequestWriter() {}
+	RequestWriter(Print *out) : m_out(out) {}
+	RequestWriter(String &out) : m_string(&out) {}
+	~RequestWriter() { flush(); }
+
+	void beginObject();
+	void endObject();
+
+	// add a member to current object
+	void addString(const char* key, const char* value);
+	void addNumber(const char* key, int64_t value);
+	void addBool(const char* key, bool value);
+
+	// add a member with a value already serialized, copied verbatim (i.e. a keyboard)
+	// params
+	//   json   : the value, in RAM or in flash
+	//   members: optional members (already serialized, comma separated) merged in json object,
+	//            unless the object already has a member with the same key
+	void addJson(const char* key, const char* json, const char* members = nullptr);
+	void addJson(const char* key, const __FlashStringHelper* json, const char* members = nullptr);
+
+	// bytes written so far (or that would have been written)
+	inline size_t length() const { return m_length; }
+
+	// write the buffered bytes to the output
+	void flush();
+
+	size_t write(uint8_t c) override;
+	size_t write(const uint8_t *buffer, size_t size) override;
+	using Print::write;
+
+private:
+	Print* 		m_out = nullptr;
+	String* 	m_string = nullptr;
+	size_t 		m_length = 0;
+	bool 		m_first = true;			// no member written yet in current object
+	uint16_t 	m_used = 0;
+	char 		m_buffer[REQUEST_WRITER_BUFFER + 1];	// +1 for the terminator appended to String
+
+	void addKey(const char* key);
+	void append(const char* data, size_t len, bool progmem);
+	void addObject(const char* json, size_t len, bool progmem, const char* members);
+};
+
+// Writes the fields of a request body. It's called once for each pass, so it must write the same fields each time
+using RequestBody = std::function<void(RequestWriter &json)>;
+
+#endif
@@ -0,0 +1,17 @@
+#include "StaticKeyboard.h"
+
+
+bool StaticKeyboard::checkCallback(const TBMessage &msg) const
+{
+	if (msg.callbackQueryData == nullptr)
+		return false;
+
+	for (size_t i = 0; i < m_count; i++) {
+		const Binding &binding = m_bindings[i];
+		if (binding.callback != nullptr && strcmp(binding.data, msg.callbackQueryData) == 0) {
+			binding.callback(msg);
+			return true;
+		}
+	}
+	return false;
+}
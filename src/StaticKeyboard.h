@@ -0,0 +1,94 @@
+
+#ifndef STATIC_KEYBOARD
+#define STATIC_KEYBOARD
+
+#include <Arduino.h>
+#include "DataStructures.h"
+
+// Keyboards with a fixed layout, written as string literals joined by the preprocessor:
+// the JSON is complete at compile time and can be stored in flash, no heap is used.
+// Labels and data are copied verbatim, so '"' and '\' must be escaped as in JSON (i.e. "\\\"").
+//
+//   static const char menuJson[] PROGMEM = INLINE_KEYBOARD(
+//       KEYBOARD_ROW(QUERY_BUTTON("Light ON", "on"), QUERY_BUTTON("Light OFF", "off")),
+//       KEYBOARD_ROW(URL_BUTTON("Help", "https://core.telegram.org/bots"))
+//   );
+//   static const StaticKeyboard::Binding menuCallbacks[] = { {"on", onLight}, {"off", offLight} };
+//   static const StaticKeyboard menu(menuJson, menuCallbacks);
+//
+//   myBot.sendMessage(msg, "Choose", menu);
+
+// Inline keyboard buttons
+#define QUERY_BUTTON(text, data)    "{\"text\":\"" text "\",\"callback_data\":\"" data "\"}"
+#define URL_BUTTON(text, url)       "{\"text\":\"" text "\",\"url\":\"" url "\"}"
+
+// Reply keyboard buttons
+#define REPLY_BUTTON(text)          "{\"text\":\"" text "\"}"
+#define CONTACT_BUTTON(text)        "{\"text\":\"" text "\",\"request_contact\":true}"
+#define LOCATION_BUTTON(text)       "{\"text\":\"" text "\",\"request_location\":true}"
+
+// Reply keyboard options, can be concatenated (i.e. KEYBOARD_RESIZE KEYBOARD_ONE_TIME)
+#define KEYBOARD_RESIZE             ",\"resize_keyboard\":true"
+#define KEYBOARD_ONE_TIME           ",\"one_time_keyboard\":true"
+#define KEYBOARD_SELECTIVE          ",\"selective\":true"
+
+// Up to 12 buttons in a row, up to 12 rows in a keyboard
+#define KEYBOARD_ROW(...)           "[" SK_JOIN(__VA_ARGS__) "]"
+#define INLINE_KEYBOARD(...)        "{\"inline_keyboard\":[" SK_JOIN(__VA_ARGS__) "]}"
+#define REPLY_KEYBOARD(...)         "{\"keyboard\":[" SK_JOIN(__VA_ARGS__) "]}"
+#define REPLY_KEYBOARD_OPT(options, ...) "{\"keyboard\":[" SK_JOIN(__VA_ARGS__) "]" options "}"
+
+// Join the arguments with a comma between them
+#define SK_EXPAND(x) x
+#define SK_JOIN_1(a) a
+#define SK_JOIN_2(a, ...) a "," SK_EXPAND(SK_JOIN_1(__VA_ARGS__))
+#define SK_JOIN_3(a, ...) a "," SK_EXPAND(SK_JOIN_2(__VA_ARGS__))
+#define SK_JOIN_4(a, ...) a "," SK_EXPAND(SK_JOIN_3(__VA_ARGS__))
+#define SK_JOIN_5(a, ...) a "," SK_EXPAND(SK_JOIN_4(__VA_ARGS__))
+#define SK_JOIN_6(a, ...) a "," SK_EXPAND(SK_JOIN_5(__VA_ARGS__))
+#define SK_JOIN_7(a, ...) a "," SK_EXPAND(SK_JOIN_6(__VA_ARGS__))
+#define SK_JOIN_8(a, ...) a "," SK_EXPAND(SK_JOIN_7(__VA_ARGS__))
+#define SK_JOIN_9(a, ...) a "," SK_EXPAND(SK_JOIN_8(__VA_ARGS__))
+#define SK_JOIN_10(a, ...) a "," SK_EXPAND(SK_JOIN_9(__VA_ARGS__))
+#define SK_JOIN_11(a, ...) a "," SK_EXPAND(SK_JOIN_10(__VA_ARGS__))
+#define SK_JOIN_12(a, ...) a "," SK_EXPAND(SK_JOIN_11(__VA_ARGS__))
+#define SK_SELECT(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, name, ...) name
+#define SK_JOIN(...) SK_EXPAND(SK_SELECT(__VA_ARGS__, SK_JOIN_12, SK_JOIN_11, SK_JOIN_10, SK_JOIN_9, SK_JOIN_8, \
+                        SK_JOIN_7, SK_JOIN_6, SK_JOIN_5, SK_JOIN_4, SK_JOIN_3, SK_JOIN_2, SK_JOIN_1)(__VA_ARGS__))
+
+
+// A keyboard declared at compile time. It only refers to the JSON and to the callbacks
+// table, which must be valid as long as the keyboard can be pressed (i.e. static or global)
+class StaticKeyboard
+{
+public:
+	using Callback = void (*)(const TBMessage &msg);
+
+	// Function called when the query button with this callback data is pressed
+	struct Binding {
+		const char* data;
+		Callback 	callback;
+	};
+
+	explicit constexpr StaticKeyboard(const char* json) :
+		m_json(json), m_bindings(nullptr), m_count(0) {}
+
+	template <size_t N>
+	constexpr StaticKeyboard(const char* json, const Binding (&bindings)[N]) :
+		m_json(json), m_bindings(bindings), m_count(N) {}
+
+	// the JSON of the keyboard (in flash with ESP8266, read it with the _P functions)
+	inline const __FlashStringHelper* getJSON() const { return FPSTR(m_json); }
+
+	// Call the function bound to the callback data of a query message
+	// returns:
+	//   true if a function was called
+	bool checkCallback(const TBMessage &msg) const;
+
+private:
+	const char* 	m_json;
+	const Binding* 	m_bindings;
+	size_t 			m_count;
+};
+
+#endif
@@ -0,0 +1,74 @@
+#include "AsyncTelegram.h"
+
+#if defined(ESP32)
+
+TelegramConnection::TelegramConnection()
+{
+	m_mutex = xSemaphoreCreateRecursiveMutex();
+}
+
+
+bool TelegramConnection::attach(AsyncTelegram *bot)
+{
+	for (uint8_t i = 0; i < m_count; i++) {
+		if (m_bots[i] == bot)
+			return true;
+	}
+	if (m_count == MAX_SHARED_BOTS)
+		return false;
+	// Task can be already serving other bots
+	ConnectionLock lock(m_mutex);
+	m_bots[m_count] = bot;
+	m_count++;
+	return true;
+}
+
+
+WiFiClientSecure* TelegramConnection::begin(AsyncTelegram *bot)
+{
+	if (m_client == nullptr) {
+		uint32_t freeHeap = ESP.getFreeHeap();
+		m_client = bot->newClient();
+		xTaskCreatePinnedToCore(this->connectionTask, "connectionTask", 6500, this, 10, &m_task, 0);
+		m_heap = freeHeap - ESP.getFreeHeap();
+	}
+	return m_client;
+}
+
+
+void TelegramConnection::connectionTask(void *args)
+{
+	TelegramConnection *_this = (TelegramConnection *) args;
+	HTTPClient https;
+	https.setTimeout(SERVER_TIMEOUT);
+
+	String command((char *)0);
+	String param((char *)0);
+	command.reserve(32);
+	param.reserve(BUFFER_SMALL);
+
+	for (;;) {
+		bool served = false;
+		if (WiFi.status() == WL_CONNECTED) {
+			// Serve one request, starting from the bot next to the last one served
+			for (uint8_t i = 0; !served; i++) {
+				ConnectionLock lock(_this->m_mutex);
+				uint8_t count = _this->m_count;
+				if (i >= count)
+					break;
+				uint8_t index = (_this->m_next + i) % count;
+				bool closed = false;
+				served = _this->m_bots[index]->serveRequest(https, _this->m_client, false, command, param, closed);
+				if (served)
+					_this->m_next = (index + 1) % count;
+				// Server has closed the connection: it will be opened again with next request
+				if (closed)
+					_this->m_client->stop();
+			}
+		}
+		if (!served)
+			delay(1);
+	}
+}
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef TELEGRAM_CONNECTION
+#define TELEGRAM_CONNECTION
+
+#if defined(ESP32)
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <WiFiClientSecure.h>
+#include <ArduinoJson.h>
+#include "DataStructures.h"
+#include "HttpResponseParser.h"
+
+#ifndef MAX_SHARED_BOTS
+#define MAX_SHARED_BOTS     4       // bots that can share the same connection
+#endif
+
+class AsyncTelegram;
+
+// One keep-alive TLS connection to Telegram server, and one http task, shared by several bots (ESP32 only).
+// Each bot sends its requests with its own token on the same connection: queued requests are served
+// round robin, one bot at time, so a busy bot can't starve the others.
+// Since a pending getUpdates would hold the connection, shared bots poll without server side timeout.
+class TelegramConnection
+{
+public:
+	TelegramConnection();
+
+	// number of bots using this connection
+	inline uint8_t bots() const { return m_count; }
+
+	// heap memory (bytes) used by TLS client and http task, as measured when created
+	inline uint32_t getConnectionHeap() const { return m_heap; }
+
+private:
+	friend class AsyncTelegram;
+
+	AsyncTelegram* 		m_bots[MAX_SHARED_BOTS];
+	uint8_t 			m_count = 0;
+	uint8_t 			m_next = 0;			// bot served first on next turn
+	WiFiClientSecure* 	m_client = nullptr;
+	TaskHandle_t 		m_task = nullptr;
+	SemaphoreHandle_t 	m_mutex;			// exclusive use of client (recursive)
+	uint32_t 			m_heap = 0;
+
+	// Used by bots while they hold the lock: framing of replies read from client (blocking
+	// commands, downloads) and their JSON
+	HttpResponseParser 	m_parser;
+	StaticJsonDocument<BUFFER_SMALL> m_replyDoc;
+
+	// add a bot to the round robin
+	// returns:
+	//   false if there are already MAX_SHARED_BOTS bots
+	bool attach(AsyncTelegram *bot);
+
+	// create the client (with TLS options of bot) and start the http task, if not done yet
+	WiFiClientSecure* begin(AsyncTelegram *bot);
+
+	static void connectionTask(void *args);
+};
+
+
+// Exclusive use of a resource guarded by a recursive mutex while in scope: a TLS client (of the
+// shared connection or of a bot) or a bot used by loop and event tasks. Nothing is done if mutex is null
+class ConnectionLock
+{
+public:
+	ConnectionLock(SemaphoreHandle_t mutex) : m_mutex(mutex) {
+		if (m_mutex != nullptr)
+			xSemaphoreTakeRecursive(m_mutex, portMAX_DELAY);
+	}
+
+	~ConnectionLock() {
+		if (m_mutex != nullptr)
+			xSemaphoreGiveRecursive(m_mutex);
+	}
+
+private:
+	SemaphoreHandle_t m_mutex;
+};
+
+#endif
+#endif
@@ -0,0 +1,67 @@
+#include "UpdateRecord.h"
+
+#define NO_STRING   UINT16_MAX
+
+// String members of a message, text is the last one so it is the only one truncated (usually)
+static void stringFields(TBMessage &msg, const char** fields[UPDATE_RECORD_FIELDS])
+{
+	fields[0]  = &msg.sender.firstName;
+	fields[1]  = &msg.sender.lastName;
+	fields[2]  = &msg.sender.username;
+	fields[3]  = &msg.sender.languageCode;
+	fields[4]  = &msg.group.title;
+	fields[5]  = &msg.contact.phoneNumber;
+	fields[6]  = &msg.contact.firstName;
+	fields[7]  = &msg.contact.lastName;
+	fields[8]  = &msg.contact.vCard;
+	fields[9]  = &msg.document.file_id;
+	fields[10] = &msg.document.file_name;
+	fields[11] = &msg.callbackQueryID;
+	fields[12] = &msg.callbackQueryData;
+	fields[13] = &msg.text.str;
+}
+
+
+void UpdateRecord::pack(const TBMessage &msg)
+{
+	message = msg;
+	used = 0;
+	truncated = false;
+
+	const char** fields[UPDATE_RECORD_FIELDS];
+	stringFields(message, fields);
+	for (uint8_t i = 0; i < UPDATE_RECORD_FIELDS; i++) {
+		const char* str = *fields[i];
+		*fields[i] = nullptr;
+		if (str == nullptr) {
+			offsets[i] = NO_STRING;
+			continue;
+		}
+		size_t len = (fields[i] == &message.text.str) ? msg.text.len : strlen(str);
+		size_t room = UPDATE_RECORD_STRINGS - used - 1;
+		if (len > room) {
+			// UTF-8 continuation bytes are 10xxxxxx: don't cut a character
+			len = room;
+			while (len > 0 && ((uint8_t) str[len] & 0xC0) == 0x80)
+				len--;
+			truncated = true;
+		}
+		memcpy(strings + used, str, len);
+		strings[used + len] = '\0';
+		offsets[i] = used;
+		used += len + 1;
+		if (used == UPDATE_RECORD_STRINGS)
+			used--;		// keep last byte for the empty strings of next fields
+	}
+}
+
+
+void UpdateRecord::unpack(TBMessage &msg) const
+{
+	msg = message;
+	const char** fields[UPDATE_RECORD_FIELDS];
+	stringFields(msg, fields);
+	for (uint8_t i = 0; i < UPDATE_RECORD_FIELDS; i++)
+		*fields[i] = offsets[i] != NO_STRING ? strings + offsets[i] : nullptr;
+	msg.text.len = msg.text.str != nullptr ? strlen(msg.text.str) : 0;
+}
@@ -0,0 +1,42 @@
+#ifndef UPDATE_RECORD
+#define UPDATE_RECORD
+
+#include <Arduino.h>
+#include "DataStructures.h"
+
+#ifndef UPDATE_RECORD_STRINGS
+#define UPDATE_RECORD_STRINGS   1536    // bytes for the strings of a decoded update (longer text is truncated)
+#endif
+#define UPDATE_RECORD_FIELDS    14      // string members of TBMessage
+
+
+// A decoded update with its strings, with fixed size so it can be copied in a FreeRTOS queue.
+// While in the queue, string members of message are stored as offsets in strings[]
+struct UpdateRecord {
+	TBMessage 	message;
+	uint16_t 	offsets[UPDATE_RECORD_FIELDS];	// UINT16_MAX if string is null
+	uint16_t 	used;
+	bool 		truncated;					// some string didn't fit in record
+	uint32_t 	queued;						// when record was put in queue (us)
+	char 		strings[UPDATE_RECORD_STRINGS];
+
+	// copy a message and its strings in record
+	void pack(const TBMessage &msg);
+
+	// get the message, with strings pointing to this record
+	void unpack(TBMessage &msg) const;
+};
+
+// Pipelined mode timings and counters (ESP32).
+// Each member is updated by the task running that stage
+struct PipelineStats {
+	uint32_t fetchTime;			// last getUpdates request, from sending to reply received (ms, http task)
+	uint32_t parseTime;			// last reply deserialized and decoded in records (us, parse task)
+	uint32_t queueTime;			// last record waiting in queue (us)
+	uint32_t handleTime;		// last record taken from queue and handed out (us, loop task)
+	uint32_t updates;			// records queued
+	uint32_t truncated;			// records with strings truncated
+	uint8_t  highWater;			// max number of records in queue at the same time
+};
+
+#endif
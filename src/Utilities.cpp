@@ -65,4 +65,34 @@ String int64ToAscii(int64_t value) {
 	if (value < 0)
 		buffer = '-' + buffer;
 	return buffer;
-}
\ No newline at end of file
+}
+
+void jsonEscape(Print &out, const char* text)
+{
+	out.write('"');
+	// Runs of characters that don't need escaping are written at once
+	const char *run = text;
+	for (const char *c = text; ; c++) {
+		const char* escaped = nullptr;
+		char unicode[8];
+		switch (*c) {
+			case '\0': 	break;
+			case '"':	escaped = "\\\""; break;
+			case '\\':	escaped = "\\\\"; break;
+			case '\n':	escaped = "\\n"; break;
+			case '\r':	escaped = "\\r"; break;
+			case '\t':	escaped = "\\t"; break;
+			default:
+				if ((uint8_t) *c >= 0x20)
+					continue;
+				snprintf(unicode, sizeof(unicode), "\\u%04x", (uint8_t) *c);
+				escaped = unicode;
+		}
+		out.write((const uint8_t *) run, c - run);
+		if (escaped == nullptr)
+			break;
+		out.print(escaped);
+		run = c + 1;
+	}
+	out.write('"');
+}
@@ -28,5 +28,11 @@ String toUTF8(String message);
 //   the ASCII string of the converted value 
 String int64ToAscii(int64_t value);
 
+// write a string value of a JSON text (with quotes and escaped characters)
+// params
+//   out : where the JSON text is written (i.e. a RequestWriter, also to append it to a String)
+//   text: the string to write
+void jsonEscape(Print &out, const char* text);
+
 
 #endif